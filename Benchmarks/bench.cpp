@@ -0,0 +1,308 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nes_internal.hpp"
+#include "nesc.hpp"
+
+#ifndef NES_ROM_DIR
+#define NES_ROM_DIR "Roms"
+#endif
+
+typedef std::chrono::steady_clock BenchClock;
+
+static const double bench_sample_rate = 44100.0;
+static const int bench_audio_buffer = 2048;
+static bool bench_indexed = false;
+static int bench_run_ahead = 0;
+static bool bench_idle_skip = true;
+static int bench_scaled_width = 0;
+static int bench_scaled_height = 0;
+
+typedef struct {
+    int frame;
+    uint8_t buttons;
+} InputEvent;
+
+// Frame-indexed controller script. Each entry holds its button state until the
+// next entry; the last state is held for the rest of the run.
+static const InputEvent bench_input_script[] = {
+    {0, 0},
+    {90, BUTTON_START},
+    {96, 0},
+    {180, BUTTON_START},
+    {186, 0},
+    {240, BUTTON_RIGHT},
+    {300, BUTTON_RIGHT | BUTTON_A},
+    {320, BUTTON_RIGHT},
+    {400, BUTTON_LEFT},
+    {440, BUTTON_RIGHT | BUTTON_B},
+    {500, BUTTON_DOWN},
+    {530, 0},
+    {560, BUTTON_A},
+    {570, BUTTON_RIGHT | BUTTON_B},
+    {900, BUTTON_LEFT | BUTTON_A},
+    {960, 0}
+};
+
+typedef struct {
+    double seconds;
+    double cpuSeconds;
+    double ppuSeconds;
+    double apuSeconds;
+    uint64_t frameHash;
+} BenchResult;
+
+static uint8_t bench_buttons_for_frame(int frame) {
+    uint8_t buttons = 0;
+    size_t count = sizeof(bench_input_script) / sizeof(bench_input_script[0]);
+    for (size_t i = 0; i < count; i++) {
+        if (bench_input_script[i].frame > frame) {
+            break;
+        }
+        buttons = bench_input_script[i].buttons;
+    }
+    return buttons;
+}
+
+static void bench_apply_input(NES *nes, int frame) {
+    uint8_t buttons = bench_buttons_for_frame(frame);
+    for (int bit = 0; bit < 8; bit++) {
+        uint8_t button = (uint8_t)(1 << bit);
+        nes->bus.controller.setButton(button, (buttons & button) != 0);
+    }
+}
+
+static uint64_t bench_hash_frame(const uint32_t *pixels) {
+    return nes_hash_frame(pixels);
+}
+
+// The script as frame-stamped button changes, every button at each entry,
+// which applies at the same frame starts as bench_apply_input.
+static std::vector<NesInputEvent> bench_input_events() {
+    std::vector<NesInputEvent> events;
+    for (const InputEvent &entry : bench_input_script) {
+        for (int bit = 0; bit < 8; bit++) {
+            uint8_t button = (uint8_t)(1 << bit);
+            events.push_back({(uint64_t)entry.frame, button, (entry.buttons & button) != 0});
+        }
+    }
+    return events;
+}
+
+static double bench_seconds(BenchClock::time_point start, BenchClock::time_point end) {
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static bool bench_read_file(const std::string &path, std::vector<uint8_t> &out) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(file);
+        return false;
+    }
+    out.resize((size_t)size);
+    size_t read = fread(out.data(), 1, out.size(), file);
+    fclose(file);
+    return read == out.size();
+}
+
+// Drives the public entry points the app uses: one nes_step_frame, then the
+// queued audio is drained the way the render callback would. In a core built
+// with NESC_PROFILE the split comes from the timers nes_get_stats reports,
+// which sit in the same step path; otherwise it is left at zero.
+static BenchResult bench_run_throughput(const std::vector<uint8_t> &rom, int frames) {
+    BenchResult result = {};
+    std::vector<float> audio(bench_audio_buffer);
+    NESRef nes = nes_create();
+    nes_apu_set_sample_rate(nes, bench_sample_rate);
+    nes_set_indexed_output(nes, bench_indexed);
+    nes_set_idle_skip(nes, bench_idle_skip);
+    if (bench_scaled_width > 0) {
+        nes_set_scaled_output(nes, bench_scaled_width, bench_scaled_height, NES_PIXEL_ARGB8888, true);
+    }
+    if (!nes_load_rom(nes, rom.data(), rom.size()) || !nes_set_run_ahead(nes, bench_run_ahead)) {
+        nes_destroy(nes);
+        return result;
+    }
+
+    BenchClock::time_point start = BenchClock::now();
+    for (int frame = 0; frame < frames; frame++) {
+        bench_apply_input(nes, frame);
+        nes_step_frame(nes);
+        nes_apu_read_samples(nes, audio.data(), nes_apu_available_samples(nes));
+    }
+    result.seconds = bench_seconds(start, BenchClock::now());
+    result.frameHash = bench_hash_frame(nes_framebuffer(nes));
+    NesStats stats;
+    if (nes_get_stats(nes, &stats)) {
+        result.cpuSeconds = (double)stats.cpu_ns * 1e-9;
+        result.ppuSeconds = (double)stats.ppu_ns * 1e-9;
+        result.apuSeconds = (double)stats.apu_ns * 1e-9;
+    }
+    nes_destroy(nes);
+    return result;
+}
+
+// Runs `copies` of every ROM's script through nes_run_batch on all cores and
+// checks each final frame against the single-console pass.
+static int bench_run_batch(const std::vector<std::string> &roms, const std::vector<uint64_t> &expected,
+                           int frames, int copies) {
+    std::vector<NesInputEvent> events = bench_input_events();
+    std::vector<NesRomImage *> images;
+    for (const std::string &path : roms) {
+        images.push_back(nes_rom_image_open(path.c_str()));
+    }
+    std::vector<NesBatchJob> jobs;
+    std::vector<uint64_t> hashes(roms.size() * (size_t)copies);
+    for (int copy = 0; copy < copies; copy++) {
+        for (size_t rom = 0; rom < roms.size(); rom++) {
+            NesBatchJob job = {};
+            job.rom = images[rom];
+            job.inputs = events.data();
+            job.input_count = events.size();
+            job.frames = (uint32_t)frames;
+            job.hashes = &hashes[jobs.size()];
+            jobs.push_back(job);
+        }
+    }
+
+    BenchClock::time_point start = BenchClock::now();
+    size_t ran = nes_run_batch(jobs.data(), jobs.size(), 0);
+    double seconds = bench_seconds(start, BenchClock::now());
+    for (NesRomImage *image : images) {
+        nes_rom_image_release(image);
+    }
+
+    int failures = (int)(jobs.size() - ran);
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].ok && hashes[i] != expected[i % roms.size()]) {
+            fprintf(stderr, "%s: batch job %zu diverged (%016llx)\n", roms[i % roms.size()].c_str(), i,
+                    (unsigned long long)hashes[i]);
+            failures += 1;
+        }
+    }
+    printf("%-20s %7zu %9.1f  %zu jobs on %u threads\n", "batch", jobs.size() * (size_t)frames,
+           (double)(jobs.size() * (size_t)frames) / seconds, jobs.size(), std::thread::hardware_concurrency());
+    return failures;
+}
+
+static void bench_usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--frames N] [--no-split] [--indexed] [--batch COPIES] [--run-ahead N]\n"
+                    "          [--no-idle-skip] [--scaled WxH] [rom.nes ...]\n", argv0);
+    fprintf(stderr, "  with no ROM arguments, every .nes file in %s is run\n", NES_ROM_DIR);
+}
+
+int main(int argc, char **argv) {
+    int frames = 1200;
+    bool split = true;
+    int batchCopies = 0;
+    std::vector<std::string> roms;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--no-split")) {
+            split = false;
+        } else if (!strcmp(argv[i], "--indexed")) {
+            bench_indexed = true;
+        } else if (!strcmp(argv[i], "--run-ahead") && i + 1 < argc) {
+            bench_run_ahead = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--no-idle-skip")) {
+            bench_idle_skip = false;
+        } else if (!strcmp(argv[i], "--scaled") && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &bench_scaled_width, &bench_scaled_height) != 2) {
+                bench_scaled_width = -1;
+            }
+        } else if (!strcmp(argv[i], "--batch") && i + 1 < argc) {
+            batchCopies = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+            bench_usage(argv[0]);
+            return 0;
+        } else {
+            roms.push_back(argv[i]);
+        }
+    }
+    bool badScale = bench_scaled_width != 0 && (bench_scaled_width < 1 || bench_scaled_width > NES_WIDTH ||
+                                                bench_scaled_height < 1 || bench_scaled_height > NES_HEIGHT);
+    if (frames <= 0 || bench_run_ahead < 0 || bench_run_ahead > NES_MAX_RUN_AHEAD || badScale) {
+        bench_usage(argv[0]);
+        return 1;
+    }
+    // Run-ahead shows frames from ahead of the real timeline, which the
+    // batch runner does not reproduce.
+    if (bench_run_ahead > 0) {
+        batchCopies = 0;
+    }
+
+    if (roms.empty()) {
+        std::error_code error;
+        for (const auto &entry : std::filesystem::directory_iterator(NES_ROM_DIR, error)) {
+            if (entry.path().extension() == ".nes") {
+                roms.push_back(entry.path().string());
+            }
+        }
+        std::sort(roms.begin(), roms.end());
+    }
+    if (roms.empty()) {
+        fprintf(stderr, "no ROMs found in %s\n", NES_ROM_DIR);
+        return 1;
+    }
+
+    printf("%-20s %7s %9s %7s %7s %7s  %-16s\n", "rom", "frames", "fps", "cpu%", "ppu%", "apu%", "frame hash");
+    int failures = 0;
+    double totalSeconds = 0.0;
+    int totalFrames = 0;
+    std::vector<std::string> loaded;
+    std::vector<uint64_t> loadedHashes;
+    for (const std::string &path : roms) {
+        std::string name = std::filesystem::path(path).stem().string();
+        std::vector<uint8_t> rom;
+        if (!bench_read_file(path, rom)) {
+            fprintf(stderr, "%s: unable to read\n", path.c_str());
+            failures += 1;
+            continue;
+        }
+
+        BenchResult throughput = bench_run_throughput(rom, frames);
+        if (throughput.seconds <= 0.0) {
+            fprintf(stderr, "%s: failed to load ROM\n", path.c_str());
+            failures += 1;
+            continue;
+        }
+        totalSeconds += throughput.seconds;
+        totalFrames += frames;
+        loaded.push_back(path);
+        loadedHashes.push_back(throughput.frameHash);
+
+        double fps = (double)frames / throughput.seconds;
+        double busy = throughput.cpuSeconds + throughput.ppuSeconds + throughput.apuSeconds;
+        if (!split || busy <= 0.0) {
+            printf("%-20s %7d %9.1f %7s %7s %7s  %016llx\n", name.c_str(), frames, fps, "-", "-", "-",
+                   (unsigned long long)throughput.frameHash);
+            continue;
+        }
+        printf("%-20s %7d %9.1f %7.1f %7.1f %7.1f  %016llx\n", name.c_str(), frames, fps,
+               100.0 * throughput.cpuSeconds / busy, 100.0 * throughput.ppuSeconds / busy,
+               100.0 * throughput.apuSeconds / busy, (unsigned long long)throughput.frameHash);
+    }
+
+    if (totalSeconds > 0.0) {
+        printf("%-20s %7d %9.1f\n", "total", totalFrames, (double)totalFrames / totalSeconds);
+    }
+    if (batchCopies > 0 && !loaded.empty() && !bench_indexed && bench_scaled_width == 0) {
+        failures += bench_run_batch(loaded, loadedHashes, frames, batchCopies);
+    }
+    return failures == 0 ? 0 : 1;
+}
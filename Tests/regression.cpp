@@ -0,0 +1,478 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "nes_internal.hpp"
+#include "nesc.hpp"
+
+// Frame-hash regression runner. Each ROM plays a fixed controller script and
+// the FNV-1a hashes of the ARGB frame and of the queued audio are compared
+// with the golden file after every checkpoint frame it lists. Lines read
+//   <frame> <frame hash> <audio hash> <rom name>
+// where the name is the ROM file's stem; --print regenerates them. --nestest
+// instead steps the CPU through nestest.nes in automation mode and compares
+// registers and cycle counts with the reference log, line by line.
+// --mmc3-state builds a small MMC3 program in memory and checks that a save
+// state taken mid-frame resumes to the same frames as a run left alone.
+
+static const double regress_sample_rate = 44100.0;
+static const int regress_default_frames = 600;
+static const int regress_default_interval = 60;
+
+typedef struct {
+    int frame;
+    uint8_t buttons;
+} RegressInput;
+
+// Button state from each frame until the next entry. It gets every game past
+// its title screen and into play, with a stretch of idle frames at the end.
+static const RegressInput regress_script[] = {
+    {0, 0},
+    {90, BUTTON_START},
+    {96, 0},
+    {180, BUTTON_START},
+    {186, 0},
+    {240, BUTTON_RIGHT},
+    {300, BUTTON_RIGHT | BUTTON_A},
+    {320, BUTTON_RIGHT},
+    {400, BUTTON_LEFT},
+    {440, BUTTON_RIGHT | BUTTON_B},
+    {500, BUTTON_DOWN},
+    {530, 0},
+    {560, BUTTON_A},
+    {570, BUTTON_RIGHT | BUTTON_B},
+    {900, BUTTON_LEFT | BUTTON_A},
+    {960, 0}
+};
+
+typedef struct {
+    int frame;
+    uint64_t frameHash;
+    uint64_t audioHash;
+} Checkpoint;
+
+static uint64_t regress_hash(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool regress_read_file(const std::string &path, std::vector<uint8_t> &out) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(file);
+        return false;
+    }
+    out.resize((size_t)size);
+    size_t read = fread(out.data(), 1, out.size(), file);
+    fclose(file);
+    return read == out.size();
+}
+
+static std::string regress_rom_name(const std::string &path) {
+    size_t slash = path.find_last_of('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+// Queues the script as frame-stamped presses, so the core applies each one at
+// the start of its frame.
+static void regress_queue_script(NESRef nes) {
+    uint8_t held = 0;
+    for (const RegressInput &entry : regress_script) {
+        for (int bit = 0; bit < 8; bit++) {
+            uint8_t button = (uint8_t)(1 << bit);
+            if ((held ^ entry.buttons) & button) {
+                nes_queue_button(nes, button, (entry.buttons & button) != 0, (uint64_t)entry.frame);
+            }
+        }
+        held = entry.buttons;
+    }
+}
+
+// Plays the ROM up to the last requested checkpoint, filling in both hashes
+// at each one. The audio hash covers every sample queued so far.
+static bool regress_play(const std::vector<uint8_t> &rom, std::vector<Checkpoint> &checkpoints) {
+    NESRef nes = nes_create();
+    nes_apu_set_sample_rate(nes, regress_sample_rate);
+    if (!nes_load_rom(nes, rom.data(), rom.size())) {
+        nes_destroy(nes);
+        return false;
+    }
+    regress_queue_script(nes);
+
+    std::vector<float> audio(4096);
+    uint64_t audioHash = 1469598103934665603ULL;
+    size_t next = 0;
+    for (int frame = 1; next < checkpoints.size(); frame++) {
+        nes_step_frame(nes);
+        int count = nes_apu_available_samples(nes);
+        if (count > (int)audio.size()) {
+            audio.resize((size_t)count);
+        }
+        int read = nes_apu_read_samples(nes, audio.data(), count);
+        audioHash = regress_hash(audioHash, audio.data(), (size_t)read * sizeof(float));
+        while (next < checkpoints.size() && checkpoints[next].frame == frame) {
+            checkpoints[next].frameHash = nes_hash_frame(nes_framebuffer(nes));
+            checkpoints[next].audioHash = audioHash;
+            next++;
+        }
+    }
+    nes_destroy(nes);
+    return true;
+}
+
+// Checkpoints the golden file lists for name, in frame order.
+static bool regress_load_golden(const char *path, const std::string &name, std::vector<Checkpoint> &out) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#' || line[0] == '\n') {
+            continue;
+        }
+        Checkpoint checkpoint;
+        unsigned long long frameHash = 0;
+        unsigned long long audioHash = 0;
+        int consumed = 0;
+        if (sscanf(line, "%d %llx %llx %n", &checkpoint.frame, &frameHash, &audioHash, &consumed) < 3) {
+            continue;
+        }
+        std::string rom = line + consumed;
+        while (!rom.empty() && (rom.back() == '\n' || rom.back() == '\r')) {
+            rom.pop_back();
+        }
+        if (rom != name) {
+            continue;
+        }
+        checkpoint.frameHash = frameHash;
+        checkpoint.audioHash = audioHash;
+        if (!out.empty() && checkpoint.frame <= out.back().frame) {
+            fprintf(stderr, "%s: checkpoints for %s are not in frame order\n", path, name.c_str());
+            fclose(file);
+            return false;
+        }
+        out.push_back(checkpoint);
+    }
+    fclose(file);
+    return true;
+}
+
+static int regress_check(const char *golden, const std::string &path) {
+    std::string name = regress_rom_name(path);
+    std::vector<Checkpoint> expected;
+    if (!regress_load_golden(golden, name, expected)) {
+        fprintf(stderr, "%s: unable to read golden file\n", golden);
+        return 1;
+    }
+    if (expected.empty()) {
+        fprintf(stderr, "%s: no checkpoints in %s\n", name.c_str(), golden);
+        return 1;
+    }
+    std::vector<uint8_t> rom;
+    if (!regress_read_file(path, rom)) {
+        fprintf(stderr, "%s: unable to read\n", path.c_str());
+        return 1;
+    }
+    std::vector<Checkpoint> actual = expected;
+    if (!regress_play(rom, actual)) {
+        fprintf(stderr, "%s: failed to load ROM\n", path.c_str());
+        return 1;
+    }
+
+    int failures = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        bool frameOk = actual[i].frameHash == expected[i].frameHash;
+        bool audioOk = actual[i].audioHash == expected[i].audioHash;
+        if (frameOk && audioOk) {
+            continue;
+        }
+        fprintf(stderr, "%s: frame %d:%s%s got %016llx %016llx, expected %016llx %016llx\n", name.c_str(),
+                expected[i].frame, frameOk ? "" : " video", audioOk ? "" : " audio",
+                (unsigned long long)actual[i].frameHash, (unsigned long long)actual[i].audioHash,
+                (unsigned long long)expected[i].frameHash, (unsigned long long)expected[i].audioHash);
+        failures += 1;
+    }
+    printf("%s: %zu checkpoints, %d mismatched\n", name.c_str(), expected.size(), failures);
+    return failures == 0 ? 0 : 1;
+}
+
+static int regress_print(const std::vector<std::string> &roms, int frames, int interval) {
+    printf("# Frame-hash golden values for Tests/regression.cpp, one checkpoint per line:\n");
+    printf("# <frame> <frame hash> <audio hash> <rom name>\n");
+    printf("# Regenerate with: nes_regress --print --frames %d --interval %d <roms...>\n", frames, interval);
+    int failures = 0;
+    for (const std::string &path : roms) {
+        std::vector<uint8_t> rom;
+        std::vector<Checkpoint> checkpoints;
+        for (int frame = interval; frame <= frames; frame += interval) {
+            checkpoints.push_back({frame, 0, 0});
+        }
+        if (!regress_read_file(path, rom) || !regress_play(rom, checkpoints)) {
+            fprintf(stderr, "%s: unable to run\n", path.c_str());
+            failures += 1;
+            continue;
+        }
+        std::string name = regress_rom_name(path);
+        for (const Checkpoint &checkpoint : checkpoints) {
+            printf("%d %016llx %016llx %s\n", checkpoint.frame, (unsigned long long)checkpoint.frameHash,
+                   (unsigned long long)checkpoint.audioHash, name.c_str());
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+typedef struct {
+    uint16_t pc;
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t p;
+    uint8_t sp;
+    uint64_t cycles;
+    bool hasCycles;
+} NestestLine;
+
+static bool regress_log_field(const char *line, const char *key, unsigned *out) {
+    const char *found = strstr(line, key);
+    return found && sscanf(found + strlen(key), "%x", out) == 1;
+}
+
+// Reads "C000  4C F5 C5  JMP $C5F5   A:00 X:00 Y:00 P:24 SP:FD ... CYC:7".
+static bool regress_parse_nestest(const char *line, NestestLine *out) {
+    unsigned pc, a, x, y, p, sp;
+    if (sscanf(line, "%4x", &pc) != 1 || !regress_log_field(line, "A:", &a) || !regress_log_field(line, "X:", &x) ||
+        !regress_log_field(line, "Y:", &y) || !regress_log_field(line, " P:", &p) ||
+        !regress_log_field(line, "SP:", &sp)) {
+        return false;
+    }
+    out->pc = (uint16_t)pc;
+    out->a = (uint8_t)a;
+    out->x = (uint8_t)x;
+    out->y = (uint8_t)y;
+    out->p = (uint8_t)p;
+    out->sp = (uint8_t)sp;
+    const char *cycles = strstr(line, "CYC:");
+    out->hasCycles = cycles && sscanf(cycles + 4, "%llu", (unsigned long long *)&out->cycles) == 1;
+    return true;
+}
+
+// Bit 4 of P only exists on the stack and bit 5 always reads set, so both
+// are normalised before comparing.
+static uint8_t regress_flags(uint8_t p) {
+    return (uint8_t)((p & ~CPU_FLAG_B) | CPU_FLAG_U);
+}
+
+static int regress_nestest(const std::string &romPath, const char *logPath) {
+    std::vector<uint8_t> rom;
+    if (!regress_read_file(romPath, rom)) {
+        fprintf(stderr, "%s: unable to read\n", romPath.c_str());
+        return 1;
+    }
+    FILE *log = fopen(logPath, "r");
+    if (!log) {
+        fprintf(stderr, "%s: unable to read\n", logPath);
+        return 1;
+    }
+    NES *nes = new NES();
+    if (!nes->loadRom(rom.data(), rom.size(), CART_ROM_COPY)) {
+        fprintf(stderr, "%s: failed to load ROM\n", romPath.c_str());
+        fclose(log);
+        delete nes;
+        return 1;
+    }
+    // Automation mode starts at $C000 with the state the log's first line
+    // shows, seven cycles after reset, and needs no PPU or APU.
+    nes->cpu.pc = 0xC000;
+    nes->cpu.sp = 0xFD;
+    nes->cpu.status = 0x24;
+    uint64_t cycles = 7;
+
+    char line[512];
+    int number = 0;
+    int failures = 0;
+    while (fgets(line, sizeof(line), log)) {
+        NestestLine expected;
+        if (!regress_parse_nestest(line, &expected)) {
+            continue;
+        }
+        number += 1;
+        const CPU &cpu = nes->cpu;
+        bool registersOk = cpu.pc == expected.pc && cpu.a == expected.a && cpu.x == expected.x &&
+                           cpu.y == expected.y && cpu.sp == expected.sp &&
+                           regress_flags(cpu.status) == regress_flags(expected.p);
+        bool cyclesOk = !expected.hasCycles || cycles == expected.cycles;
+        if (!registersOk || !cyclesOk) {
+            fprintf(stderr, "nestest: line %d differs\n  expected %s", number, line);
+            fprintf(stderr, "  got      %04X A:%02X X:%02X Y:%02X P:%02X SP:%02X CYC:%llu\n", cpu.pc, cpu.a, cpu.x,
+                    cpu.y, cpu.status, cpu.sp, (unsigned long long)cycles);
+            failures = 1;
+            break;
+        }
+        cycles += (uint64_t)nes->cpu.step();
+    }
+    fclose(log);
+    delete nes;
+    if (number == 0) {
+        fprintf(stderr, "%s: no log lines\n", logPath);
+        return 1;
+    }
+    printf("nestest: %d lines %s\n", number, failures == 0 ? "matched" : "checked before the first mismatch");
+    return failures;
+}
+
+// Splits the screen at each MMC3 scanline IRQ by toggling the left-column
+// background clip, so every IRQ that lands late or not at all shows in the
+// frame hash. CHR is solid colour 3 and the backdrop black.
+static const uint8_t regress_mmc3_program[] = {
+    0x78,                                     // SEI
+    0xA9, 0x40, 0x8D, 0x17, 0x40,             // LDA #$40, STA $4017
+    0xA9, 0x08, 0x8D, 0x00, 0x20,             // LDA #$08, STA $2000
+    0xAD, 0x02, 0x20,                         // LDA $2002
+    0xA9, 0x3F, 0x8D, 0x06, 0x20,             // LDA #$3F, STA $2006
+    0xA9, 0x00, 0x8D, 0x06, 0x20,             // LDA #$00, STA $2006
+    0xA9, 0x0F, 0x8D, 0x07, 0x20,             // LDA #$0F, STA $2007
+    0xA9, 0x30, 0x8D, 0x07, 0x20,             // LDA #$30, STA $2007
+    0x8D, 0x07, 0x20, 0x8D, 0x07, 0x20,       // STA $2007, STA $2007
+    0xA9, 0x00, 0x8D, 0x06, 0x20, 0x8D, 0x06, 0x20, // LDA #$00, STA $2006 x2
+    0xA9, 0x02, 0x85, 0x10,                   // LDA #$02, STA $10
+    0xA9, 0x0A, 0x8D, 0x01, 0x20,             // LDA #$0A, STA $2001
+    0xA9, 0x15, 0x8D, 0x00, 0xC0,             // LDA #$15, STA $C000
+    0x8D, 0x01, 0xC0, 0x8D, 0x01, 0xE0,       // STA $C001, STA $E001
+    0x58,                                     // CLI
+    0x4C, 0x45, 0xE0,                         // loop: JMP loop ($E045)
+    // irq ($E048)
+    0x8D, 0x00, 0xE0, 0x8D, 0x01, 0xE0,       // STA $E000, STA $E001
+    0xA5, 0x10, 0x49, 0x02, 0x85, 0x10,       // LDA $10, EOR #$02, STA $10
+    0x09, 0x08, 0x8D, 0x01, 0x20,             // ORA #$08, STA $2001
+    0x40,                                     // nmi: RTI
+};
+
+static std::vector<uint8_t> regress_mmc3_rom() {
+    const size_t prgSize = 32768;
+    std::vector<uint8_t> rom(16 + prgSize + 8192, 0);
+    memcpy(rom.data(), "NES\x1a", 4);
+    rom[4] = 2;
+    rom[5] = 1;
+    rom[6] = 0x40;
+    uint8_t *prg = &rom[16];
+    // The last 8 KB bank is fixed at $E000.
+    memcpy(&prg[0x6000], regress_mmc3_program, sizeof(regress_mmc3_program));
+    uint16_t irq = 0xE048;
+    uint16_t nmi = (uint16_t)(0xE000 + sizeof(regress_mmc3_program) - 1);
+    prg[0x7FFA] = (uint8_t)nmi;
+    prg[0x7FFB] = (uint8_t)(nmi >> 8);
+    prg[0x7FFC] = 0x00;
+    prg[0x7FFD] = 0xE0;
+    prg[0x7FFE] = (uint8_t)irq;
+    prg[0x7FFF] = (uint8_t)(irq >> 8);
+    memset(&rom[16 + prgSize], 0xFF, 8192);
+    return rom;
+}
+
+static int regress_mmc3_state(void) {
+    std::vector<uint8_t> rom = regress_mmc3_rom();
+    NESRef played = nes_create();
+    NESRef resumed = nes_create();
+    if (!nes_load_rom(played, rom.data(), rom.size()) || !nes_load_rom(resumed, rom.data(), rom.size())) {
+        fprintf(stderr, "mmc3-state: failed to load ROM\n");
+        nes_destroy(played);
+        nes_destroy(resumed);
+        return 1;
+    }
+    for (int frame = 0; frame < 5; frame++) {
+        nes_step_frame(played);
+    }
+    // Part way down the frame, between IRQs.
+    nes_run_cycles(played, 12000);
+    std::vector<uint8_t> state(nes_save_state_size(played));
+    bool ok = nes_save_state(played, state.data(), state.size()) == state.size() &&
+              nes_load_state(resumed, state.data(), state.size());
+    // States hold no framebuffer, so the frame in progress is only finished;
+    // the frames after it must match.
+    nes_step_frame(played);
+    nes_step_frame(resumed);
+    for (int frame = 0; ok && frame < 5; frame++) {
+        nes_step_frame(played);
+        nes_step_frame(resumed);
+        uint64_t expected = nes_hash_frame(nes_framebuffer(played));
+        uint64_t actual = nes_hash_frame(nes_framebuffer(resumed));
+        if (expected != actual) {
+            fprintf(stderr, "mmc3-state: frame %d after the resumed one: %016llx, expected %016llx\n", frame,
+                    (unsigned long long)actual, (unsigned long long)expected);
+            ok = false;
+        }
+    }
+    nes_destroy(played);
+    nes_destroy(resumed);
+    printf("mmc3-state: %s\n", ok ? "resumed frames matched" : "failed");
+    return ok ? 0 : 1;
+}
+
+static void regress_usage(const char *argv0) {
+    fprintf(stderr, "usage: %s --golden FILE rom.nes ...\n", argv0);
+    fprintf(stderr, "       %s --print [--frames N] [--interval K] rom.nes ...\n", argv0);
+    fprintf(stderr, "       %s --nestest nestest.nes nestest.log\n", argv0);
+    fprintf(stderr, "       %s --mmc3-state\n", argv0);
+}
+
+int main(int argc, char **argv) {
+    const char *golden = NULL;
+    const char *nestestLog = NULL;
+    bool print = false;
+    int frames = regress_default_frames;
+    int interval = regress_default_interval;
+    std::vector<std::string> roms;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--golden") && i + 1 < argc) {
+            golden = argv[++i];
+        } else if (!strcmp(argv[i], "--print")) {
+            print = true;
+        } else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--interval") && i + 1 < argc) {
+            interval = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--nestest") && i + 2 < argc) {
+            roms.push_back(argv[++i]);
+            nestestLog = argv[++i];
+        } else if (!strcmp(argv[i], "--mmc3-state")) {
+            return regress_mmc3_state();
+        } else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+            regress_usage(argv[0]);
+            return 0;
+        } else {
+            roms.push_back(argv[i]);
+        }
+    }
+
+    if (nestestLog && roms.size() == 1) {
+        return regress_nestest(roms[0], nestestLog);
+    }
+    if (roms.empty() || frames <= 0 || interval <= 0 || (!print && !golden)) {
+        regress_usage(argv[0]);
+        return 1;
+    }
+    if (print) {
+        return regress_print(roms, frames, interval);
+    }
+    int failures = 0;
+    for (const std::string &path : roms) {
+        failures += regress_check(golden, path);
+    }
+    return failures == 0 ? 0 : 1;
+}
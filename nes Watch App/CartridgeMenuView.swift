@@ -2,6 +2,7 @@ import SwiftUI
 
 struct CartridgeMenuView: View {
     let romNames: [String]
+    var thumbnails: [String: CGImage] = [:]
     @Binding var selectedIndex: Int
     @Binding var crownValue: Double
     let onSelect: (String) -> Void
@@ -35,6 +36,15 @@ struct CartridgeMenuView: View {
                                                 .fill(index == selectedIndex ? Color.white : Color.white.opacity(0.25))
                                                 .frame(width: 4)
 
+                                            if let thumbnail = thumbnails[romNames[index]] {
+                                                Image(decorative: thumbnail, scale: 1, orientation: .up)
+                                                    .resizable()
+                                                    .interpolation(.none)
+                                                    .scaledToFit()
+                                                    .frame(height: 24)
+                                                    .clipShape(RoundedRectangle(cornerRadius: 3))
+                                            }
+
                                             Text(romNames[index])
                                                 .font(.caption2.weight(index == selectedIndex ? .semibold : .regular))
                                                 .foregroundColor(index == selectedIndex ? .white : .white.opacity(0.7))
@@ -12,12 +12,15 @@ struct ContentView: View {
     @State private var selectedIndex: Int = 0
     @State private var crownValue: Double = 0
     @State private var showingMenu: Bool = true
+    @Environment(\.scenePhase) private var scenePhase
+    @Environment(\.displayScale) private var displayScale
 
     var body: some View {
         ZStack {
             if showingMenu {
                 CartridgeMenuView(
                     romNames: viewModel.romNames,
+                    thumbnails: viewModel.thumbnails,
                     selectedIndex: $selectedIndex,
                     crownValue: $crownValue
                 ) { romName in
@@ -45,6 +48,13 @@ struct ContentView: View {
             }
         }
         .ignoresSafeArea()
+        .onChange(of: scenePhase) { _, phase in
+            if phase == .background {
+                viewModel.suspend()
+            } else if phase == .active {
+                viewModel.resume()
+            }
+        }
         .onAppear {
             if viewModel.romNames.isEmpty {
                 viewModel.loadDefaultRom()
@@ -116,6 +126,12 @@ struct ContentView: View {
                 }
                 .padding(6)
             }
+            .onAppear {
+                viewModel.setDisplaySize(proxy.size, scale: displayScale)
+            }
+            .onChange(of: proxy.size) { _, size in
+                viewModel.setDisplaySize(size, scale: displayScale)
+            }
         }
     }
 }
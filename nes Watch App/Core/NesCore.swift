@@ -4,20 +4,44 @@ import Foundation
 
 typealias NESRef = OpaquePointer
 
+@_silgen_name("nes_rom_info") private func nes_rom_info(_ header: UnsafePointer<UInt8>, _ size: Int, _ info: UnsafeMutablePointer<UInt32>) -> Bool
+@_silgen_name("nes_rom_hash") private func nes_rom_hash(_ data: UnsafePointer<UInt8>, _ size: Int) -> UInt64
 @_silgen_name("nes_create") private func nes_create() -> NESRef?
 @_silgen_name("nes_destroy") private func nes_destroy(_ nes: NESRef)
 @_silgen_name("nes_load_rom") private func nes_load_rom(_ nes: NESRef, _ data: UnsafePointer<UInt8>, _ size: Int) -> Bool
+@_silgen_name("nes_load_rom_file") private func nes_load_rom_file(_ nes: NESRef, _ path: UnsafePointer<CChar>) -> Bool
 @_silgen_name("nes_reset") private func nes_reset(_ nes: NESRef)
 @_silgen_name("nes_step_frame") private func nes_step_frame(_ nes: NESRef)
-@_silgen_name("nes_framebuffer") private func nes_framebuffer(_ nes: NESRef) -> UnsafePointer<UInt32>?
-@_silgen_name("nes_framebuffer_width") private func nes_framebuffer_width() -> Int32
-@_silgen_name("nes_framebuffer_height") private func nes_framebuffer_height() -> Int32
+@_silgen_name("nes_run_elapsed") private func nes_run_elapsed(_ nes: NESRef, _ seconds: Double) -> Int32
+@_silgen_name("nes_set_run_ahead") private func nes_set_run_ahead(_ nes: NESRef, _ frames: Int32) -> Bool
+@_silgen_name("nes_save_state_size") private func nes_save_state_size(_ nes: NESRef) -> Int
+@_silgen_name("nes_save_state") private func nes_save_state(_ nes: NESRef, _ out: UnsafeMutablePointer<UInt8>, _ capacity: Int) -> Int
+@_silgen_name("nes_load_state") private func nes_load_state(_ nes: NESRef, _ data: UnsafePointer<UInt8>, _ size: Int) -> Bool
+@_silgen_name("nes_battery_ram_size") private func nes_battery_ram_size(_ nes: NESRef) -> Int
+@_silgen_name("nes_load_battery_ram") private func nes_load_battery_ram(_ nes: NESRef, _ data: UnsafePointer<UInt8>, _ size: Int) -> Bool
+@_silgen_name("nes_take_battery_ram") private func nes_take_battery_ram(_ nes: NESRef, _ out: UnsafeMutablePointer<UInt8>, _ capacity: Int) -> Int
+@_silgen_name("nes_acquire_frame") private func nes_acquire_frame(_ nes: NESRef) -> UnsafePointer<UInt32>?
+@_silgen_name("nes_release_frame") private func nes_release_frame(_ nes: NESRef, _ pixels: UnsafePointer<UInt32>)
+@_silgen_name("nes_set_scaled_output") private func nes_set_scaled_output(_ nes: NESRef, _ width: Int32, _ height: Int32, _ format: UInt32, _ cropOverscan: Bool) -> Bool
+@_silgen_name("nes_frame_size") private func nes_frame_size(_ frame: UnsafePointer<UInt32>, _ width: UnsafeMutablePointer<Int32>, _ height: UnsafeMutablePointer<Int32>)
 @_silgen_name("nes_set_button") private func nes_set_button(_ nes: NESRef, _ button: UInt8, _ pressed: Bool)
-@_silgen_name("nes_apu_next_sample") private func nes_apu_next_sample(_ nes: NESRef, _ sampleRate: Double) -> Float
-@_silgen_name("nes_apu_fill_buffer") private func nes_apu_fill_buffer(_ nes: NESRef, _ sampleRate: Double, _ out: UnsafeMutablePointer<Float>, _ count: Int32)
+@_silgen_name("nes_apu_set_sample_rate") private func nes_apu_set_sample_rate(_ nes: NESRef, _ sampleRate: Double)
+@_silgen_name("nes_apu_set_target_latency") private func nes_apu_set_target_latency(_ nes: NESRef, _ seconds: Double)
+@_silgen_name("nes_apu_read_samples") private func nes_apu_read_samples(_ nes: NESRef, _ out: UnsafeMutablePointer<Float>, _ count: Int32) -> Int32
+
+struct RomHeaderInfo {
+    let mapper: UInt32
+    let prgSize: UInt32
+    let chrSize: UInt32
+    let mirroring: UInt32
+    let flags: UInt32
+    let supported: Bool
+    let hash: UInt64
+}
 
 final class EmulatorCore {
     private var nes: NESRef?
+    private static let colorSpace = CGColorSpaceCreateDeviceRGB()
 
     init() {
         nes = nes_create()
@@ -38,6 +62,35 @@ final class EmulatorCore {
         }
     }
 
+    /// Maps the ROM file instead of reading it, so the core runs it in place.
+    func loadRom(at url: URL) -> Bool {
+        guard let nes else { return false }
+        return url.withUnsafeFileSystemRepresentation { path in
+            guard let path else { return false }
+            return nes_load_rom_file(nes, path)
+        }
+    }
+
+    /// Header fields and content hash of a ROM file, without loading it.
+    static func romInfo(at url: URL) -> RomHeaderInfo? {
+        guard let data = try? Data(contentsOf: url, options: .alwaysMapped) else { return nil }
+        return data.withUnsafeBytes { buffer -> RomHeaderInfo? in
+            guard let base = buffer.bindMemory(to: UInt8.self).baseAddress else { return nil }
+            // NesRomInfo is six uint32_t fields.
+            var fields = [UInt32](repeating: 0, count: 6)
+            guard nes_rom_info(base, data.count, &fields) else { return nil }
+            return RomHeaderInfo(
+                mapper: fields[0],
+                prgSize: fields[1],
+                chrSize: fields[2],
+                mirroring: fields[3],
+                flags: fields[4],
+                supported: fields[5] != 0,
+                hash: nes_rom_hash(base, data.count)
+            )
+        }
+    }
+
     func reset() {
         guard let nes else { return }
         nes_reset(nes)
@@ -48,15 +101,96 @@ final class EmulatorCore {
         nes_step_frame(nes)
     }
 
+    /// Runs the frames `seconds` of wall time are worth, drawing only the
+    /// last, and returns how many ran.
+    @discardableResult
+    func run(elapsed seconds: Double) -> Int {
+        guard let nes else { return 0 }
+        return Int(nes_run_elapsed(nes, seconds))
+    }
+
+    /// Frames drawn ahead of the real one to hide input lag; 0 turns it off.
+    @discardableResult
+    func setRunAhead(frames: Int) -> Bool {
+        guard let nes else { return false }
+        return nes_set_run_ahead(nes, Int32(frames))
+    }
+
+    /// Has the core draw frames at the display's pixel size, overscan
+    /// cropped, instead of leaving SwiftUI to resize every 256x240 frame.
+    /// 0 returns to full size. Call on the queue that runs the frames.
+    @discardableResult
+    func setOutputSize(width: Int, height: Int) -> Bool {
+        guard let nes else { return false }
+        // 0 is NES_PIXEL_ARGB8888, the layout currentFrameImage wraps.
+        return nes_set_scaled_output(nes, Int32(width), Int32(height), 0, true)
+    }
+
+    func saveState() -> Data? {
+        guard let nes else { return nil }
+        let size = nes_save_state_size(nes)
+        guard size > 0 else { return nil }
+        var data = Data(count: size)
+        let written = data.withUnsafeMutableBytes { buffer -> Int in
+            guard let base = buffer.bindMemory(to: UInt8.self).baseAddress else { return 0 }
+            return nes_save_state(nes, base, size)
+        }
+        return written == size ? data : nil
+    }
+
+    func loadState(_ data: Data) -> Bool {
+        guard let nes else { return false }
+        return data.withUnsafeBytes { buffer in
+            guard let base = buffer.bindMemory(to: UInt8.self).baseAddress else { return false }
+            return nes_load_state(nes, base, data.count)
+        }
+    }
+
+    func loadBatteryRam(_ data: Data) -> Bool {
+        guard let nes else { return false }
+        return data.withUnsafeBytes { buffer in
+            guard let base = buffer.bindMemory(to: UInt8.self).baseAddress else { return false }
+            return nes_load_battery_ram(nes, base, data.count)
+        }
+    }
+
+    /// A copy of battery RAM if the game wrote to it since the last call.
+    func takeBatteryRam() -> Data? {
+        guard let nes else { return nil }
+        let size = nes_battery_ram_size(nes)
+        guard size > 0 else { return nil }
+        var data = Data(count: size)
+        let taken = data.withUnsafeMutableBytes { buffer -> Int in
+            guard let base = buffer.bindMemory(to: UInt8.self).baseAddress else { return 0 }
+            return nes_take_battery_ram(nes, base, size)
+        }
+        return taken == size ? data : nil
+    }
+
     func currentFrameImage() -> CGImage? {
         guard let nes else { return nil }
-        guard let buffer = nes_framebuffer(nes) else { return nil }
-        let width = Int(nes_framebuffer_width())
-        let height = Int(nes_framebuffer_height())
+        guard let pixels = nes_acquire_frame(nes) else { return nil }
+        var frameWidth: Int32 = 0
+        var frameHeight: Int32 = 0
+        nes_frame_size(pixels, &frameWidth, &frameHeight)
+        let width = Int(frameWidth)
+        let height = Int(frameHeight)
         let count = width * height
-        let data = Data(bytes: buffer, count: count * MemoryLayout<UInt32>.size)
-        guard let provider = CGDataProvider(data: data as CFData) else { return nil }
-        let colorSpace = CGColorSpaceCreateDeviceRGB()
+        // The image borrows the pinned frame; the core leaves it alone until
+        // CoreGraphics drops the provider and the frame is released.
+        let releaseFrame: CGDataProviderReleaseDataCallback = { info, data, _ in
+            guard let info else { return }
+            nes_release_frame(OpaquePointer(info), data.assumingMemoryBound(to: UInt32.self))
+        }
+        guard let provider = CGDataProvider(
+            dataInfo: UnsafeMutableRawPointer(nes),
+            data: pixels,
+            size: count * MemoryLayout<UInt32>.size,
+            releaseData: releaseFrame
+        ) else {
+            nes_release_frame(nes, pixels)
+            return nil
+        }
         let bitmapInfo = CGBitmapInfo.byteOrder32Little.union(
             CGBitmapInfo(rawValue: CGImageAlphaInfo.premultipliedFirst.rawValue)
         )
@@ -67,7 +201,7 @@ final class EmulatorCore {
             bitsPerComponent: 8,
             bitsPerPixel: 32,
             bytesPerRow: width * 4,
-            space: colorSpace,
+            space: Self.colorSpace,
             bitmapInfo: bitmapInfo,
             provider: provider,
             decode: nil,
@@ -93,11 +227,11 @@ final class CAudioEngine {
     private var format: AVAudioFormat?
     private var sourceNode: AVAudioSourceNode?
     private var observers: [NSObjectProtocol] = []
-    private var ring = AudioRingBuffer(capacity: 88200)
     private var sampleRate: Double = 44100
-    private var samplesPerFrame: Int = 735
-    private let audioQueue = DispatchQueue(label: "nes.audio.queue", qos: .userInitiated)
-    private var audioTimer: DispatchSourceTimer?
+    /// Audio queued ahead of the render callback. The core's rate control
+    /// holds the queue here, so it only has to cover one emulation tick and
+    /// one render quantum rather than clock drift.
+    private static let targetLatency = 0.04
 
     init(nes: NESRef) {
         self.nes = nes
@@ -117,7 +251,7 @@ final class CAudioEngine {
 
     func stop() {
         engine.pause()
-        stopProducer()
+        nes_apu_set_sample_rate(nes, 0)
     }
 
     func shutdown() {
@@ -126,7 +260,7 @@ final class CAudioEngine {
             engine.detach(node)
             sourceNode = nil
         }
-        stopProducer()
+        nes_apu_set_sample_rate(nes, 0)
     }
 
     deinit {
@@ -164,12 +298,14 @@ final class CAudioEngine {
         let activeFormat = AVAudioFormat(standardFormatWithSampleRate: sampleRate, channels: channelCount)!
         format = activeFormat
         self.sampleRate = sampleRate
-        self.samplesPerFrame = max(1, Int(sampleRate / 60.0))
-        ring = AudioRingBuffer(capacity: max(4096, Int(sampleRate * 3)))
+        nes_apu_set_sample_rate(nes, sampleRate)
+        nes_apu_set_target_latency(nes, Self.targetLatency)
 
         if sourceNode == nil {
-            let source = AVAudioSourceNode { [weak self] _, _, frameCount, audioBufferList -> OSStatus in
-                guard let self else { return noErr }
+            // The emulation thread queues samples as it clocks the APU; the
+            // render block drains them without taking a lock.
+            let nes = self.nes
+            let source = AVAudioSourceNode { _, _, frameCount, audioBufferList -> OSStatus in
                 let bufferList = UnsafeMutableAudioBufferListPointer(audioBufferList)
                 let frameCountInt = Int(frameCount)
                 if bufferList.count == 0 {
@@ -179,10 +315,7 @@ final class CAudioEngine {
                 guard let firstData = bufferList[0].mData else { return noErr }
                 bufferList[0].mDataByteSize = UInt32(bytes)
                 let firstSamples = firstData.assumingMemoryBound(to: Float.self)
-                let read = self.ring.read(into: firstSamples, count: frameCountInt)
-                if read < frameCountInt {
-                    firstSamples.advanced(by: read).initialize(repeating: 0, count: frameCountInt - read)
-                }
+                _ = nes_apu_read_samples(nes, firstSamples, Int32(frameCountInt))
                 if bufferList.count > 1 {
                     for bufferIndex in 1..<bufferList.count {
                         guard let mData = bufferList[bufferIndex].mData else { continue }
@@ -212,8 +345,6 @@ final class CAudioEngine {
                 }
             }
         }
-
-        startProducer()
     }
 
     private func rebuildEngine() {
@@ -223,8 +354,6 @@ final class CAudioEngine {
         }
         sourceNode = nil
         format = nil
-        ring.clear()
-        stopProducer()
         engine = AVAudioEngine()
         start(rebuildIfNeeded: false)
     }
@@ -240,124 +369,4 @@ final class CAudioEngine {
             }
         }
     }
-
-    func enqueueSamples() {
-        let count = samplesPerFrame
-        if count <= 0 {
-            return
-        }
-        let targetFill = max(count * 2, Int(sampleRate * 0.25))
-        var attempts = 0
-        while ring.availableToRead < targetFill && ring.availableToWrite >= count && attempts < 4 {
-            var temp = Array(repeating: Float(0), count: count)
-            temp.withUnsafeMutableBufferPointer { buffer in
-                guard let base = buffer.baseAddress else { return }
-                nes_apu_fill_buffer(nes, sampleRate, base, Int32(count))
-            }
-            _ = ring.write(temp, count: count)
-            attempts += 1
-        }
-    }
-
-    private func startProducer() {
-        if audioTimer != nil {
-            return
-        }
-        let timer = DispatchSource.makeTimerSource(queue: audioQueue)
-        timer.schedule(deadline: .now(), repeating: 1.0 / 240.0)
-        timer.setEventHandler { [weak self] in
-            self?.enqueueSamples()
-        }
-        audioTimer = timer
-        timer.resume()
-    }
-
-    private func stopProducer() {
-        audioTimer?.cancel()
-        audioTimer = nil
-    }
-
-}
-
-private final class AudioRingBuffer {
-    private var buffer: [Float]
-    private var readIndex = 0
-    private var writeIndex = 0
-    private var count = 0
-    private let lock = NSLock()
-
-    init(capacity: Int) {
-        buffer = Array(repeating: 0, count: max(1, capacity))
-    }
-
-    func clear() {
-        lock.lock()
-        readIndex = 0
-        writeIndex = 0
-        count = 0
-        lock.unlock()
-    }
-
-    var availableToRead: Int {
-        lock.lock()
-        let value = count
-        lock.unlock()
-        return value
-    }
-
-    var availableToWrite: Int {
-        lock.lock()
-        let value = buffer.count - count
-        lock.unlock()
-        return value
-    }
-
-    func write(_ samples: [Float], count writeCount: Int) -> Int {
-        if writeCount <= 0 {
-            return 0
-        }
-        lock.lock()
-        let capacity = buffer.count
-        let space = capacity - count
-        let toWrite = min(writeCount, space)
-        if toWrite > 0 {
-            let first = min(toWrite, capacity - writeIndex)
-            for i in 0..<first {
-                buffer[writeIndex + i] = samples[i]
-            }
-            if toWrite > first {
-                for i in 0..<(toWrite - first) {
-                    buffer[i] = samples[first + i]
-                }
-            }
-            writeIndex = (writeIndex + toWrite) % capacity
-            count += toWrite
-        }
-        lock.unlock()
-        return toWrite
-    }
-
-    func read(into out: UnsafeMutablePointer<Float>, count readCount: Int) -> Int {
-        if readCount <= 0 {
-            return 0
-        }
-        lock.lock()
-        let capacity = buffer.count
-        let toRead = min(readCount, count)
-        if toRead > 0 {
-            let first = min(toRead, capacity - readIndex)
-            for i in 0..<first {
-                out[i] = buffer[readIndex + i]
-            }
-            if toRead > first {
-                for i in 0..<(toRead - first) {
-                    out[first + i] = buffer[i]
-                }
-            }
-            readIndex = (readIndex + toRead) % capacity
-            count -= toRead
-        }
-        lock.unlock()
-        return toRead
-    }
 }
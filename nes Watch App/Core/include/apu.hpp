@@ -1,18 +1,71 @@
 #ifndef NESC_APU_H
 #define NESC_APU_H
 
+#include "blip_buffer.hpp"
+#include "profile.hpp"
+#include "save_state.hpp"
 #include "types.hpp"
-#include <pthread.h>
+#include <atomic>
 
 typedef uint8_t (*ApuReadFunc)(void *context, uint16_t addr);
 
+// Room for the five frames a throttled host may run in one tick at 48 kHz.
+// The steady-state fill is the target latency, which rate control holds.
+#define APU_RING_CAPACITY 4096
+// Largest resampling ratio change rate control may apply; 0.5% is below
+// the pitch change a listener can hear.
+#define APU_RATE_CONTROL_MAX 0.005f
+#define APU_RATE_CONTROL_SMOOTHING 0.125f
+// CPU cycles a DMC sample fetch halts the CPU for (3 when it lands on a
+// write cycle, 2 during OAM DMA; the common case is used).
+#define APU_DMC_STALL_CYCLES 4
+
+// Single-producer/single-consumer sample queue between the emulation thread,
+// which writes as the APU is clocked, and the host audio render callback,
+// which drains it. Neither side takes a lock.
+class ApuSampleRing {
+public:
+    ApuSampleRing() : readIndex(0), writeIndex(0), requestedSampleRate(0), requestedLatency(0), primed(false) {}
+
+    bool push(float sample);
+    int write(const float *in, int count);
+    int read(float *out, int count);
+    int available() const;
+    // Drops queued samples. Consumer side only, like read().
+    void clear();
+
+    void setSampleRate(uint32_t rate) { requestedSampleRate.store(rate, std::memory_order_relaxed); }
+    uint32_t sampleRate() const { return requestedSampleRate.load(std::memory_order_relaxed); }
+    // Fill level, in microseconds of audio, that rate control steers the
+    // ring towards; 0 turns rate control off.
+    void setTargetLatency(uint32_t micros) { requestedLatency.store(micros, std::memory_order_relaxed); }
+    uint32_t targetLatency() const { return requestedLatency.load(std::memory_order_relaxed); }
+#if NESC_PROFILE
+    uint64_t starvedSamples() const { return starved.load(std::memory_order_relaxed); }
+#endif
+
+private:
+    float samples[APU_RING_CAPACITY];
+    std::atomic<uint32_t> readIndex;
+    std::atomic<uint32_t> writeIndex;
+    std::atomic<uint32_t> requestedSampleRate;
+    std::atomic<uint32_t> requestedLatency;
+#if NESC_PROFILE
+    // Samples the consumer asked for but the queue could not supply.
+    std::atomic<uint64_t> starved{0};
+#endif
+    // Consumer only: with a target latency, reads output silence until the
+    // queue first reaches it, and again after running dry, rather than
+    // playing every sample the moment it arrives at an almost empty fill.
+    bool primed;
+};
+
 class PulseChannel {
 public:
     uint8_t control;
     uint16_t timer;
     uint8_t lengthCounter;
     bool enabled;
-    double phase;
     uint8_t envDivider;
     uint8_t envDecay;
     bool envStart;
@@ -24,6 +77,8 @@ public:
     bool sweepReload;
     bool sweepMute;
     bool sweepOnesComplement;
+    uint16_t timerCounter;
+    uint8_t dutyPos;
 
     void writeControl(uint8_t data);
     void writeSweep(uint8_t data);
@@ -33,7 +88,8 @@ public:
     void tickLength();
     void tickEnvelope();
     void tickSweep();
-    double sample(double sampleRate);
+    void tickTimer();
+    uint8_t output() const;
 
 private:
     void applySweep();
@@ -59,7 +115,7 @@ public:
     void tickLength();
     void tickLinear();
     void tickTimer();
-    double sample() const;
+    uint8_t output() const;
 };
 
 class NoiseChannel {
@@ -81,7 +137,7 @@ public:
     void tickLength();
     void tickEnvelope();
     void tickTimer();
-    double sample() const;
+    uint8_t output() const;
 };
 
 class DmcChannel {
@@ -108,14 +164,23 @@ public:
     void writeSampleAddress(uint8_t data);
     void writeSampleLength(uint8_t data);
     void setEnabled(bool value);
-    void fetchSample(ApuReadFunc read, void *context);
+    bool fetchSample(ApuReadFunc read, void *context);
     void tickTimer();
-    double sample() const;
+    uint8_t output() const;
 
 private:
     void restart();
 };
 
+typedef enum {
+    APU_SYNTH_BAND_LIMITED = 0,
+    APU_SYNTH_POINT_SAMPLED = 1
+} ApuSynthesisMode;
+
+// Longest run of CPU cycles buffered for band-limited synthesis before it is
+// flushed to the output ring without waiting for endFrame.
+#define APU_BLIP_FLUSH_CLOCKS 32768
+
 class APU {
 public:
     PulseChannel pulse1;
@@ -126,26 +191,58 @@ public:
     int frameCounterCycle;
     bool frameCounterMode;
     bool frameIrqInhibit;
-    double outputFilter;
-    double sampleCycleRemainder;
-    pthread_mutex_t mutex;
+    float outputFilter;
+    float filterAlpha;
+    uint32_t activeSampleRate;
+    uint32_t sampleStep;
+    uint32_t samplePhase;
     ApuReadFunc read;
     void *readContext;
+    ApuSampleRing *output;
+    ApuSynthesisMode synthesis;
+    bool muted;
+    bool oddCycle;
+    uint32_t blipClock;
+    uint32_t blipLevels;
+    float blipLevel;
+    BlipBuffer blip;
+    float rateScale;
+    float fillAverage;
+    // DMC fetch cycles since the caller last moved them onto the CPU.
+    int dmcStallCycles;
+#if NESC_PROFILE
+    ProfileCounters *profile;
+#endif
 
     void init();
     void reset();
     void setReadCallback(ApuReadFunc readFunc, void *context);
+    void setOutput(ApuSampleRing *ring);
     void cpuWrite(uint16_t addr, uint8_t data);
     uint8_t readStatus();
+    void setSynthesis(ApuSynthesisMode mode);
     void step(int cycles);
-    float nextSample(double sample_rate);
-    void fillBuffer(double sample_rate, float *out, int count);
+    // CPU cycles step can run before the DMC next fetches a sample; each
+    // fetch stalls the CPU, so a caller batching cycles must stop short.
+    uint32_t quietCycles() const;
+    void endFrame();
+    // Channel and frame counter state only. Output settings and queued
+    // samples belong to the host and are kept across loadState.
+    void saveState(StateWriter &state) const;
+    void loadState(StateReader &state);
 
 private:
     void quarterFrame();
     void halfFrame();
-    void stepCyclesUnlocked(int cycles);
-    float nextSampleUnlocked(double sample_rate);
+    void clockFrameCounter();
+    void clockChannels();
+    void stepBandLimited(int cycles);
+    void stepPointSampled(int cycles);
+    uint32_t channelLevels() const;
+    void updateSampleRate(uint32_t rate);
+    void controlRate(int fill);
+    float mixLevels(uint32_t levels) const;
+    float nextSample();
 };
 
 #endif
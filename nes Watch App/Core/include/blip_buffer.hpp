@@ -0,0 +1,36 @@
+#ifndef NESC_BLIP_BUFFER_H
+#define NESC_BLIP_BUFFER_H
+
+#include "types.hpp"
+
+#define BLIP_PHASE_BITS 5
+#define BLIP_PHASES (1 << BLIP_PHASE_BITS)
+#define BLIP_TAPS 16
+#define BLIP_MAX_SAMPLES 4096
+
+// Band-limited step synthesis. Callers add amplitude deltas at source clock
+// times within a frame; endFrame converts the frame's clocks into output
+// samples, which readSamples integrates through a precomputed windowed-sinc
+// kernel, so the output has no aliasing from the instantaneous steps.
+class BlipBuffer {
+public:
+    void setRates(double clockRate, double sampleRate);
+    // Scales the output rate set by setRates, between frames only.
+    void setRateScale(double scale) { factor = (uint64_t)((double)baseFactor * scale); }
+    void clear();
+    void addDelta(uint32_t clockTime, float delta);
+    void endFrame(uint32_t clockDuration);
+    int samplesAvailable() const { return avail; }
+    int readSamples(float *out, int count);
+
+private:
+    uint64_t baseFactor;
+    uint64_t factor;
+    uint64_t offset;
+    int avail;
+    float integrator;
+    float leak;
+    float buffer[BLIP_MAX_SAMPLES + BLIP_TAPS];
+};
+
+#endif
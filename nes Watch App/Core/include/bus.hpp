@@ -4,52 +4,57 @@
 #include "apu.hpp"
 #include "controller.hpp"
 #include "ppu.hpp"
-#include <string.h>
+#include "profile.hpp"
 
 class CPU;
+class InputQueue;
 
 class Bus {
 public:
-    CPU *cpu;
-    PPU *ppu;
-    APU *apu;
-    Cartridge *cartridge;
+    CPU *cpu = nullptr;
+    PPU *ppu = nullptr;
+    APU *apu = nullptr;
+    Cartridge *cartridge = nullptr;
     Controller controller;
-
-    uint8_t cpuRam[2048];
-    uint8_t prgRam[8192];
-    uint8_t dataBus;
-
-    bool irqPending;
-    int stallCycles;
-
-    bool dmaActive;
-    uint8_t dmaPage;
-    uint16_t dmaIndex;
-    int dmaCycle;
-    uint8_t dmaData;
-
-    Bus() {
-        memset(this, 0, sizeof(Bus));
-    }
+    InputQueue *input = nullptr;
+
+    uint8_t cpuRam[2048] = {};
+    uint8_t prgRam[8192] = {};
+    // Set when a write changes PRG RAM; battery saves are only written
+    // while it is raised.
+    bool prgRamDirty = false;
+    uint8_t dataBus = 0;
+
+    bool irqPending = false;
+    // CPU cycles owed to OAM and DMC DMA, paid in one step before the next
+    // instruction.
+    int stallCycles = 0;
+#if NESC_PROFILE
+    ProfileCounters *profile = nullptr;
+#endif
 
     uint8_t cpuRead(uint16_t addr);
     uint8_t cpuReadOpcode(uint16_t addr);
     void cpuWrite(uint16_t addr, uint8_t data);
+    // Reads RAM, PRG RAM or mapped PRG ROM without touching the data bus;
+    // false for anything else, where a read could have side effects.
+    bool peek(uint16_t addr, uint8_t *value) const;
 
     bool isIrqPending();
     void ackIrq();
     void tick(int cycles);
 
     void requestStall(int cycles);
-    bool consumeStall();
+    int takeStall();
 
     void setCpuBus(uint8_t value);
 
+    void saveState(StateWriter &state) const;
+    void loadState(StateReader &state);
+
 private:
     uint8_t cpuReadInternal(uint16_t addr);
     void startDma(uint8_t page);
-    void stepDma();
 };
 
 #endif
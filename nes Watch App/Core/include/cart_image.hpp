@@ -0,0 +1,33 @@
+#ifndef NESC_CART_IMAGE_H
+#define NESC_CART_IMAGE_H
+
+#include "types.hpp"
+#include <atomic>
+
+// Immutable iNES image, either copied onto the heap or mapped read-only from
+// a file, that any number of cartridges read PRG and CHR ROM from in place.
+// It is reference counted so consoles on different threads can share one
+// copy of a ROM; the last release frees it. Both constructors validate the
+// header and size and return NULL for anything a cartridge would reject.
+class CartImage {
+public:
+    static CartImage *copy(const uint8_t *data, size_t size);
+    static CartImage *map(const char *path);
+
+    void retain();
+    void release();
+
+    const uint8_t *data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    CartImage(const uint8_t *bytes, size_t length, bool mapped);
+    ~CartImage();
+
+    const uint8_t *bytes;
+    size_t length;
+    bool mapped;
+    std::atomic<uint32_t> references;
+};
+
+#endif
@@ -1,38 +1,116 @@
 #ifndef NESC_CARTRIDGE_H
 #define NESC_CARTRIDGE_H
 
+#include "cart_image.hpp"
 #include "mapper/mapper.hpp"
 #include <memory>
 
+#define CART_PRG_PAGE_SIZE 0x2000
+#define CART_PRG_PAGE_COUNT 4
+#define CART_CHR_PAGE_SIZE 0x0400
+#define CART_CHR_PAGE_COUNT 8
+
+typedef enum {
+    // PRG and CHR ROM are copied out of the image, which can then be freed.
+    CART_ROM_COPY = 0,
+    // The ROM is used in place; the image must outlive the cartridge.
+    CART_ROM_BORROW = 1
+} CartRomStorage;
+
+typedef struct {
+    uint8_t mapperID;
+    uint8_t prgBanks;
+    uint8_t chrBanks;
+    Mirroring mirroring;
+    bool hasBattery;
+    bool hasTrainer;
+    bool fourScreen;
+    size_t prgOffset;
+    size_t prgSize;
+    size_t chrSize;
+} CartHeader;
+
+// Reads only the 16-byte iNES header; the ROM body is neither checked nor
+// touched.
+bool cart_parse_header(const uint8_t *data, size_t size, CartHeader *out);
+bool cart_mapper_supported(uint8_t mapperID);
+uint64_t cart_rom_hash(const uint8_t *prg, size_t prgSize, const uint8_t *chr, size_t chrSize);
+
 class Cartridge {
 public:
-    uint8_t *prgROM;
+    const uint8_t *prgROM;
     size_t prgSize;
-    uint8_t *chrROM;
+    const uint8_t *chrROM;
     size_t chrSize;
+    uint8_t *chrRam;
     uint8_t mapperID;
     Mirroring mirroring;
     bool hasChrRam;
+    bool hasBattery;
+    // Level-triggered mapper IRQ, held until the game acknowledges it.
+    bool irqLine;
     std::unique_ptr<Mapper> mapper;
 
+    // Page tables rebuilt by Mapper::updateBanks: 8 KB PRG slots for
+    // $8000-$FFFF and 1 KB CHR slots for $0000-$1FFF. A null slot is unmapped.
+    const uint8_t *prgPages[CART_PRG_PAGE_COUNT];
+    const uint8_t *chrPages[CART_CHR_PAGE_COUNT];
+    // A bit per CHR slot whose contents may have changed under the PPU's
+    // decoded-tile cache: remapped, or CHR RAM restored from a state. The PPU
+    // clears it once it has dropped those tiles.
+    uint8_t chrPagesChanged;
+
     Cartridge()
         : prgROM(nullptr),
           prgSize(0),
           chrROM(nullptr),
           chrSize(0),
+          chrRam(nullptr),
           mapperID(0),
           mirroring(MIRROR_HORIZONTAL),
           hasChrRam(false),
-          mapper(nullptr) {}
+          hasBattery(false),
+          irqLine(false),
+          mapper(nullptr),
+          prgPages(),
+          chrPages(),
+          chrPagesChanged(0xFF),
+          image(nullptr),
+          romHash(0) {}
 
     ~Cartridge() { free(); }
 
     void free();
-    bool load(const uint8_t *data, size_t size);
+    bool load(const uint8_t *data, size_t size, CartRomStorage storage = CART_ROM_COPY);
+    // Reads the ROM from a shared image, holding a reference until free().
+    bool loadImage(CartImage *shared);
+    // Maps the file read-only and reads the ROM from the mapping.
+    bool loadFile(const char *path);
+    uint64_t identity();
     bool cpuRead(uint16_t addr, uint8_t *out) const;
     bool cpuWrite(uint16_t addr, uint8_t data);
     bool ppuRead(uint16_t addr, uint8_t *out) const;
     bool ppuWrite(uint16_t addr, uint8_t data);
+
+    void saveState(StateWriter &state) const;
+    void loadState(StateReader &state);
+
+    void mapPrg(uint16_t addr, size_t offset, size_t size);
+    void mapChr(uint16_t addr, size_t offset, size_t size);
+
+    const uint8_t *prgPage(uint16_t addr) const {
+        return prgPages[(addr >> 13) & 0x03];
+    }
+
+    const uint8_t *chrPage(uint16_t addr) const {
+        return chrPages[(addr >> 10) & 0x07];
+    }
+
+private:
+    bool attach(const uint8_t *data, size_t size);
+
+    CartImage *image;
+    uint64_t romHash;
 };
 
 #endif
@@ -3,6 +3,17 @@
 
 #include "types.hpp"
 
+typedef enum {
+    BUTTON_A = 0x01,
+    BUTTON_B = 0x02,
+    BUTTON_SELECT = 0x04,
+    BUTTON_START = 0x08,
+    BUTTON_UP = 0x10,
+    BUTTON_DOWN = 0x20,
+    BUTTON_LEFT = 0x40,
+    BUTTON_RIGHT = 0x80
+} ControllerButton;
+
 class Controller {
 public:
     uint8_t state;
@@ -2,7 +2,7 @@
 #define NESC_CPU_H
 
 #include "bus.hpp"
-#include <string.h>
+#include "profile.hpp"
 
 typedef enum {
     CPU_FLAG_C = 0x01,
@@ -37,41 +37,41 @@ typedef enum {
     ACCESS_IMPLIED
 } AccessKind;
 
-class CPU;
-
-typedef uint8_t (*cpu_op)(class CPU *cpu);
+// Longest loop body, in bytes from head to branch, findIdleLoop looks at.
+#define CPU_IDLE_LOOP_BYTES 16
 
+// A loop of pure instructions CPU::findIdleLoop accepted: straight-line
+// code from head to a branch or JMP at branch that goes back to head, doing
+// nothing but register work and reads of RAM, PRG or PPUSTATUS. Once one
+// pass leaves the registers as it found them, every further pass does the
+// same until an interrupt or a change in what it reads. cycles is the cost
+// of one pass, 0 when the code is not such a loop and -1 before any.
 typedef struct {
-    const char *name;
-    cpu_op operate;
-    cpu_op addrMode;
-    AddressingMode mode;
-    AccessKind access;
-    uint8_t cycles;
-} Instruction;
+    uint16_t head;
+    uint16_t branch;
+    int cycles;
+    bool readsStatus;
+} IdleLoop;
 
 class CPU {
 public:
-    Bus *bus;
-    uint8_t a;
-    uint8_t x;
-    uint8_t y;
-    uint8_t sp;
-    uint16_t pc;
-    uint8_t status;
-    uint8_t fetched;
-    uint16_t addrAbs;
-    uint16_t addrRel;
-    uint8_t opcode;
-    uint8_t baseHigh;
-    int cycleCounter;
-    Instruction instructions[256];
-
-    CPU() {
-        memset(this, 0, sizeof(CPU));
-    }
+    Bus *bus = nullptr;
+    uint8_t a = 0;
+    uint8_t x = 0;
+    uint8_t y = 0;
+    uint8_t sp = 0;
+    uint16_t pc = 0;
+    uint8_t status = 0;
+    uint8_t fetched = 0;
+    uint16_t addrAbs = 0;
+    uint16_t addrRel = 0;
+    uint8_t opcode = 0;
+    uint8_t baseHigh = 0;
+    int cycleCounter = 0;
+#if NESC_PROFILE
+    ProfileCounters *profile = nullptr;
+#endif
 
-    void init();
     void reset();
     void irq();
     void nmi();
@@ -83,8 +83,10 @@ public:
     uint8_t getFlag(CPUFlag flag);
     void setFlag(CPUFlag flag, bool value);
     void setZN(uint8_t value);
-    uint8_t fetch();
     void impliedDummyRead();
+    bool findIdleLoop(uint16_t head, uint16_t branch, IdleLoop *loop) const;
+    void saveState(StateWriter &state) const;
+    void loadState(StateReader &state);
 };
 
 #endif
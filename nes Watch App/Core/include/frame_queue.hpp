@@ -0,0 +1,48 @@
+#ifndef NESC_FRAME_QUEUE_H
+#define NESC_FRAME_QUEUE_H
+
+#include "types.hpp"
+#include <atomic>
+
+#define NES_FRAME_BUFFERS 3
+
+// Rotating framebuffers shared between the emulation thread, which renders
+// into the back buffer and publishes it when a frame completes, and the host,
+// which pins the newest completed frame while it is on screen. A pinned
+// buffer is never rendered into, so the host can wrap it without copying.
+// Each buffer is sized for the frame last drawn into it and resized when it
+// next comes round as the back buffer, so a mode with smaller frames shrinks
+// all three within a few frames.
+class FrameQueue {
+public:
+    FrameQueue();
+    ~FrameQueue();
+
+    // Emulation thread.
+    FrameBuffer *backBuffer() { return buffers[backIndex].load(); }
+    // Resizes the back buffer's storage to bytes and returns it. A buffer
+    // the host has pinned keeps its storage, so check capacity.
+    FrameBuffer *reserve(size_t bytes);
+    // Returns the buffer to render next. When the host has pinned both
+    // others it is the frame just finished, which then counts as dropped
+    // rather than shown.
+    FrameBuffer *publish();
+    const FrameBuffer *latest() const;
+    uint64_t droppedFrames() const { return dropped; }
+
+    // Any thread.
+    const uint32_t *acquire();
+    void release(const uint32_t *pixels);
+
+private:
+    // Swapped on resize; the host only compares them.
+    std::atomic<FrameBuffer *> buffers[NES_FRAME_BUFFERS];
+    std::atomic<uint32_t> holds[NES_FRAME_BUFFERS];
+    std::atomic<int> latestIndex;
+    int backIndex;
+    uint64_t dropped;
+
+    int freeBuffer(int published) const;
+};
+
+#endif
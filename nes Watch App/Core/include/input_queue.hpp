@@ -0,0 +1,39 @@
+#ifndef NESC_INPUT_QUEUE_H
+#define NESC_INPUT_QUEUE_H
+
+#include "controller.hpp"
+#include <atomic>
+
+#define NES_INPUT_QUEUE_CAPACITY 256
+
+typedef struct {
+    uint64_t frame;
+    uint8_t button;
+    bool pressed;
+} ControllerEvent;
+
+// Single-producer/single-consumer queue of button changes from the host
+// thread to the emulation thread, which owns the controller. Each event
+// carries the frame it takes effect on (0 for the next opportunity) and is
+// applied in order at the start of that frame or at a $4016 strobe within
+// it, so a press reaches the first controller read after it arrives and a
+// frame-stamped script replays identically.
+class InputQueue {
+public:
+    InputQueue() : readIndex(0), writeIndex(0), currentFrame(0) {}
+
+    // Producer. Stamps must not decrease; false when the queue is full.
+    bool push(uint64_t frame, uint8_t button, bool pressed);
+
+    // Consumer.
+    void setFrame(uint64_t frame) { currentFrame = frame; }
+    void apply(Controller &controller);
+
+private:
+    ControllerEvent events[NES_INPUT_QUEUE_CAPACITY];
+    std::atomic<uint32_t> readIndex;
+    std::atomic<uint32_t> writeIndex;
+    uint64_t currentFrame;
+};
+
+#endif
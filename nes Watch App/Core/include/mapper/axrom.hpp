@@ -0,0 +1,16 @@
+#ifndef NESC_MAPPER_AXROM_H
+#define NESC_MAPPER_AXROM_H
+
+#include "mapper.hpp"
+
+class AxromMapper : public Mapper {
+public:
+    uint8_t bankSelect = 0;
+
+    void updateBanks(Cartridge &cart) override;
+    bool cpuWrite(Cartridge &cart, uint16_t addr, uint8_t data) override;
+    void saveState(StateWriter &state) const override;
+    void loadState(StateReader &state) override;
+};
+
+#endif
@@ -7,10 +7,10 @@ class CnromMapper : public Mapper {
 public:
     uint8_t chrBank = 0;
 
-    bool cpuRead(Cartridge &cart, uint16_t addr, uint8_t *out) override;
+    void updateBanks(Cartridge &cart) override;
     bool cpuWrite(Cartridge &cart, uint16_t addr, uint8_t data) override;
-    bool ppuRead(Cartridge &cart, uint16_t addr, uint8_t *out) override;
-    bool ppuWrite(Cartridge &cart, uint16_t addr, uint8_t data) override;
+    void saveState(StateWriter &state) const override;
+    void loadState(StateReader &state) override;
 };
 
 #endif
@@ -1,17 +1,29 @@
 #ifndef NESC_MAPPER_BASE_H
 #define NESC_MAPPER_BASE_H
 
+#include "save_state.hpp"
 #include "types.hpp"
 
 class Cartridge;
 
+// Mappers only decode register writes. Reads go straight through the
+// cartridge page tables, which updateBanks rebuilds whenever the bank
+// registers change. Mappers with registers save them in saveState; the
+// cartridge rebuilds the page tables after loadState.
 class Mapper {
 public:
     virtual ~Mapper() = default;
-    virtual bool cpuRead(Cartridge &cart, uint16_t addr, uint8_t *out) = 0;
+    virtual void updateBanks(Cartridge &cart) = 0;
     virtual bool cpuWrite(Cartridge &cart, uint16_t addr, uint8_t data) = 0;
-    virtual bool ppuRead(Cartridge &cart, uint16_t addr, uint8_t *out) = 0;
-    virtual bool ppuWrite(Cartridge &cart, uint16_t addr, uint8_t data) = 0;
+    virtual void saveState(StateWriter &state) const { (void)state; }
+    virtual void loadState(StateReader &state) { (void)state; }
+
+    // Scanline counters are clocked by the PPU once per rendered line and
+    // raise Cartridge::irqLine. scanlinesUntilIrq (-1 for never) lets the
+    // PPU schedule the IRQ line as an event instead of polling for it.
+    virtual bool hasScanlineCounter() const { return false; }
+    virtual void clockScanline(Cartridge &cart) { (void)cart; }
+    virtual int scanlinesUntilIrq() const { return -1; }
 };
 
 #endif
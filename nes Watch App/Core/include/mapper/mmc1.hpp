@@ -12,10 +12,10 @@ public:
     uint8_t chrBank1 = 0;
     uint8_t prgBank = 0;
 
-    bool cpuRead(Cartridge &cart, uint16_t addr, uint8_t *out) override;
+    void updateBanks(Cartridge &cart) override;
     bool cpuWrite(Cartridge &cart, uint16_t addr, uint8_t data) override;
-    bool ppuRead(Cartridge &cart, uint16_t addr, uint8_t *out) override;
-    bool ppuWrite(Cartridge &cart, uint16_t addr, uint8_t data) override;
+    void saveState(StateWriter &state) const override;
+    void loadState(StateReader &state) override;
 
 private:
     void applyControl(Cartridge &cart, uint8_t value);
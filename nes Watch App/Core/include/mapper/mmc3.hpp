@@ -0,0 +1,25 @@
+#ifndef NESC_MAPPER_MMC3_H
+#define NESC_MAPPER_MMC3_H
+
+#include "mapper.hpp"
+
+class Mmc3Mapper : public Mapper {
+public:
+    uint8_t bankSelect = 0;
+    uint8_t registers[8] = {0, 2, 4, 5, 6, 7, 0, 1};
+    uint8_t irqLatch = 0;
+    uint8_t irqCounter = 0;
+    bool irqReload = false;
+    bool irqEnabled = false;
+
+    void updateBanks(Cartridge &cart) override;
+    bool cpuWrite(Cartridge &cart, uint16_t addr, uint8_t data) override;
+    void saveState(StateWriter &state) const override;
+    void loadState(StateReader &state) override;
+
+    bool hasScanlineCounter() const override { return true; }
+    void clockScanline(Cartridge &cart) override;
+    int scanlinesUntilIrq() const override;
+};
+
+#endif
@@ -5,7 +5,10 @@
 #include "bus.hpp"
 #include "cartridge.hpp"
 #include "cpu.hpp"
+#include "frame_queue.hpp"
+#include "input_queue.hpp"
 #include "ppu.hpp"
+#include "rewind.hpp"
 
 class NES {
 public:
@@ -13,14 +16,67 @@ public:
     CPU cpu;
     PPU ppu;
     APU apu;
+    ApuSampleRing audioRing;
+    FrameQueue frames;
+    InputQueue input;
+    // Frames completed since the ROM was loaded; input stamps count these.
+    uint64_t frameCount;
     Cartridge cart;
     bool hasCart;
+    int maxFrameSkip;
+    double frameDebt;
+    RewindBuffer rewind;
+    size_t rewindBudget;
+    int rewindInterval;
+    int rewindCountdown;
+    // Run-ahead keeps one save state, sized for the loaded game, to return
+    // to after drawing the frames ahead.
+    int runAheadFrames;
+    uint8_t *runAheadState;
+    size_t runAheadStateSize;
+    bool hiddenFrame;
+    // Idle-loop skip: the loop the CPU last branched back into, and the
+    // registers and cycle count it arrived there with.
+    bool idleSkip;
+    IdleLoop idleLoop;
+    uint8_t idleRegisters[5];
+    uint32_t idleArrival;
+#if NESC_PROFILE
+    ProfileCounters counters;
+#endif
 
     NES();
     ~NES();
-    bool loadRom(const uint8_t *data, size_t size);
+    bool loadRom(const uint8_t *data, size_t size, CartRomStorage storage);
+    bool loadRomFile(const char *path);
+    bool loadRomImage(CartImage *image);
     void reset();
     void stepFrame();
+    void runFrames(int count, uint32_t flags);
+    uint32_t runCycles(uint32_t cycles);
+    int runElapsed(double seconds);
+    size_t stateSize();
+    size_t saveState(uint8_t *out, size_t capacity);
+    bool loadState(const uint8_t *data, size_t size);
+    bool configureRewind(size_t budget, int interval);
+    bool rewindStep();
+    bool configureRunAhead(int frames);
+    void setIdleSkip(bool enabled);
+    size_t batteryRamSize() const;
+    bool loadBatteryRam(const uint8_t *data, size_t size);
+    size_t takeBatteryRam(uint8_t *out, size_t capacity);
+
+private:
+    void attachCartridge();
+    void beginFrame();
+    int stepInstruction(uint32_t budget);
+    uint32_t skipIdleLoop(uint16_t branch, uint32_t budget);
+    void forgetIdleLoop();
+    void finishFrame();
+    void emulateFrame();
+    void runAhead();
+    void writeState(StateWriter &state);
+    void readState(StateReader &state);
 };
 
 #endif
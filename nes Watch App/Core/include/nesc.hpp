@@ -9,22 +9,259 @@ extern "C" {
 
 class NES;
 typedef NES *NESRef;
+class CartImage;
+typedef CartImage NesRomImage;
 
+typedef enum {
+    NES_ROM_BATTERY = 1 << 0,
+    NES_ROM_TRAINER = 1 << 1,
+    NES_ROM_FOUR_SCREEN = 1 << 2
+} NesRomFlags;
+
+// Header fields of an iNES image, all uint32_t so bindings can read it as
+// an array. chr_size is 0 for games that use CHR RAM.
+typedef struct {
+    uint32_t mapper;
+    uint32_t prg_size;
+    uint32_t chr_size;
+    uint32_t mirroring;
+    uint32_t flags;
+    uint32_t supported;
+} NesRomInfo;
+
+// Parses only the first 16 bytes, so a catalog can list and filter ROMs
+// without loading them. nes_rom_hash is the content hash save states are
+// keyed on (PRG and CHR ROM); it reads the whole image and returns 0 if
+// the image is truncated or not iNES.
+bool nes_rom_info(const uint8_t *header, size_t size, NesRomInfo *info);
+uint64_t nes_rom_hash(const uint8_t *data, size_t size);
+
+// Counters since nes_create, for sampling and differencing once in a while
+// on the thread that runs the frames. Only a core built with NESC_PROFILE=1
+// collects them; otherwise nes_get_stats zero-fills stats and returns false.
+// cpu_cycles counts every CPU cycle emulated, idle_cycles those the idle-loop
+// skip charged without running, so their ratio is the share skipped. Time is
+// wall time: ppu_ns covers PPU catch-up, apu_ns APU clocking, and
+// cpu_ns the rest of frame_ns. samples_starved is counted on the audio
+// thread as the render callback runs short, and frames_dropped each time
+// the host had both other frames pinned, so a finished frame was drawn over
+// instead of shown. All fields are uint64_t.
+typedef struct {
+    uint64_t frames;
+    uint64_t instructions;
+    uint64_t stall_cycles;
+    uint64_t dma_cycles;
+    uint64_t scanlines_rendered;
+    uint64_t prg_reads;
+    uint64_t mapper_writes;
+    uint64_t samples_dropped;
+    uint64_t samples_starved;
+    uint64_t frames_dropped;
+    uint64_t cpu_cycles;
+    uint64_t idle_cycles;
+    uint64_t frame_ns;
+    uint64_t cpu_ns;
+    uint64_t ppu_ns;
+    uint64_t apu_ns;
+} NesStats;
+
+bool nes_get_stats(NESRef nes, NesStats *stats);
+
+// Consoles share nothing mutable: each NESRef may run on its own thread
+// with no locking, as long as calls on one console come from the thread
+// that runs its frames, apart from those documented as safe elsewhere.
 NESRef nes_create(void);
 void nes_destroy(NESRef nes);
 
+// nes_load_rom copies the ROM out of data. nes_load_rom_borrowed uses it in
+// place, so data must stay valid and unchanged until the next load or
+// nes_destroy. nes_load_rom_file maps the file read-only and reads the ROM
+// straight from the mapping; only CHR RAM is allocated.
 bool nes_load_rom(NESRef nes, const uint8_t *data, size_t size);
+bool nes_load_rom_borrowed(NESRef nes, const uint8_t *data, size_t size);
+bool nes_load_rom_file(NESRef nes, const char *path);
+
+// A ROM image is one validated, read-only copy (or file mapping) of a ROM
+// that any number of consoles on any threads can load without copying it
+// again. Each console holds a reference while the ROM is loaded, so the
+// creator may release its own as soon as it has handed the image out.
+// Creating returns NULL for an image nes_load_rom would reject.
+NesRomImage *nes_rom_image_create(const uint8_t *data, size_t size);
+NesRomImage *nes_rom_image_open(const char *path);
+void nes_rom_image_release(NesRomImage *image);
+bool nes_load_rom_image(NESRef nes, NesRomImage *image);
+
 void nes_reset(NESRef nes);
 void nes_step_frame(NESRef nes);
 
+typedef enum {
+    NES_RUN_SKIP_RENDER = 1 << 0,
+    NES_RUN_SKIP_AUDIO = 1 << 1
+} NesRunFlags;
+
+// Runs several frames in one call. NES_RUN_SKIP_RENDER draws and publishes
+// only the last frame; NES_RUN_SKIP_AUDIO clocks the APU without queueing
+// samples. nes_run_cycles runs whole instructions until at least `cycles`
+// CPU cycles have passed and returns how many did.
+void nes_run_frames(NESRef nes, int count, uint32_t flags);
+uint32_t nes_run_cycles(NESRef nes, uint32_t cycles);
+
+#define NES_DEFAULT_FRAME_SKIP 4
+
+// Adaptive frame skip for hosts that call in on a display timer. Each call
+// passes the wall time since the previous one and runs the frames that time
+// is worth at the NTSC rate, rendering only the last; it returns the frame
+// count, which is 0 when the host is ahead. A throttled host therefore keeps
+// game speed and pays for fewer rendered frames. At most max_frame_skip
+// frames are skipped per call (NES_DEFAULT_FRAME_SKIP initially); time
+// beyond that is dropped. Skipped frames still raise sprite-0 hit, sprite
+// overflow, vblank and NMI exactly as drawn ones do.
+int nes_run_elapsed(NESRef nes, double seconds);
+void nes_set_max_frame_skip(NESRef nes, int frames);
+
+// Save states are a fixed-size binary snapshot of the machine (no
+// framebuffer or queued audio), tied to the loaded ROM and core version.
+// nes_save_state writes nes_save_state_size bytes and returns that count, or
+// 0 if capacity is too small. nes_load_state returns false, leaving the game
+// untouched, for a state from another ROM or version. Call both from the
+// thread that runs nes_step_frame.
+size_t nes_save_state_size(NESRef nes);
+size_t nes_save_state(NESRef nes, uint8_t *out, size_t capacity);
+bool nes_load_state(NESRef nes, const uint8_t *data, size_t size);
+
+// Rewind keeps a save state every interval_frames frames inside a fixed
+// budget_bytes allocation (0 disables it), dropping the oldest when full.
+// nes_rewind_step restores the newest snapshot and discards it, so repeated
+// calls walk back through history; at the oldest one it stays put. It does
+// not draw: step a frame afterwards to show the restored point.
+bool nes_rewind_configure(NESRef nes, size_t budget_bytes, int interval_frames);
+bool nes_rewind_step(NESRef nes);
+int nes_rewind_depth(NESRef nes);
+
+// Games that wait for vblank in a loop that only reads RAM or $2002 and
+// branches back (JMP to itself, BIT $2002 / BPL, and the like) have the
+// loop's remaining passes, up to the next interrupt or change in what it
+// reads, charged to the clock in one step instead of run. Nothing a game can
+// observe differs, frame and audio output included, so it is on by default;
+// turning it off is for comparing.
+void nes_set_idle_skip(NESRef nes, bool enabled);
+
+#define NES_MAX_RUN_AHEAD 2
+
+// Run-ahead hides input lag: every drawn frame runs undrawn as usual, then
+// the machine is saved, `frames` more frames run with the same buttons held
+// and no audio, the last of them is shown, and the save is restored. The
+// game, its audio, rewind history and frame count all follow the real frame;
+// only the picture is from the future. It costs frames + 1 frames of CPU per
+// drawn frame, or nothing for frames skipped by nes_run_frames and
+// nes_run_elapsed. 0 (the default) turns it off; at most NES_MAX_RUN_AHEAD.
+bool nes_set_run_ahead(NESRef nes, int frames);
+
+// Battery-backed PRG RAM ($6000-$7FFF) for games whose header sets the
+// battery flag; nes_battery_ram_size is 0 for the rest. Load the save file
+// after the ROM. nes_take_battery_ram copies the RAM out and returns its
+// size only when the game has written to it since the last take (loading a
+// save state counts as a write), otherwise 0; the host writes the copy to
+// disk on its own thread. Call both from the thread that runs the frames.
+size_t nes_battery_ram_size(NESRef nes);
+bool nes_load_battery_ram(NESRef nes, const uint8_t *data, size_t size);
+size_t nes_take_battery_ram(NESRef nes, uint8_t *out, size_t capacity);
+
+// nes_framebuffer returns the newest completed frame for use on the thread
+// that runs nes_step_frame. From any other thread, pin a frame with
+// nes_acquire_frame (NULL until the first frame completes) and hand it back
+// with nes_release_frame; a pinned frame is never rendered into, so it can be
+// wrapped without copying. Hold at most two frames at a time, and release
+// them all before nes_destroy. While the host holds two, finished frames may
+// be dropped; a host holding three may see the last one it pinned torn.
 const uint32_t *nes_framebuffer(NESRef nes);
+const uint32_t *nes_acquire_frame(NESRef nes);
+void nes_release_frame(NESRef nes, const uint32_t *pixels);
+// In indexed mode, frames from the calls above hold one palette index byte
+// per pixel instead of ARGB, and each frame buffer shrinks to match (61 KB
+// rather than 245 KB) as it is next drawn into. nes_expand_frame converts
+// either kind to ARGB with a 64- or 512-entry palette (NULL for the
+// built-in one). The mode takes effect from the next nes_step_frame.
+void nes_set_indexed_output(NESRef nes, bool enabled);
+void nes_expand_frame(const uint32_t *frame, uint32_t *out, const uint32_t *palette, int palette_entries);
 int nes_framebuffer_width(void);
 int nes_framebuffer_height(void);
 
+typedef enum {
+    NES_PIXEL_ARGB8888 = 0,
+    NES_PIXEL_RGB565 = 1
+} NesPixelFormat;
+
+// Scaled output fits the picture to the display as each line is drawn, so
+// the host has no full-frame resize to do. Frames then hold width x height
+// pixels in tightly packed rows, as ARGB words (BGRA bytes on little-endian
+// hosts) or RGB565 halfwords, and nes_expand_frame copies them unchanged.
+// Each frame buffer shrinks to that size as it is next drawn into, so no
+// full-resolution copy of the picture is kept.
+// Scaling is nearest-neighbour; crop_overscan first drops the 8 lines at the
+// top and bottom that TVs hid. width and height go up to 256 and 240, and
+// width 0 switches back to full-size ARGB. This and indexed output replace
+// each other. It takes effect from the next nes_step_frame; call it from the
+// thread that runs the frames. nes_frame_size reports what a frame from
+// nes_framebuffer or nes_acquire_frame was drawn at.
+bool nes_set_scaled_output(NESRef nes, int width, int height, NesPixelFormat format, bool crop_overscan);
+void nes_frame_size(const uint32_t *frame, int *width, int *height);
+
+// Button changes are queued rather than written to the controller, so one
+// host thread may call these while another runs frames. nes_set_button takes
+// effect at the next frame start or $4016 strobe, whichever comes first.
+// nes_queue_button holds the change until frame `frame` (as counted by
+// nes_frame_count, from 0 at ROM load), so a recorded script replays with
+// the same timing; stamps must not decrease, and it returns false when the
+// queue is full. nes_frame_count is for the thread that runs the frames.
 void nes_set_button(NESRef nes, uint8_t button, bool pressed);
+bool nes_queue_button(NESRef nes, uint8_t button, bool pressed, uint64_t frame);
+uint64_t nes_frame_count(NESRef nes);
+
+// The APU is clocked by nes_step_frame and queues samples at the rate set
+// here (0 disables output). nes_apu_read_samples is safe to call from the
+// audio render thread; it zero-fills what the queue cannot supply and returns
+// the number of samples actually read.
+void nes_apu_set_sample_rate(NESRef nes, double sample_rate);
+// Dynamic rate control: with a target latency set, the output rate is
+// adjusted by up to 0.5% each frame so the queue holds about that much audio
+// however the host and emulated clocks drift. 0 (the default) turns it off
+// and keeps output bit-exact. Safe to call from any thread.
+void nes_apu_set_target_latency(NESRef nes, double seconds);
+// Band-limited step synthesis is the default; disabling it falls back to the
+// point-sampled mixer. Call from the thread that runs nes_step_frame.
+void nes_apu_set_band_limited(NESRef nes, bool enabled);
+int nes_apu_read_samples(NESRef nes, float *out, int count);
+int nes_apu_available_samples(NESRef nes);
+
+// Headless regression runs. Each job plays a ROM image for `frames` frames
+// on a fresh console, applying the button script in inputs (stamped as for
+// nes_queue_button, sorted, at most 256 changes per frame), and stores the
+// nes_hash_frame of every hash_interval-th frame in hashes, which holds
+// frames / hash_interval entries; with hash_interval 0 it holds one, for the
+// last frame. Frames that are not hashed are not drawn, and no audio is
+// produced. Jobs are spread over `threads` workers (0 for one per core),
+// which steal from each other's queues once their own run dry. ok reports
+// whether the job's ROM loaded; the call returns how many jobs ran.
+// nes_hash_frame is FNV-1a over the pixels of a frame from the core.
+typedef struct {
+    uint64_t frame;
+    uint8_t button;
+    bool pressed;
+} NesInputEvent;
+
+typedef struct {
+    NesRomImage *rom;
+    const NesInputEvent *inputs;
+    size_t input_count;
+    uint32_t frames;
+    uint32_t hash_interval;
+    uint64_t *hashes;
+    bool ok;
+} NesBatchJob;
 
-float nes_apu_next_sample(NESRef nes, double sample_rate);
-void nes_apu_fill_buffer(NESRef nes, double sample_rate, float *out, int count);
+size_t nes_run_batch(NesBatchJob *jobs, size_t count, int threads);
+uint64_t nes_hash_frame(const uint32_t *frame);
 
 #ifdef __cplusplus
 }
@@ -2,52 +2,155 @@
 #define NESC_PPU_H
 
 #include "cartridge.hpp"
-#include <string.h>
+#include "profile.hpp"
+
+#define PPU_SPRITES_PER_LINE 8
+#define SPRITE_PIXEL_BEHIND 0x20
+#define PPU_PATTERN_TILES 512
+
+// Scroll a visible line was drawn with: the loopy v register as it stood at
+// dot 0, and fine X. split is set when the line does not follow from the one
+// above by the normal fine-Y increment, so runs between splits share one
+// scroll and can be drawn as a block of the nametable.
+typedef struct {
+    uint16_t v;
+    uint8_t fineX;
+    bool split;
+} ScrollSnapshot;
+
+#define PPU_OVERSCAN_LINES 8
+
+// Nearest-neighbour map from the 256 x 240 picture to a scaled output:
+// column holds the source x of each output column, and source line y fills
+// rowCount[y] output rows from firstRow[y] (none for lines dropped by the
+// scale or cropped as overscan).
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t column[NES_WIDTH];
+    uint8_t firstRow[NES_HEIGHT];
+    uint8_t rowCount[NES_HEIGHT];
+} OutputScale;
 
 class PPU {
 public:
-    FrameBuffer frameBuffer;
-    Cartridge *cartridge;
-    Mirroring mirroring;
-    uint8_t dataBus;
-    uint8_t ctrl;
-    uint8_t mask;
-    uint8_t status;
-    uint8_t oamAddr;
-    uint8_t oam[256];
-    uint8_t bgColorIndex[NES_WIDTH * NES_HEIGHT];
-    uint8_t scrollX;
-    uint8_t scrollY;
-    bool addressLatch;
-    uint16_t vramAddr;
-    uint8_t readBuffer;
-    int cycle;
-    int scanline;
-    bool frameComplete;
-    bool nmiRequested;
-    uint8_t nametableRam[2048];
-    uint8_t paletteRam[32];
-
-    PPU() {
-        memset(this, 0, sizeof(PPU));
-    }
+    FrameBuffer *frameBuffer = nullptr;
+    // Format requested for output. A frame takes it on at resetFrame and
+    // every line is drawn in the frame's own format, so a change made
+    // mid-frame waits for the next one.
+    FrameFormat outputFormat = FRAME_FORMAT_ARGB;
+    // Cleared for a frame whose buffer the host pinned before it could be
+    // resized to fit; such a frame is run but not drawn or published.
+    bool frameFits = false;
+    // The scale frames are drawn at; configureScale fills requestedScale,
+    // which likewise replaces it at the next resetFrame.
+    OutputScale outputScale = {};
+    OutputScale requestedScale = {};
+    bool scaleChanged = false;
+    bool skipRender = false;
+    Cartridge *cartridge = nullptr;
+    bool scanlineCounter = false;
+    Mirroring mirroring = MIRROR_HORIZONTAL;
+    uint8_t dataBus = 0;
+    uint8_t ctrl = 0;
+    uint8_t mask = 0;
+    uint8_t status = 0;
+    uint8_t oamAddr = 0;
+    uint8_t oam[256] = {};
+    uint8_t secondaryOam[PPU_SPRITES_PER_LINE * 4] = {};
+    int spriteCount = 0;
+    bool spriteZeroOnLine = false;
+    // Loopy registers: the current VRAM address v (yyy NN YYYYY XXXXX while
+    // rendering), its latch t, fine X scroll and the $2005/$2006 write toggle.
+    uint16_t v = 0;
+    uint16_t t = 0;
+    uint8_t fineX = 0;
+    bool w = false;
+    ScrollSnapshot lineScroll[NES_HEIGHT] = {};
+    uint8_t readBuffer = 0;
+    int cycle = 0;
+    int scanline = 0;
+    bool frameComplete = false;
+    bool nmiRequested = false;
+    uint64_t clock = 0;
+    uint64_t targetClock = 0;
+    uint64_t eventClock = 0;
+    uint8_t nametableRam[2048] = {};
+    uint8_t paletteRam[32] = {};
+    // Decoded rows of the tiles mapped at $0000-$1FFF, in the layout of
+    // ppu_decode_tile_row, filled a tile at a time on first use; tileValid
+    // holds a bit per tile. CHR RAM writes drop their tile and remapped
+    // slots drop theirs, through Cartridge::chrPagesChanged.
+    uint64_t tileRows[PPU_PATTERN_TILES * 8] = {};
+    uint8_t tileValid[PPU_PATTERN_TILES / 8] = {};
+    // Palette RAM resolved to colour indices, ARGB and RGB565, background
+    // entries below 16 and sprite entries above, rebuilt after a palette write.
+    uint8_t paletteIndices[32] = {};
+    uint32_t paletteColors[32] = {};
+    uint16_t paletteRgb565[32] = {};
+    bool paletteValid = false;
+#if NESC_PROFILE
+    ProfileCounters *profile = nullptr;
+#endif
 
     void connectCartridge(Cartridge *cart);
+    // Builds the tables for scaled output from the next frame; the caller
+    // sets outputFormat. At most 256 x 240, and cropping leaves the middle
+    // 224 lines to scale.
+    bool configureScale(int width, int height, bool cropOverscan);
+    // Storage the next frame needs, for sizing the back buffer before
+    // resetFrame.
+    size_t nextFrameBytes() const;
     void resetFrame();
     uint8_t cpuRead(uint16_t addr);
     void cpuWrite(uint16_t addr, uint8_t data);
-    void tick();
-    void dmaWriteOam(uint8_t data);
+    // Writes a 256-byte OAM DMA page starting at OAMADDR.
+    void dmaWriteOam(const uint8_t *block);
+
+    // The CPU schedules dots and the PPU runs them lazily: on register
+    // access, mapper writes, or once the next CPU-visible event (NMI, mapper
+    // IRQ, frame end) is due.
+    void addCycles(int dots) { targetClock += (uint64_t)dots; }
+    bool eventDue() const { return targetClock >= eventClock; }
+    void catchUp();
+    void scheduleNextEvent();
+    // Clock at which a $2002 flag may next be raised: a visible line
+    // starting (sprite 0 hit, overflow) or vblank starting. Counts from the
+    // dots already run, so catch up first.
+    uint64_t nextStatusClock() const;
+
+    // Saves everything but the framebuffer; call between instructions.
+    // After loading, call scheduleNextEvent once the mapper is restored.
+    void saveState(StateWriter &state) const;
+    void loadState(StateReader &state);
 
 private:
+    void tick();
+    bool renderingLine() const;
+    void incrementAddress();
     uint8_t readMemory(uint16_t addr);
     void writeMemory(uint16_t addr, uint8_t data);
     int mirrorNametable(uint16_t addr);
     int mirrorPalette(uint16_t addr);
-    uint32_t paletteColor(int palette, int color);
-    uint32_t spritePaletteColor(int palette, int color);
-    void renderBackgroundScanline(int y);
-    void renderSpritesScanline(int y);
+    uint8_t paletteIndex(int palette, int color);
+    uint8_t spritePaletteIndex(int palette, int color);
+    void resolvePalette();
+    void syncTileCache();
+    void decodeTile(int tile);
+    uint64_t tileRow(uint16_t tileAddr, int row);
+    void captureScroll(int y);
+    void renderScanline(int y);
+    void emitScaledLine(int y, const uint8_t *entries);
+    void renderBackgroundLine(int y, uint8_t *line);
+    void evaluateSprites(int y);
+    void renderSpriteLine(int y, uint8_t *line);
+    uint64_t spriteRowColors(int y, const uint8_t *entry);
+    uint8_t backgroundColor(int y, int x);
+    void testSpriteZeroHit(int y);
 };
 
+// Converts a frame to ARGB. Indexed frames are looked up in palette, either
+// 64 colours or 512 (8 emphasis variants of 64); NULL uses the built-in one.
+void ppu_expand_frame(const FrameBuffer *frame, uint32_t *out, const uint32_t *palette, int paletteEntries);
+
 #endif
@@ -0,0 +1,96 @@
+#ifndef NESC_PROFILE_H
+#define NESC_PROFILE_H
+
+#include "types.hpp"
+
+// Profiling counters exist only when the core is built with NESC_PROFILE=1.
+// Otherwise the counter members are left out of every class and each
+// NES_PROFILE_* macro expands to nothing, so a release build pays nothing.
+#ifndef NESC_PROFILE
+#define NESC_PROFILE 0
+#endif
+
+typedef struct {
+    uint64_t frames;
+    uint64_t instructions;
+    uint64_t stallCycles;
+    uint64_t dmaCycles;
+    uint64_t cpuCycles;
+    uint64_t idleCycles;
+    uint64_t scanlinesRendered;
+    uint64_t prgReads;
+    uint64_t mapperWrites;
+    uint64_t samplesDropped;
+    uint64_t frameNanos;
+    uint64_t ppuNanos;
+    uint64_t apuNanos;
+    uint32_t sampleTick;
+} ProfileCounters;
+
+// Scopes run once per instruction are timed one call in this many, scaled
+// up, since reading the clock every time would cost more than the work.
+#define NES_PROFILE_SAMPLE_PERIOD 64
+
+#if NESC_PROFILE
+
+#include <chrono>
+
+static inline uint64_t profile_clock() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Cost of one clock read, which every timed scope would otherwise include.
+static inline uint64_t profile_clock_overhead() {
+    static const uint64_t overhead = [] {
+        const int reads = 1000;
+        uint64_t start = profile_clock();
+        for (int i = 0; i < reads - 1; i++) {
+            (void)profile_clock();
+        }
+        return (profile_clock() - start) / reads;
+    }();
+    return overhead;
+}
+
+// Adds the lifetime of the scope, times scale, to a nanosecond counter.
+class ProfileScope {
+public:
+    ProfileScope(uint64_t *total, uint64_t scale) : total(total), scale(scale), start(total ? profile_clock() : 0) {}
+    ~ProfileScope() {
+        if (total) {
+            uint64_t elapsed = profile_clock() - start;
+            uint64_t overhead = profile_clock_overhead();
+            *total += (elapsed > overhead ? elapsed - overhead : 0) * scale;
+        }
+    }
+
+private:
+    uint64_t *total;
+    uint64_t scale;
+    uint64_t start;
+};
+
+#define NES_PROFILE_ADD(counters, field, n)         \
+    do {                                            \
+        if (counters) {                             \
+            (counters)->field += (uint64_t)(n);     \
+        }                                           \
+    } while (0)
+#define NES_PROFILE_SCOPE(counters, field) ProfileScope profile_scope((counters) ? &(counters)->field : nullptr, 1)
+#define NES_PROFILE_SAMPLED_SCOPE(counters, field)                                                   \
+    ProfileScope profile_scope(                                                                      \
+        (counters) && (counters)->sampleTick++ % NES_PROFILE_SAMPLE_PERIOD == 0 ? &(counters)->field \
+                                                                                 : nullptr,          \
+        NES_PROFILE_SAMPLE_PERIOD)
+
+#else
+
+#define NES_PROFILE_ADD(counters, field, n) ((void)0)
+#define NES_PROFILE_SCOPE(counters, field) ((void)0)
+#define NES_PROFILE_SAMPLED_SCOPE(counters, field) ((void)0)
+
+#endif
+
+#endif
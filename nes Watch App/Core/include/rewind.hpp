@@ -0,0 +1,54 @@
+#ifndef NESC_REWIND_H
+#define NESC_REWIND_H
+
+#include "types.hpp"
+
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+} RewindRecord;
+
+// Fixed-budget history of save states. Only the newest state is kept whole;
+// each older one is stored as the run-length coded XOR against its
+// successor, so stepping back one snapshot decodes exactly one delta. When
+// the budget runs out the oldest deltas are dropped, so push is O(1)
+// amortised and no allocation happens after configure.
+class RewindBuffer {
+public:
+    RewindBuffer();
+    ~RewindBuffer();
+
+    bool configure(size_t budget, size_t stateBytes);
+    void release();
+    void clear();
+    bool enabled() const { return memory != nullptr; }
+    size_t stateSize() const { return stateBytes; }
+    int depth() const { return snapshots; }
+
+    // Write a full state into stage(), then commit() it as the newest.
+    uint8_t *stage() { return staged; }
+    void commit();
+    // Removes the newest snapshot and returns it, valid until the next call.
+    // The oldest one is returned without being removed; NULL when empty.
+    const uint8_t *pop();
+
+private:
+    void makeRoom(size_t bytes);
+    void dropOldest();
+
+    uint8_t *memory;
+    uint8_t *latest;
+    uint8_t *staged;
+    uint8_t *arena;
+    RewindRecord *records;
+    size_t stateBytes;
+    size_t arenaBytes;
+    size_t maxEncoded;
+    int recordCapacity;
+    int oldestRecord;
+    int recordCount;
+    size_t head;
+    int snapshots;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef NESC_SAVE_STATE_H
+#define NESC_SAVE_STATE_H
+
+#include "types.hpp"
+#include <string.h>
+#include <type_traits>
+
+#define NES_STATE_MAGIC 0x5453454E
+#define NES_STATE_VERSION 4
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t mapperID;
+    uint64_t romHash;
+    uint32_t size;
+    uint32_t reserved;
+} StateHeader;
+
+// Cursor over a caller-owned save-state buffer. Fields are copied in a fixed
+// order with no padding between them; a writer without a buffer only counts
+// bytes, which is how the state size is found.
+class StateWriter {
+public:
+    StateWriter(uint8_t *buffer, size_t capacity) : data(buffer), capacity(capacity), used(0) {}
+
+    template <typename T>
+    void put(const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "state fields are copied raw");
+        bytes(&value, sizeof(T));
+    }
+
+    void bytes(const void *src, size_t count) {
+        if (data && used + count <= capacity) {
+            memcpy(data + used, src, count);
+        }
+        used += count;
+    }
+
+    size_t size() const { return used; }
+    bool overflowed() const { return used > capacity; }
+
+private:
+    uint8_t *data;
+    size_t capacity;
+    size_t used;
+};
+
+class StateReader {
+public:
+    StateReader(const uint8_t *buffer, size_t size) : data(buffer), limit(size), offset(0) {}
+
+    template <typename T>
+    void get(T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "state fields are copied raw");
+        bytes(&value, sizeof(T));
+    }
+
+    void bytes(void *dst, size_t count) {
+        if (offset + count <= limit) {
+            memcpy(dst, data + offset, count);
+        }
+        offset += count;
+    }
+
+    bool exhausted() const { return offset > limit; }
+
+private:
+    const uint8_t *data;
+    size_t limit;
+    size_t offset;
+};
+
+#endif
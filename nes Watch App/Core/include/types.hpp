@@ -10,11 +10,51 @@
 
 typedef enum {
     MIRROR_HORIZONTAL = 0,
-    MIRROR_VERTICAL = 1
+    MIRROR_VERTICAL = 1,
+    MIRROR_SINGLE_LOWER = 2,
+    MIRROR_SINGLE_UPPER = 3
 } Mirroring;
 
+typedef enum {
+    FRAME_FORMAT_ARGB = 0,
+    FRAME_FORMAT_INDEXED = 1,
+    FRAME_FORMAT_SCALED_ARGB = 2,
+    FRAME_FORMAT_SCALED_RGB565 = 3
+} FrameFormat;
+
+// Header of a frame, followed in the same allocation by capacity bytes of
+// pixel storage that pixels points at. ARGB frames fill pixels. Indexed
+// frames store one 6-bit palette index per pixel in indices, a quarter of
+// the storage, and record the PPUMASK emphasis bits of each line in
+// emphasis. Scaled frames pack width x height rows from the start of
+// pixels, or of rgb565 for 16-bit output; the others are 256 x 240.
 typedef struct {
-    uint32_t pixels[NES_WIDTH * NES_HEIGHT];
+    union {
+        uint32_t *pixels;
+        uint8_t *indices;
+        uint16_t *rgb565;
+    };
+    size_t capacity;
+    uint8_t emphasis[NES_HEIGHT];
+    FrameFormat format;
+    uint16_t width;
+    uint16_t height;
 } FrameBuffer;
 
+// Bytes of pixel storage a frame in this format needs.
+static inline size_t frame_bytes(FrameFormat format, int width, int height) {
+    switch (format) {
+        case FRAME_FORMAT_INDEXED: return (size_t)NES_WIDTH * NES_HEIGHT;
+        case FRAME_FORMAT_SCALED_ARGB: return (size_t)width * height * sizeof(uint32_t);
+        case FRAME_FORMAT_SCALED_RGB565: return (size_t)width * height * sizeof(uint16_t);
+        default: return (size_t)NES_WIDTH * NES_HEIGHT * sizeof(uint32_t);
+    }
+}
+
+// Frames are handed out by their pixel pointer, which sits right after the
+// header.
+static inline const FrameBuffer *frame_header(const uint32_t *pixels) {
+    return (const FrameBuffer *)((const uint8_t *)pixels - sizeof(FrameBuffer));
+}
+
 #endif
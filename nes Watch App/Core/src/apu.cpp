@@ -1,6 +1,5 @@
 #include "../include/apu.hpp"
 
-#include <math.h>
 #include <string.h>
 
 static const uint8_t apu_length_table[32] = {
@@ -27,8 +26,35 @@ static const uint8_t triangle_sequence[32] = {
     8, 9, 10, 11, 12, 13, 14, 15
 };
 
+static const uint8_t pulse_duty_table[4][8] = {
+    {0, 1, 0, 0, 0, 0, 0, 0},
+    {0, 1, 1, 0, 0, 0, 0, 0},
+    {0, 1, 1, 1, 1, 0, 0, 0},
+    {1, 0, 0, 1, 1, 1, 1, 1}
+};
+
 static const double apu_cpu_clock = 1789773.0;
 
+typedef struct {
+    float pulse[31];
+    float tnd[203];
+} ApuMixTable;
+
+// Standard lookup form of the nonlinear DAC: pulse indexed by p1 + p2 and
+// triangle/noise/DMC by 3t + 2n + d.
+static constexpr ApuMixTable apu_build_mix_table() {
+    ApuMixTable table = {};
+    for (int i = 1; i < 31; i++) {
+        table.pulse[i] = (float)(95.52 / (8128.0 / (double)i + 100.0));
+    }
+    for (int i = 1; i < 203; i++) {
+        table.tnd[i] = (float)(163.67 / (24329.0 / (double)i + 100.0));
+    }
+    return table;
+}
+
+static constexpr ApuMixTable apu_mix_table = apu_build_mix_table();
+
 void PulseChannel::writeControl(uint8_t data) {
     control = data;
     envStart = true;
@@ -51,6 +77,7 @@ void PulseChannel::writeTimerHigh(uint8_t data) {
     uint8_t lengthIndex = (data >> 3) & 0x1F;
     lengthCounter = apu_length_table[lengthIndex];
     envStart = true;
+    dutyPos = 0;
 }
 
 void PulseChannel::setEnabled(bool value) {
@@ -125,37 +152,24 @@ void PulseChannel::tickSweep() {
     }
 }
 
-double PulseChannel::sample(double sampleRate) {
-    if (!enabled || lengthCounter == 0) {
-        return 0.0;
-    }
-    if (timer < 8 || sweepMute) {
-        return 0.0;
-    }
-
-    uint8_t duty = (uint8_t)((control >> 6) & 0x03);
-    double dutyCycle = 0.75;
-    switch (duty) {
-        case 0: dutyCycle = 0.125; break;
-        case 1: dutyCycle = 0.25; break;
-        case 2: dutyCycle = 0.5; break;
-        default: dutyCycle = 0.75; break;
+void PulseChannel::tickTimer() {
+    if (timerCounter == 0) {
+        timerCounter = timer;
+        dutyPos = (uint8_t)((dutyPos + 1) & 0x07);
+    } else {
+        timerCounter -= 1;
     }
+}
 
-    double frequency = apu_cpu_clock / (16.0 * ((double)timer + 1.0));
-    if (!isfinite(frequency) || frequency <= 0.0) {
-        return 0.0;
+uint8_t PulseChannel::output() const {
+    if (!enabled || lengthCounter == 0 || timer < 8 || sweepMute) {
+        return 0;
     }
-
-    phase += frequency / sampleRate;
-    if (phase >= 1.0) {
-        phase -= floor(phase);
+    if (!pulse_duty_table[(control >> 6) & 0x03][dutyPos]) {
+        return 0;
     }
-
     bool constantVolume = (control & 0x10) != 0;
-    uint8_t env = constantVolume ? (control & 0x0F) : envDecay;
-    double volume = (double)env;
-    return (phase < dutyCycle) ? volume : 0.0;
+    return constantVolume ? (control & 0x0F) : envDecay;
 }
 
 void TriangleChannel::writeControl(uint8_t data) {
@@ -209,11 +223,11 @@ void TriangleChannel::tickTimer() {
     }
 }
 
-double TriangleChannel::sample() const {
+uint8_t TriangleChannel::output() const {
     if (!enabled || lengthCounter == 0 || linearCounter == 0) {
-        return 0.0;
+        return 0;
     }
-    return (double)triangle_sequence[sequencePos];
+    return triangle_sequence[sequencePos];
 }
 
 void NoiseChannel::writeControl(uint8_t data) {
@@ -284,16 +298,12 @@ void NoiseChannel::tickTimer() {
     }
 }
 
-double NoiseChannel::sample() const {
-    if (!enabled || lengthCounter == 0) {
-        return 0.0;
-    }
-    if (lfsr & 0x0001) {
-        return 0.0;
+uint8_t NoiseChannel::output() const {
+    if (!enabled || lengthCounter == 0 || (lfsr & 0x0001)) {
+        return 0;
     }
     bool constantVolume = (control & 0x10) != 0;
-    uint8_t env = constantVolume ? (control & 0x0F) : envDecay;
-    return (double)env;
+    return constantVolume ? (control & 0x0F) : envDecay;
 }
 
 void DmcChannel::restart() {
@@ -330,9 +340,10 @@ void DmcChannel::writeSampleLength(uint8_t data) {
     sampleLength = (uint16_t)((uint16_t)data * 16 + 1);
 }
 
-void DmcChannel::fetchSample(ApuReadFunc readFunc, void *context) {
+// Returns true when a byte was fetched, which halts the CPU for a few cycles.
+bool DmcChannel::fetchSample(ApuReadFunc readFunc, void *context) {
     if (!sampleBufferEmpty || bytesRemaining == 0) {
-        return;
+        return false;
     }
     if (readFunc) {
         sampleBuffer = readFunc(context, currentAddress);
@@ -350,6 +361,7 @@ void DmcChannel::fetchSample(ApuReadFunc readFunc, void *context) {
     if (bytesRemaining == 0 && loop) {
         restart();
     }
+    return true;
 }
 
 void DmcChannel::tickTimer() {
@@ -382,33 +394,98 @@ void DmcChannel::tickTimer() {
     }
 }
 
-double DmcChannel::sample() const {
-    return (double)outputLevel;
+uint8_t DmcChannel::output() const {
+    return outputLevel;
+}
+
+bool ApuSampleRing::push(float sample) {
+    uint32_t write = writeIndex.load(std::memory_order_relaxed);
+    uint32_t readPos = readIndex.load(std::memory_order_acquire);
+    if (write - readPos >= APU_RING_CAPACITY) {
+        return false;
+    }
+    samples[write & (APU_RING_CAPACITY - 1)] = sample;
+    writeIndex.store(write + 1, std::memory_order_release);
+    return true;
+}
+
+int ApuSampleRing::write(const float *in, int count) {
+    uint32_t write = writeIndex.load(std::memory_order_relaxed);
+    uint32_t readPos = readIndex.load(std::memory_order_acquire);
+    uint32_t space = APU_RING_CAPACITY - (write - readPos);
+    int toWrite = (uint32_t)count < space ? count : (int)space;
+    if (toWrite <= 0) {
+        return 0;
+    }
+    uint32_t start = write & (APU_RING_CAPACITY - 1);
+    int first = APU_RING_CAPACITY - start < (uint32_t)toWrite ? (int)(APU_RING_CAPACITY - start) : toWrite;
+    memcpy(&samples[start], in, (size_t)first * sizeof(float));
+    memcpy(samples, in + first, (size_t)(toWrite - first) * sizeof(float));
+    writeIndex.store(write + (uint32_t)toWrite, std::memory_order_release);
+    return toWrite;
+}
+
+int ApuSampleRing::read(float *out, int count) {
+    if (!out || count <= 0) {
+        return 0;
+    }
+    uint32_t readPos = readIndex.load(std::memory_order_relaxed);
+    uint32_t write = writeIndex.load(std::memory_order_acquire);
+    uint32_t ready = write - readPos;
+    uint32_t latency = targetLatency();
+    if (latency != 0) {
+        uint32_t target = (uint32_t)((uint64_t)latency * sampleRate() / 1000000);
+        if (!primed && ready < target) {
+            return 0;
+        }
+        primed = ready >= (uint32_t)count;
+    }
+    int toRead = (uint32_t)count < ready ? count : (int)ready;
+#if NESC_PROFILE
+    starved.fetch_add((uint64_t)(count - toRead), std::memory_order_relaxed);
+#endif
+    uint32_t start = readPos & (APU_RING_CAPACITY - 1);
+    int first = APU_RING_CAPACITY - start < (uint32_t)toRead ? (int)(APU_RING_CAPACITY - start) : toRead;
+    memcpy(out, &samples[start], (size_t)first * sizeof(float));
+    memcpy(out + first, samples, (size_t)(toRead - first) * sizeof(float));
+    readIndex.store(readPos + (uint32_t)toRead, std::memory_order_release);
+    return toRead;
+}
+
+int ApuSampleRing::available() const {
+    uint32_t write = writeIndex.load(std::memory_order_acquire);
+    uint32_t readPos = readIndex.load(std::memory_order_acquire);
+    return (int)(write - readPos);
+}
+
+void ApuSampleRing::clear() {
+    readIndex.store(writeIndex.load(std::memory_order_acquire), std::memory_order_release);
+    primed = false;
 }
 
 void APU::init() {
-    memset(this, 0, sizeof(*this));
-    pthread_mutex_init(&mutex, NULL);
+    *this = APU{};
     pulse1.sweepOnesComplement = true;
     noise.lfsr = 1;
     dmc.sampleBufferEmpty = true;
-    outputFilter = 0.0;
-    sampleCycleRemainder = 0.0;
 }
 
 void APU::reset() {
     ApuReadFunc readFunc = read;
     void *context = readContext;
-    pthread_mutex_destroy(&mutex);
-    memset(this, 0, sizeof(*this));
-    pthread_mutex_init(&mutex, NULL);
+    ApuSampleRing *ring = output;
+    ApuSynthesisMode mode = synthesis;
+#if NESC_PROFILE
+    ProfileCounters *counters = profile;
+#endif
+    init();
     read = readFunc;
     readContext = context;
-    pulse1.sweepOnesComplement = true;
-    noise.lfsr = 1;
-    dmc.sampleBufferEmpty = true;
-    outputFilter = 0.0;
-    sampleCycleRemainder = 0.0;
+    output = ring;
+    synthesis = mode;
+#if NESC_PROFILE
+    profile = counters;
+#endif
 }
 
 void APU::setReadCallback(ApuReadFunc readFunc, void *context) {
@@ -416,8 +493,19 @@ void APU::setReadCallback(ApuReadFunc readFunc, void *context) {
     readContext = context;
 }
 
+void APU::setOutput(ApuSampleRing *ring) {
+    output = ring;
+}
+
+void APU::setSynthesis(ApuSynthesisMode mode) {
+    if (mode == synthesis) {
+        return;
+    }
+    synthesis = mode;
+    activeSampleRate = 0;
+}
+
 void APU::cpuWrite(uint16_t addr, uint8_t data) {
-    pthread_mutex_lock(&mutex);
     switch (addr) {
         case 0x4000: pulse1.writeControl(data); break;
         case 0x4001: pulse1.writeSweep(data); break;
@@ -464,11 +552,9 @@ void APU::cpuWrite(uint16_t addr, uint8_t data) {
         default:
             break;
     }
-    pthread_mutex_unlock(&mutex);
 }
 
 uint8_t APU::readStatus() {
-    pthread_mutex_lock(&mutex);
     uint8_t value = 0;
     if (pulse1.enabled && pulse1.lengthCounter > 0) {
         value |= 0x01;
@@ -485,7 +571,6 @@ uint8_t APU::readStatus() {
     if (dmc.bytesRemaining > 0) {
         value |= 0x10;
     }
-    pthread_mutex_unlock(&mutex);
     return value;
 }
 
@@ -505,98 +590,240 @@ void APU::halfFrame() {
     pulse2.tickSweep();
 }
 
-void APU::stepCyclesUnlocked(int cycles) {
-    for (int i = 0; i < cycles; i++) {
-        frameCounterCycle += 1;
-        if (!frameCounterMode) {
-            if (frameCounterCycle == 3729) {
-                quarterFrame();
-            } else if (frameCounterCycle == 7457) {
-                quarterFrame();
-                halfFrame();
-            } else if (frameCounterCycle == 11186) {
-                quarterFrame();
-            } else if (frameCounterCycle == 14915) {
-                quarterFrame();
-                halfFrame();
-                frameCounterCycle = 0;
-            }
-        } else {
-            if (frameCounterCycle == 3729) {
-                quarterFrame();
-            } else if (frameCounterCycle == 7457) {
-                quarterFrame();
-                halfFrame();
-            } else if (frameCounterCycle == 11186) {
-                quarterFrame();
-            } else if (frameCounterCycle == 14915) {
-                quarterFrame();
-                halfFrame();
-            } else if (frameCounterCycle == 18641) {
-                frameCounterCycle = 0;
-            }
+void APU::clockFrameCounter() {
+    frameCounterCycle += 1;
+    if (!frameCounterMode) {
+        if (frameCounterCycle == 3729) {
+            quarterFrame();
+        } else if (frameCounterCycle == 7457) {
+            quarterFrame();
+            halfFrame();
+        } else if (frameCounterCycle == 11186) {
+            quarterFrame();
+        } else if (frameCounterCycle == 14915) {
+            quarterFrame();
+            halfFrame();
+            frameCounterCycle = 0;
+        }
+    } else {
+        if (frameCounterCycle == 3729) {
+            quarterFrame();
+        } else if (frameCounterCycle == 7457) {
+            quarterFrame();
+            halfFrame();
+        } else if (frameCounterCycle == 11186) {
+            quarterFrame();
+        } else if (frameCounterCycle == 14915) {
+            quarterFrame();
+            halfFrame();
+        } else if (frameCounterCycle == 18641) {
+            frameCounterCycle = 0;
         }
+    }
+}
 
-        triangle.tickTimer();
-        noise.tickTimer();
-        dmc.tickTimer();
-        dmc.fetchSample(read, readContext);
+void APU::clockChannels() {
+    clockFrameCounter();
+    oddCycle = !oddCycle;
+    if (oddCycle) {
+        pulse1.tickTimer();
+        pulse2.tickTimer();
+    }
+    triangle.tickTimer();
+    noise.tickTimer();
+    dmc.tickTimer();
+    if (dmc.fetchSample(read, readContext)) {
+        dmcStallCycles += APU_DMC_STALL_CYCLES;
     }
 }
 
-void APU::step(int cycles) {
-    pthread_mutex_lock(&mutex);
-    stepCyclesUnlocked(cycles);
-    pthread_mutex_unlock(&mutex);
+void APU::updateSampleRate(uint32_t rate) {
+    activeSampleRate = rate;
+    samplePhase = 0;
+    sampleStep = 0;
+    blipClock = 0;
+    blipLevel = 0.0f;
+    blipLevels = 0xFFFFFFFF;
+    rateScale = 1.0f;
+    fillAverage = 0.0f;
+    if (rate == 0) {
+        return;
+    }
+    if (synthesis == APU_SYNTH_BAND_LIMITED) {
+        blip.setRates(apu_cpu_clock, (double)rate);
+    } else {
+        sampleStep = (uint32_t)(apu_cpu_clock * 65536.0 / (double)rate);
+        double rc = 1.0 / (2.0 * 3.141592653589793 * 12000.0);
+        double dt = 1.0 / (double)rate;
+        filterAlpha = (float)(dt / (rc + dt));
+    }
 }
 
-float APU::nextSampleUnlocked(double sample_rate) {
-    double p1 = pulse1.sample(sample_rate);
-    double p2 = pulse2.sample(sample_rate);
-    double t = triangle.sample();
-    double n = noise.sample();
-    double d = dmc.sample();
+// The buffer empties on the timer expiry after the last bit is shifted
+// out; expiries come timerCounter + 1 cycles from now and every timer + 1
+// after that, and the fetch follows on the same cycle.
+uint32_t APU::quietCycles() const {
+    if (dmc.bytesRemaining == 0) {
+        return UINT32_MAX;
+    }
+    if (dmc.sampleBufferEmpty) {
+        return 0;
+    }
+    return (uint32_t)dmc.timerCounter + (uint32_t)dmc.bitCount * ((uint32_t)dmc.timer + 1);
+}
+
+void APU::step(int cycles) {
+    NES_PROFILE_SAMPLED_SCOPE(profile, apuNanos);
+    uint32_t rate = output ? output->sampleRate() : 0;
+    if (rate != activeSampleRate) {
+        updateSampleRate(rate);
+    }
+    if (rate == 0 || muted) {
+        for (int i = 0; i < cycles; i++) {
+            clockChannels();
+        }
+    } else if (synthesis == APU_SYNTH_BAND_LIMITED) {
+        stepBandLimited(cycles);
+    } else {
+        stepPointSampled(cycles);
+    }
+}
 
-    double pulseOut = 0.0;
-    if (p1 + p2 > 0.0) {
-        pulseOut = 95.88 / ((8128.0 / (p1 + p2)) + 100.0);
+// Channel levels only change on timer, frame-counter and register events, so
+// the mixer runs at those cycles and the blip buffer receives the difference.
+void APU::stepBandLimited(int cycles) {
+    for (int i = 0; i < cycles; i++) {
+        clockChannels();
+        uint32_t levels = channelLevels();
+        if (levels != blipLevels) {
+            blipLevels = levels;
+            float level = mixLevels(levels);
+            blip.addDelta(blipClock, level - blipLevel);
+            blipLevel = level;
+        }
+        blipClock += 1;
     }
-    double tndOut = 0.0;
-    double tnd = (t / 8227.0) + (n / 12241.0) + (d / 22638.0);
-    if (tnd > 0.0) {
-        tndOut = 159.79 / ((1.0 / tnd) + 100.0);
+    if (blipClock >= APU_BLIP_FLUSH_CLOCKS) {
+        endFrame();
     }
-    double mixed = pulseOut + tndOut;
-    double cutoff = 12000.0;
-    double rc = 1.0 / (2.0 * 3.141592653589793 * cutoff);
-    double dt = 1.0 / sample_rate;
-    double alpha = dt / (rc + dt);
-    outputFilter += alpha * (mixed - outputFilter);
-    return (float)outputFilter;
 }
 
-float APU::nextSample(double sample_rate) {
-    float sampleValue = 0.0f;
-    pthread_mutex_lock(&mutex);
-    sampleValue = nextSampleUnlocked(sample_rate);
-    pthread_mutex_unlock(&mutex);
-    return sampleValue;
+void APU::stepPointSampled(int cycles) {
+    while (cycles > 0) {
+        // samplePhase counts CPU cycles toward the next output sample in
+        // 16.16 fixed point; run the channels up to that point in one go.
+        int run = (int)((sampleStep - samplePhase + 65535) >> 16);
+        if (cycles < run) {
+            run = cycles;
+        }
+        for (int i = 0; i < run; i++) {
+            clockChannels();
+        }
+        cycles -= run;
+        samplePhase += (uint32_t)run << 16;
+        if (samplePhase >= sampleStep) {
+            samplePhase -= sampleStep;
+            if (!output->push(nextSample())) {
+                NES_PROFILE_ADD(profile, samplesDropped, 1);
+            }
+        }
+    }
 }
 
-void APU::fillBuffer(double sample_rate, float *out, int count) {
-    if (!out || count <= 0) {
+void APU::endFrame() {
+    NES_PROFILE_SCOPE(profile, apuNanos);
+    if (activeSampleRate == 0 || !output) {
         return;
     }
-    double cyclesPerSample = apu_cpu_clock / sample_rate;
-    pthread_mutex_lock(&mutex);
-    for (int i = 0; i < count; i++) {
-        sampleCycleRemainder += cyclesPerSample;
-        int cycles = (int)sampleCycleRemainder;
-        if (cycles > 0) {
-            stepCyclesUnlocked(cycles);
-            sampleCycleRemainder -= (double)cycles;
+    int fill = output->available();
+    if (synthesis == APU_SYNTH_BAND_LIMITED) {
+        blip.endFrame(blipClock);
+        blipClock = 0;
+        float samples[512];
+        int count;
+        while ((count = blip.readSamples(samples, 512)) > 0) {
+            int written = output->write(samples, count);
+            if (written < count) {
+                NES_PROFILE_ADD(profile, samplesDropped, count - written);
+            }
         }
-        out[i] = nextSampleUnlocked(sample_rate);
     }
-    pthread_mutex_unlock(&mutex);
+    controlRate(fill);
+}
+
+// Dynamic rate control. The host drains the ring on its own audio clock,
+// which never quite matches the emulated one, so instead of a deep ring to
+// absorb the drift the output rate is nudged, by at most
+// APU_RATE_CONTROL_MAX, in proportion to how far the smoothed fill is from
+// the target. The fill is taken before the frame's samples are queued, so the
+// target is the margin left when new audio arrives. A fill below target
+// produces slightly more samples per frame.
+void APU::controlRate(int fill) {
+    uint32_t latency = output->targetLatency();
+    if (latency == 0 || muted) {
+        return;
+    }
+    float target = (float)((double)latency * activeSampleRate / 1000000.0);
+    fillAverage += ((float)fill - fillAverage) * APU_RATE_CONTROL_SMOOTHING;
+    float deviation = (target - fillAverage) / target;
+    if (deviation > 1.0f) {
+        deviation = 1.0f;
+    } else if (deviation < -1.0f) {
+        deviation = -1.0f;
+    }
+    rateScale = 1.0f + APU_RATE_CONTROL_MAX * deviation;
+    if (synthesis == APU_SYNTH_BAND_LIMITED) {
+        blip.setRateScale(rateScale);
+    } else {
+        sampleStep = (uint32_t)(apu_cpu_clock * 65536.0 / ((double)activeSampleRate * rateScale));
+        if (samplePhase > sampleStep) {
+            samplePhase = sampleStep;
+        }
+    }
+}
+
+uint32_t APU::channelLevels() const {
+    return (uint32_t)pulse1.output() |
+           ((uint32_t)pulse2.output() << 4) |
+           ((uint32_t)triangle.output() << 8) |
+           ((uint32_t)noise.output() << 12) |
+           ((uint32_t)dmc.output() << 16);
+}
+
+float APU::mixLevels(uint32_t levels) const {
+    uint32_t pulse = (levels & 0x0F) + ((levels >> 4) & 0x0F);
+    uint32_t tnd = 3 * ((levels >> 8) & 0x0F) + 2 * ((levels >> 12) & 0x0F) + (levels >> 16);
+    return apu_mix_table.pulse[pulse] + apu_mix_table.tnd[tnd];
+}
+
+float APU::nextSample() {
+    float mixed = mixLevels(channelLevels());
+    outputFilter += filterAlpha * (mixed - outputFilter);
+    return outputFilter;
+}
+
+void APU::saveState(StateWriter &state) const {
+    state.put(pulse1);
+    state.put(pulse2);
+    state.put(triangle);
+    state.put(noise);
+    state.put(dmc);
+    state.put(frameCounterCycle);
+    state.put(frameCounterMode);
+    state.put(frameIrqInhibit);
+    state.put(oddCycle);
+}
+
+void APU::loadState(StateReader &state) {
+    state.get(pulse1);
+    state.get(pulse2);
+    state.get(triangle);
+    state.get(noise);
+    state.get(dmc);
+    state.get(frameCounterCycle);
+    state.get(frameCounterMode);
+    state.get(frameIrqInhibit);
+    state.get(oddCycle);
+    // Forces a step from the current output level to the restored one.
+    blipLevels = 0xFFFFFFFF;
 }
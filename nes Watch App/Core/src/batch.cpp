@@ -0,0 +1,127 @@
+#include "../include/nesc.hpp"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../include/nes_internal.hpp"
+
+// Jobs are whole ROM runs, so a lock per queue costs nothing next to the
+// work. Owners take from the back of their queue and thieves from the front,
+// which keeps a worker on neighbouring jobs until it has to steal.
+struct BatchQueue {
+    std::mutex lock;
+    std::deque<size_t> jobs;
+};
+
+static bool batch_take(BatchQueue &queue, bool fromBack, size_t *job) {
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if (queue.jobs.empty()) {
+        return false;
+    }
+    if (fromBack) {
+        *job = queue.jobs.back();
+        queue.jobs.pop_back();
+    } else {
+        *job = queue.jobs.front();
+        queue.jobs.pop_front();
+    }
+    return true;
+}
+
+static bool batch_next_job(BatchQueue *queues, int workers, int self, size_t *job) {
+    if (batch_take(queues[self], true, job)) {
+        return true;
+    }
+    for (int offset = 1; offset < workers; offset++) {
+        if (batch_take(queues[(self + offset) % workers], false, job)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool batch_run_job(NesBatchJob *job) {
+    std::unique_ptr<NES> nes(new NES());
+    if (!nes->loadRomImage(job->rom)) {
+        return false;
+    }
+    size_t nextInput = 0;
+    uint32_t hashCount = 0;
+    for (uint32_t frame = 0; frame < job->frames; frame++) {
+        while (nextInput < job->input_count && job->inputs[nextInput].frame <= frame) {
+            const NesInputEvent &event = job->inputs[nextInput];
+            if (!nes->input.push(event.frame, event.button, event.pressed)) {
+                break;
+            }
+            nextInput += 1;
+        }
+        bool hashed = job->hash_interval > 0 ? (frame + 1) % job->hash_interval == 0 : frame + 1 == job->frames;
+        nes->ppu.skipRender = !hashed;
+        nes->stepFrame();
+        if (hashed && job->hashes) {
+            job->hashes[hashCount++] = nes_hash_frame(nes->frames.latest()->pixels);
+        }
+    }
+    return true;
+}
+
+static void batch_worker(NesBatchJob *jobs, BatchQueue *queues, int workers, int self) {
+    size_t job;
+    while (batch_next_job(queues, workers, self, &job)) {
+        jobs[job].ok = batch_run_job(&jobs[job]);
+    }
+}
+
+size_t nes_run_batch(NesBatchJob *jobs, size_t count, int threads) {
+    if (!jobs || count == 0) {
+        return 0;
+    }
+    int workers = threads > 0 ? threads : (int)std::thread::hardware_concurrency();
+    if (workers < 1) {
+        workers = 1;
+    }
+    if ((size_t)workers > count) {
+        workers = (int)count;
+    }
+
+    // Contiguous blocks per worker, so stealing from the front takes the
+    // jobs the owner would reach last.
+    std::vector<BatchQueue> queues((size_t)workers);
+    for (size_t i = 0; i < count; i++) {
+        jobs[i].ok = false;
+        queues[i * (size_t)workers / count].jobs.push_back(i);
+    }
+
+    std::vector<std::thread> pool;
+    for (int worker = 1; worker < workers; worker++) {
+        pool.emplace_back(batch_worker, jobs, queues.data(), workers, worker);
+    }
+    batch_worker(jobs, queues.data(), workers, 0);
+    for (std::thread &thread : pool) {
+        thread.join();
+    }
+
+    size_t ran = 0;
+    for (size_t i = 0; i < count; i++) {
+        ran += jobs[i].ok ? 1 : 0;
+    }
+    return ran;
+}
+
+uint64_t nes_hash_frame(const uint32_t *frame) {
+    if (!frame) {
+        return 0;
+    }
+    uint64_t hash = 1469598103934665603ULL;
+    const FrameBuffer *header = frame_header(frame);
+    const uint8_t *bytes = (const uint8_t *)frame;
+    size_t size = frame_bytes(header->format, header->width, header->height);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
@@ -0,0 +1,95 @@
+#include "../include/blip_buffer.hpp"
+
+#include <math.h>
+#include <string.h>
+
+typedef struct {
+    float taps[BLIP_PHASES][BLIP_TAPS];
+} BlipKernel;
+
+// Blackman-windowed sinc impulses, one per sub-sample phase, cut off just
+// below Nyquist and normalised so each step lands at exactly its amplitude.
+static BlipKernel blip_build_kernel() {
+    BlipKernel kernel;
+    const double pi = 3.141592653589793;
+    const double cutoff = 0.9;
+    const double half = BLIP_TAPS / 2.0;
+    for (int phase = 0; phase < BLIP_PHASES; phase++) {
+        double frac = (double)phase / BLIP_PHASES;
+        double sum = 0.0;
+        double taps[BLIP_TAPS];
+        for (int k = 0; k < BLIP_TAPS; k++) {
+            double x = (double)k - (half - 1.0) - frac;
+            double sinc = x == 0.0 ? 1.0 : sin(pi * x * cutoff) / (pi * x * cutoff);
+            double w = (x + half) / BLIP_TAPS;
+            double window = 0.42 - 0.5 * cos(2.0 * pi * w) + 0.08 * cos(4.0 * pi * w);
+            taps[k] = sinc * window;
+            sum += taps[k];
+        }
+        for (int k = 0; k < BLIP_TAPS; k++) {
+            kernel.taps[phase][k] = (float)(taps[k] / sum);
+        }
+    }
+    return kernel;
+}
+
+static const BlipKernel &blip_kernel() {
+    static const BlipKernel kernel = blip_build_kernel();
+    return kernel;
+}
+
+void BlipBuffer::setRates(double clockRate, double sampleRate) {
+    baseFactor = (uint64_t)(sampleRate / clockRate * 4294967296.0);
+    factor = baseFactor;
+    // DC blocker comparable to the NES output stage's 90 Hz high-pass.
+    leak = (float)exp(-2.0 * 3.141592653589793 * 90.0 / sampleRate);
+    (void)blip_kernel();
+    clear();
+}
+
+void BlipBuffer::clear() {
+    offset = 0;
+    avail = 0;
+    integrator = 0.0f;
+    memset(buffer, 0, sizeof(buffer));
+}
+
+void BlipBuffer::addDelta(uint32_t clockTime, float delta) {
+    uint64_t position = offset + (uint64_t)clockTime * factor;
+    uint64_t index = position >> 32;
+    if (index + BLIP_TAPS > BLIP_MAX_SAMPLES + BLIP_TAPS) {
+        return;
+    }
+    int phase = (int)((position >> (32 - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1));
+    const float *taps = blip_kernel().taps[phase];
+    float *out = &buffer[index];
+    for (int k = 0; k < BLIP_TAPS; k++) {
+        out[k] += delta * taps[k];
+    }
+}
+
+void BlipBuffer::endFrame(uint32_t clockDuration) {
+    offset += (uint64_t)clockDuration * factor;
+    uint64_t ready = offset >> 32;
+    avail = ready > BLIP_MAX_SAMPLES ? BLIP_MAX_SAMPLES : (int)ready;
+}
+
+int BlipBuffer::readSamples(float *out, int count) {
+    int n = count < avail ? count : avail;
+    if (n <= 0) {
+        return 0;
+    }
+    float sum = integrator;
+    for (int i = 0; i < n; i++) {
+        sum = sum * leak + buffer[i];
+        out[i] = sum;
+    }
+    integrator = sum;
+
+    int remaining = avail - n + BLIP_TAPS;
+    memmove(buffer, buffer + n, (size_t)remaining * sizeof(float));
+    memset(buffer + remaining, 0, (size_t)n * sizeof(float));
+    avail -= n;
+    offset -= (uint64_t)n << 32;
+    return n;
+}
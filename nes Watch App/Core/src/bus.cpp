@@ -1,12 +1,18 @@
 #include "../include/bus.hpp"
+#include "../include/input_queue.hpp"
+
+#include <string.h>
 
 uint8_t Bus::cpuReadInternal(uint16_t addr) {
-    if (cartridge) {
-        uint8_t cartData = 0;
-        if (cartridge->cpuRead(addr, &cartData)) {
-            dataBus = cartData;
-            return cartData;
+    if (addr >= 0x8000) {
+        const uint8_t *page = cartridge ? cartridge->prgPage(addr) : nullptr;
+        if (page) {
+            NES_PROFILE_ADD(profile, prgReads, 1);
+            uint8_t value = page[addr & (CART_PRG_PAGE_SIZE - 1)];
+            dataBus = value;
+            return value;
         }
+        return dataBus;
     }
 
     if (addr <= 0x1FFF) {
@@ -52,52 +58,71 @@ uint8_t Bus::cpuReadOpcode(uint16_t addr) {
     return cpuReadInternal(addr);
 }
 
-void Bus::startDma(uint8_t page) {
-    dmaActive = true;
-    dmaPage = page;
-    dmaIndex = 0;
-    dmaCycle = 0;
+bool Bus::peek(uint16_t addr, uint8_t *value) const {
+    if (addr <= 0x1FFF) {
+        *value = cpuRam[addr & 0x07FF];
+        return true;
+    }
+    if (addr >= 0x6000 && addr <= 0x7FFF) {
+        *value = prgRam[addr & 0x1FFF];
+        return true;
+    }
+    if (addr >= 0x8000) {
+        const uint8_t *page = cartridge ? cartridge->prgPage(addr) : nullptr;
+        if (page) {
+            *value = page[addr & (CART_PRG_PAGE_SIZE - 1)];
+            return true;
+        }
+    }
+    return false;
 }
 
-void Bus::stepDma() {
-    if (!dmaActive) {
-        return;
-    }
-    if (dmaCycle % 2 == 0) {
-        uint16_t addr = (uint16_t)(dmaPage << 8) | dmaIndex;
-        dmaData = cpuRead(addr);
+// OAM DMA copies the whole page at once. The CPU pays the 513 or 514 cycles
+// afterwards as one stall, and since nothing else reaches the bus while it
+// is halted, games see the same timing as a byte-per-two-cycles transfer.
+void Bus::startDma(uint8_t page) {
+    uint8_t block[256];
+    uint16_t base = (uint16_t)(page << 8);
+    if (base <= 0x1FFF) {
+        memcpy(block, &cpuRam[base & 0x0700], sizeof(block));
+        dataBus = block[255];
     } else {
-        if (ppu) {
-            ppu->dmaWriteOam(dmaData);
-        }
-        dmaIndex += 1;
-        if (dmaIndex == 256) {
-            dmaActive = false;
+        for (int i = 0; i < 256; i++) {
+            block[i] = cpuRead((uint16_t)(base | i));
         }
     }
-    dmaCycle += 1;
+    if (ppu) {
+        ppu->dmaWriteOam(block);
+    }
 }
 
 void Bus::requestStall(int cycles) {
-    if (cycles > stallCycles) {
-        stallCycles = cycles;
-    }
+    stallCycles += cycles;
 }
 
-bool Bus::consumeStall() {
-    if (stallCycles > 0) {
-        stallCycles -= 1;
-        stepDma();
-        return true;
-    }
-    return false;
+int Bus::takeStall() {
+    int cycles = stallCycles;
+    stallCycles = 0;
+    NES_PROFILE_ADD(profile, stallCycles, cycles);
+    return cycles;
 }
 
 void Bus::cpuWrite(uint16_t addr, uint8_t data) {
     dataBus = data;
 
-    if (cartridge && cartridge->cpuWrite(addr, data)) {
-        return;
+    if (addr >= 0x4020 && cartridge) {
+        if (addr >= 0x8000 && ppu) {
+            // Bank and mirroring changes affect lines the PPU still owes.
+            ppu->catchUp();
+        }
+        if (cartridge->cpuWrite(addr, data)) {
+            NES_PROFILE_ADD(profile, mapperWrites, 1);
+            if (addr >= 0x8000 && ppu) {
+                // IRQ counter writes move the next mapper IRQ.
+                ppu->scheduleNextEvent();
+            }
+            return;
+        }
     }
 
     if (addr <= 0x1FFF) {
@@ -105,7 +130,11 @@ void Bus::cpuWrite(uint16_t addr, uint8_t data) {
         return;
     }
     if (addr >= 0x6000 && addr <= 0x7FFF) {
-        prgRam[addr & 0x1FFF] = data;
+        uint8_t &cell = prgRam[addr & 0x1FFF];
+        if (cell != data) {
+            cell = data;
+            prgRamDirty = true;
+        }
         return;
     }
     if (addr <= 0x3FFF) {
@@ -119,6 +148,10 @@ void Bus::cpuWrite(uint16_t addr, uint8_t data) {
         return;
     }
     if (addr == 0x4016) {
+        if (input && (data & 0x01) != 0) {
+            // The strobe latches the buttons; take any changes due by now.
+            input->apply(controller);
+        }
         controller.write(data);
         return;
     }
@@ -135,7 +168,7 @@ void Bus::cpuWrite(uint16_t addr, uint8_t data) {
 }
 
 bool Bus::isIrqPending() {
-    return irqPending;
+    return irqPending || (cartridge && cartridge->irqLine);
 }
 
 void Bus::ackIrq() {
@@ -149,3 +182,26 @@ void Bus::tick(int cycles) {
 void Bus::setCpuBus(uint8_t value) {
     dataBus = value;
 }
+
+void Bus::saveState(StateWriter &state) const {
+    state.put(cpuRam);
+    state.put(prgRam);
+    state.put(dataBus);
+    state.put(irqPending);
+    state.put(stallCycles);
+    state.put(controller.state);
+    state.put(controller.shift);
+    state.put(controller.strobe);
+}
+
+void Bus::loadState(StateReader &state) {
+    state.get(cpuRam);
+    state.get(prgRam);
+    prgRamDirty = true;
+    state.get(dataBus);
+    state.get(irqPending);
+    state.get(stallCycles);
+    state.get(controller.state);
+    state.get(controller.shift);
+    state.get(controller.strobe);
+}
@@ -0,0 +1,72 @@
+#include "../include/cart_image.hpp"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/cartridge.hpp"
+
+static bool cart_image_valid(const uint8_t *data, size_t size) {
+    CartHeader header;
+    return cart_parse_header(data, size, &header) && cart_mapper_supported(header.mapperID) &&
+           size >= header.prgOffset + header.prgSize + header.chrSize;
+}
+
+CartImage::CartImage(const uint8_t *bytes, size_t length, bool mapped)
+    : bytes(bytes), length(length), mapped(mapped), references(1) {}
+
+CartImage::~CartImage() {
+    if (mapped) {
+        munmap((void *)bytes, length);
+    } else {
+        ::free((void *)bytes);
+    }
+}
+
+CartImage *CartImage::copy(const uint8_t *data, size_t size) {
+    if (!data || !cart_image_valid(data, size)) {
+        return nullptr;
+    }
+    uint8_t *bytes = (uint8_t *)malloc(size);
+    if (!bytes) {
+        return nullptr;
+    }
+    memcpy(bytes, data, size);
+    return new CartImage(bytes, size, false);
+}
+
+CartImage *CartImage::map(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    size_t size = (size_t)info.st_size;
+    void *image = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        return nullptr;
+    }
+    if (!cart_image_valid((const uint8_t *)image, size)) {
+        munmap(image, size);
+        return nullptr;
+    }
+    return new CartImage((const uint8_t *)image, size, true);
+}
+
+void CartImage::retain() {
+    references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CartImage::release() {
+    if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
@@ -3,13 +3,28 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../include/mapper/axrom.hpp"
 #include "../include/mapper/cnrom.hpp"
 #include "../include/mapper/mmc1.hpp"
+#include "../include/mapper/mmc3.hpp"
 #include "../include/mapper/nrom.hpp"
+#include "../include/mapper/uxrom.hpp"
+
+static uint64_t cart_hash(uint64_t hash, const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
 
 void Cartridge::free() {
-    ::free(prgROM);
-    ::free(chrROM);
+    ::free(chrRam);
+    if (image) {
+        image->release();
+    }
+    chrRam = nullptr;
+    image = nullptr;
     prgROM = nullptr;
     chrROM = nullptr;
     prgSize = 0;
@@ -17,81 +32,163 @@ void Cartridge::free() {
     mapperID = 0;
     mirroring = MIRROR_HORIZONTAL;
     hasChrRam = false;
+    hasBattery = false;
+    irqLine = false;
+    romHash = 0;
     mapper.reset();
+    memset(prgPages, 0, sizeof(prgPages));
+    memset(chrPages, 0, sizeof(chrPages));
+    chrPagesChanged = 0xFF;
 }
 
-bool Cartridge::load(const uint8_t *data, size_t size) {
-    if (!data || size < 16) {
+bool cart_parse_header(const uint8_t *data, size_t size, CartHeader *out) {
+    if (!data || !out || size < 16) {
         return false;
     }
     if (data[0] != 0x4E || data[1] != 0x45 || data[2] != 0x53 || data[3] != 0x1A) {
         return false;
     }
-
-    uint8_t prgBanks = data[4];
-    uint8_t chrBanks = data[5];
     uint8_t flags6 = data[6];
     uint8_t flags7 = data[7];
+    out->mapperID = (uint8_t)((flags7 & 0xF0) | (flags6 >> 4));
+    out->prgBanks = data[4];
+    out->chrBanks = data[5];
+    out->mirroring = (flags6 & 0x01) == 0 ? MIRROR_HORIZONTAL : MIRROR_VERTICAL;
+    out->hasBattery = (flags6 & 0x02) != 0;
+    out->hasTrainer = (flags6 & 0x04) != 0;
+    out->fourScreen = (flags6 & 0x08) != 0;
+    out->prgOffset = out->hasTrainer ? 16 + 512 : 16;
+    out->prgSize = (size_t)out->prgBanks * 16 * 1024;
+    out->chrSize = (size_t)out->chrBanks * 8 * 1024;
+    return true;
+}
 
-    mapperID = (uint8_t)((flags7 & 0xF0) | (flags6 >> 4));
-    mirroring = (flags6 & 0x01) == 0 ? MIRROR_HORIZONTAL : MIRROR_VERTICAL;
+bool cart_mapper_supported(uint8_t mapperID) {
+    switch (mapperID) {
+        case 0:
+        case 1:
+        case 2:
+        case 3:
+        case 4:
+        case 7:
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint64_t cart_rom_hash(const uint8_t *prg, size_t prgSize, const uint8_t *chr, size_t chrSize) {
+    uint64_t hash = cart_hash(1469598103934665603ULL, prg, prgSize);
+    return cart_hash(hash, chr, chrSize);
+}
 
-    size_t offset = 16;
-    if (flags6 & 0x04) {
-        offset += 512;
+bool Cartridge::load(const uint8_t *data, size_t size, CartRomStorage storage) {
+    if (storage == CART_ROM_BORROW) {
+        return attach(data, size);
     }
+    CartImage *copy = CartImage::copy(data, size);
+    bool loaded = loadImage(copy);
+    if (copy) {
+        copy->release();
+    }
+    return loaded;
+}
 
-    size_t prgSizeLocal = (size_t)prgBanks * 16 * 1024;
-    size_t chrSizeLocal = (size_t)chrBanks * 8 * 1024;
-    size_t prgStart = offset;
-    size_t chrStart = prgStart + prgSizeLocal;
+bool Cartridge::loadImage(CartImage *shared) {
+    if (!shared || !attach(shared->data(), shared->size())) {
+        return false;
+    }
+    shared->retain();
+    image = shared;
+    return true;
+}
 
-    if (size < chrStart + chrSizeLocal) {
+bool Cartridge::loadFile(const char *path) {
+    CartImage *mapped = CartImage::map(path);
+    bool loaded = loadImage(mapped);
+    if (mapped) {
+        mapped->release();
+    }
+    return loaded;
+}
+
+// Points PRG and CHR ROM into data, which the caller keeps alive.
+bool Cartridge::attach(const uint8_t *data, size_t size) {
+    CartHeader header;
+    if (!cart_parse_header(data, size, &header) || !cart_mapper_supported(header.mapperID)) {
         return false;
     }
+    mapperID = header.mapperID;
+    mirroring = header.mirroring;
+    hasBattery = header.hasBattery;
 
-    prgROM = (uint8_t *)malloc(prgSizeLocal);
-    if (!prgROM) {
+    size_t prgSizeLocal = header.prgSize;
+    size_t chrSizeLocal = header.chrSize;
+    size_t prgStart = header.prgOffset;
+    size_t chrStart = prgStart + prgSizeLocal;
+
+    if (size < chrStart + chrSizeLocal) {
         return false;
     }
-    memcpy(prgROM, data + prgStart, prgSizeLocal);
+
+    const uint8_t *rom = data + prgStart;
+    prgROM = rom;
     prgSize = prgSizeLocal;
 
     if (chrSizeLocal > 0) {
-        chrROM = (uint8_t *)malloc(chrSizeLocal);
-        if (!chrROM) {
-            return false;
-        }
-        memcpy(chrROM, data + chrStart, chrSizeLocal);
+        chrROM = rom + prgSizeLocal;
         chrSize = chrSizeLocal;
         hasChrRam = false;
     } else {
-        chrROM = (uint8_t *)calloc(8 * 1024, 1);
-        if (!chrROM) {
+        chrRam = (uint8_t *)calloc(8 * 1024, 1);
+        if (!chrRam) {
             return false;
         }
+        chrROM = chrRam;
         chrSize = 8 * 1024;
         hasChrRam = true;
     }
 
     mapper.reset();
     if (mapperID == 0) {
-        mapper = std::make_unique<NromMapper>(prgBanks, chrBanks);
+        mapper = std::make_unique<NromMapper>(header.prgBanks, header.chrBanks);
     } else if (mapperID == 1) {
         mapper = std::make_unique<Mmc1Mapper>();
+    } else if (mapperID == 2) {
+        mapper = std::make_unique<UxromMapper>();
     } else if (mapperID == 3) {
         mapper = std::make_unique<CnromMapper>();
+    } else if (mapperID == 4) {
+        mapper = std::make_unique<Mmc3Mapper>();
+    } else if (mapperID == 7) {
+        mapper = std::make_unique<AxromMapper>();
     } else {
         return false;
     }
+    mapper->updateBanks(*this);
     return true;
 }
 
+// FNV-1a over PRG and CHR ROM, so save states can tell which game they
+// belong to. Computed on first use so loading does not touch every page of
+// a mapped image.
+uint64_t Cartridge::identity() {
+    if (romHash == 0) {
+        romHash = cart_rom_hash(prgROM, prgSize, chrROM, hasChrRam ? 0 : chrSize);
+    }
+    return romHash;
+}
+
 bool Cartridge::cpuRead(uint16_t addr, uint8_t *out) const {
-    if (!mapper) {
+    if (addr < 0x8000) {
+        return false;
+    }
+    const uint8_t *page = prgPage(addr);
+    if (!page) {
         return false;
     }
-    return mapper->cpuRead(const_cast<Cartridge &>(*this), addr, out);
+    *out = page[addr & (CART_PRG_PAGE_SIZE - 1)];
+    return true;
 }
 
 bool Cartridge::cpuWrite(uint16_t addr, uint8_t data) {
@@ -102,15 +199,72 @@ bool Cartridge::cpuWrite(uint16_t addr, uint8_t data) {
 }
 
 bool Cartridge::ppuRead(uint16_t addr, uint8_t *out) const {
-    if (!mapper) {
+    if (addr >= 0x2000) {
         return false;
     }
-    return mapper->ppuRead(const_cast<Cartridge &>(*this), addr, out);
+    const uint8_t *page = chrPage(addr);
+    if (!page) {
+        return false;
+    }
+    *out = page[addr & (CART_CHR_PAGE_SIZE - 1)];
+    return true;
 }
 
 bool Cartridge::ppuWrite(uint16_t addr, uint8_t data) {
-    if (!mapper) {
+    if (!hasChrRam || addr >= 0x2000) {
         return false;
     }
-    return mapper->ppuWrite(*this, addr, data);
+    const uint8_t *page = chrPages[(addr >> 10) & 0x07];
+    if (!page) {
+        return false;
+    }
+    // With CHR RAM every slot points into chrRam.
+    chrRam[(size_t)(page - chrROM) + (addr & (CART_CHR_PAGE_SIZE - 1))] = data;
+    return true;
+}
+
+void Cartridge::saveState(StateWriter &state) const {
+    state.put((uint8_t)mirroring);
+    state.put(irqLine);
+    if (hasChrRam) {
+        state.bytes(chrROM, chrSize);
+    }
+    if (mapper) {
+        mapper->saveState(state);
+    }
+}
+
+void Cartridge::loadState(StateReader &state) {
+    uint8_t mirror = 0;
+    state.get(mirror);
+    mirroring = (Mirroring)(mirror & 0x03);
+    state.get(irqLine);
+    if (hasChrRam) {
+        state.bytes(chrRam, chrSize);
+        chrPagesChanged = 0xFF;
+    }
+    if (mapper) {
+        mapper->loadState(state);
+        mapper->updateBanks(*this);
+    }
+}
+
+void Cartridge::mapPrg(uint16_t addr, size_t offset, size_t size) {
+    for (size_t mapped = 0; mapped < size; mapped += CART_PRG_PAGE_SIZE) {
+        int slot = (int)(((addr + mapped) >> 13) & 0x03);
+        size_t start = offset + mapped;
+        prgPages[slot] = (start + CART_PRG_PAGE_SIZE <= prgSize) ? prgROM + start : nullptr;
+    }
+}
+
+void Cartridge::mapChr(uint16_t addr, size_t offset, size_t size) {
+    for (size_t mapped = 0; mapped < size; mapped += CART_CHR_PAGE_SIZE) {
+        int slot = (int)(((addr + mapped) >> 10) & 0x07);
+        size_t start = offset + mapped;
+        const uint8_t *page = (start + CART_CHR_PAGE_SIZE <= chrSize) ? chrROM + start : nullptr;
+        if (chrPages[slot] != page) {
+            chrPages[slot] = page;
+            chrPagesChanged |= (uint8_t)(1 << slot);
+        }
+    }
 }
@@ -12,6 +12,7 @@ void CPU::write(uint16_t addr, uint8_t data) {
         if (bus) {
             bus->requestStall(513 + extra);
         }
+        NES_PROFILE_ADD(profile, dmaCycles, 513 + extra);
     }
     if (bus) {
         bus->cpuWrite(addr, data);
@@ -45,11 +46,12 @@ void CPU::setZN(uint8_t value) {
     setFlag(CPU_FLAG_N, (value & 0x80) != 0);
 }
 
-uint8_t CPU::fetch() {
-    if (instructions[opcode].mode != ADDR_IMP) {
-        fetched = read(addrAbs);
+template <AddressingMode Mode>
+static inline uint8_t cpu_fetch(CPU *cpu) {
+    if constexpr (Mode != ADDR_IMP) {
+        cpu->fetched = cpu->read(cpu->addrAbs);
     }
-    return fetched;
+    return cpu->fetched;
 }
 
 static uint8_t cpu_IMP(CPU *cpu) {
@@ -98,8 +100,8 @@ static uint8_t cpu_ABS(CPU *cpu) {
     return 0;
 }
 
-static bool cpu_uses_high_byte_bug_for_store(CPU *cpu) {
-    switch (cpu->opcode) {
+static constexpr bool cpu_uses_high_byte_bug_for_store(uint8_t opcode) {
+    switch (opcode) {
         case 0x93:
         case 0x9F:
         case 0x9B:
@@ -111,6 +113,7 @@ static bool cpu_uses_high_byte_bug_for_store(CPU *cpu) {
     }
 }
 
+template <AccessKind Access, bool HighByteBug>
 static uint8_t cpu_ABX(CPU *cpu) {
     uint8_t lo = cpu->read(cpu->pc);
     cpu->pc += 1;
@@ -118,21 +121,21 @@ static uint8_t cpu_ABX(CPU *cpu) {
     cpu->pc += 1;
     cpu->baseHigh = hi;
     uint16_t base = (uint16_t)(hi << 8) | lo;
-    if (cpu_uses_high_byte_bug_for_store(cpu)) {
+    if constexpr (HighByteBug) {
         uint8_t low = (uint8_t)(lo + cpu->x);
         cpu->addrAbs = (uint16_t)(cpu->baseHigh << 8) | low;
     } else {
         cpu->addrAbs = (uint16_t)(base + cpu->x);
     }
     bool pageCross = (cpu->addrAbs & 0xFF00) != (base & 0xFF00);
-    AccessKind access = cpu->instructions[cpu->opcode].access;
-    if (access == ACCESS_WRITE || (access == ACCESS_READ && pageCross) || access == ACCESS_READ_MODIFY_WRITE) {
+    if (Access == ACCESS_WRITE || (Access == ACCESS_READ && pageCross) || Access == ACCESS_READ_MODIFY_WRITE) {
         uint16_t dummyAddr = (uint16_t)((base & 0xFF00) | (cpu->addrAbs & 0x00FF));
         (void)cpu->read(dummyAddr);
     }
-    return (access == ACCESS_READ && pageCross) ? 1 : 0;
+    return (Access == ACCESS_READ && pageCross) ? 1 : 0;
 }
 
+template <AccessKind Access, bool HighByteBug>
 static uint8_t cpu_ABY(CPU *cpu) {
     uint8_t lo = cpu->read(cpu->pc);
     cpu->pc += 1;
@@ -140,19 +143,18 @@ static uint8_t cpu_ABY(CPU *cpu) {
     cpu->pc += 1;
     cpu->baseHigh = hi;
     uint16_t base = (uint16_t)(hi << 8) | lo;
-    if (cpu_uses_high_byte_bug_for_store(cpu)) {
+    if constexpr (HighByteBug) {
         uint8_t low = (uint8_t)(lo + cpu->y);
         cpu->addrAbs = (uint16_t)(cpu->baseHigh << 8) | low;
     } else {
         cpu->addrAbs = (uint16_t)(base + cpu->y);
     }
     bool pageCross = (cpu->addrAbs & 0xFF00) != (base & 0xFF00);
-    AccessKind access = cpu->instructions[cpu->opcode].access;
-    if (access == ACCESS_WRITE || (access == ACCESS_READ && pageCross) || access == ACCESS_READ_MODIFY_WRITE) {
+    if (Access == ACCESS_WRITE || (Access == ACCESS_READ && pageCross) || Access == ACCESS_READ_MODIFY_WRITE) {
         uint16_t dummyAddr = (uint16_t)((base & 0xFF00) | (cpu->addrAbs & 0x00FF));
         (void)cpu->read(dummyAddr);
     }
-    return (access == ACCESS_READ && pageCross) ? 1 : 0;
+    return (Access == ACCESS_READ && pageCross) ? 1 : 0;
 }
 
 static uint8_t cpu_IND(CPU *cpu) {
@@ -176,6 +178,7 @@ static uint8_t cpu_IZX(CPU *cpu) {
     return 0;
 }
 
+template <AccessKind Access, bool HighByteBug>
 static uint8_t cpu_IZY(CPU *cpu) {
     uint8_t t = cpu->read(cpu->pc);
     cpu->pc += 1;
@@ -183,19 +186,18 @@ static uint8_t cpu_IZY(CPU *cpu) {
     uint8_t hi = cpu->read((uint16_t)(uint8_t)(t + 1));
     cpu->baseHigh = hi;
     uint16_t base = (uint16_t)(hi << 8) | lo;
-    if (cpu_uses_high_byte_bug_for_store(cpu)) {
+    if constexpr (HighByteBug) {
         uint8_t low = (uint8_t)(lo + cpu->y);
         cpu->addrAbs = (uint16_t)(cpu->baseHigh << 8) | low;
     } else {
         cpu->addrAbs = (uint16_t)(base + cpu->y);
     }
     bool pageCross = (cpu->addrAbs & 0xFF00) != (base & 0xFF00);
-    AccessKind access = cpu->instructions[cpu->opcode].access;
-    if ((access == ACCESS_WRITE && pageCross) || (access == ACCESS_READ && pageCross) || (access == ACCESS_READ_MODIFY_WRITE && pageCross)) {
+    if ((Access == ACCESS_WRITE && pageCross) || (Access == ACCESS_READ && pageCross) || (Access == ACCESS_READ_MODIFY_WRITE && pageCross)) {
         uint16_t dummyAddr = (uint16_t)((base & 0xFF00) | (cpu->addrAbs & 0x00FF));
         (void)cpu->read(dummyAddr);
     }
-    return (access == ACCESS_READ && pageCross) ? 1 : 0;
+    return (Access == ACCESS_READ && pageCross) ? 1 : 0;
 }
 
 static uint8_t cpu_REL(CPU *cpu) {
@@ -250,22 +252,25 @@ static uint8_t cpu_branch(CPU *cpu, bool condition) {
     return 0;
 }
 
-static uint8_t cpu_ADC(CPU *cpu) { cpu_adc_with(cpu, cpu->fetch()); return 1; }
-static uint8_t cpu_AND(CPU *cpu) { cpu->a &= cpu->fetch(); cpu->setZN(cpu->a); return 1; }
+template <AddressingMode Mode>
+static uint8_t cpu_ADC(CPU *cpu) { cpu_adc_with(cpu, cpu_fetch<Mode>(cpu)); return 1; }
+template <AddressingMode Mode>
+static uint8_t cpu_AND(CPU *cpu) { cpu->a &= cpu_fetch<Mode>(cpu); cpu->setZN(cpu->a); return 1; }
 
+template <AddressingMode Mode>
 static uint8_t cpu_ASL(CPU *cpu) {
-    if (cpu->instructions[cpu->opcode].mode == ADDR_IMP) {
+    if constexpr (Mode == ADDR_IMP) {
         cpu->impliedDummyRead();
     }
-    uint8_t value = cpu->fetch();
-    if (cpu->instructions[cpu->opcode].mode != ADDR_IMP) {
+    uint8_t value = cpu_fetch<Mode>(cpu);
+    if constexpr (Mode != ADDR_IMP) {
         cpu->write(cpu->addrAbs, value);
     }
     uint16_t result = (uint16_t)value << 1;
     cpu->setFlag(CPU_FLAG_C, (result & 0xFF00) != 0);
     uint8_t output = (uint8_t)(result & 0x00FF);
     cpu->setZN(output);
-    if (cpu->instructions[cpu->opcode].mode == ADDR_IMP) {
+    if constexpr (Mode == ADDR_IMP) {
         cpu->a = output;
     } else {
         cpu->write(cpu->addrAbs, output);
@@ -273,17 +278,26 @@ static uint8_t cpu_ASL(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_BCC(CPU *cpu) { return cpu_branch(cpu, cpu->getFlag(CPU_FLAG_C) == 0); }
+template <AddressingMode Mode>
 static uint8_t cpu_BCS(CPU *cpu) { return cpu_branch(cpu, cpu->getFlag(CPU_FLAG_C) == 1); }
+template <AddressingMode Mode>
 static uint8_t cpu_BEQ(CPU *cpu) { return cpu_branch(cpu, cpu->getFlag(CPU_FLAG_Z) == 1); }
+template <AddressingMode Mode>
 static uint8_t cpu_BMI(CPU *cpu) { return cpu_branch(cpu, cpu->getFlag(CPU_FLAG_N) == 1); }
+template <AddressingMode Mode>
 static uint8_t cpu_BNE(CPU *cpu) { return cpu_branch(cpu, cpu->getFlag(CPU_FLAG_Z) == 0); }
+template <AddressingMode Mode>
 static uint8_t cpu_BPL(CPU *cpu) { return cpu_branch(cpu, cpu->getFlag(CPU_FLAG_N) == 0); }
+template <AddressingMode Mode>
 static uint8_t cpu_BVC(CPU *cpu) { return cpu_branch(cpu, cpu->getFlag(CPU_FLAG_V) == 0); }
+template <AddressingMode Mode>
 static uint8_t cpu_BVS(CPU *cpu) { return cpu_branch(cpu, cpu->getFlag(CPU_FLAG_V) == 1); }
 
+template <AddressingMode Mode>
 static uint8_t cpu_BIT(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     uint8_t temp = (uint8_t)(cpu->a & value);
     cpu->setFlag(CPU_FLAG_Z, temp == 0);
     cpu->setFlag(CPU_FLAG_V, (value & 0x40) != 0);
@@ -291,6 +305,7 @@ static uint8_t cpu_BIT(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_BRK(CPU *cpu) {
     cpu->impliedDummyRead();
     cpu->pc += 1;
@@ -306,38 +321,46 @@ static uint8_t cpu_BRK(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_CLC(CPU *cpu) { cpu->impliedDummyRead(); cpu->setFlag(CPU_FLAG_C, false); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_CLD(CPU *cpu) { cpu->impliedDummyRead(); cpu->setFlag(CPU_FLAG_D, false); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_CLI(CPU *cpu) { cpu->impliedDummyRead(); cpu->setFlag(CPU_FLAG_I, false); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_CLV(CPU *cpu) { cpu->impliedDummyRead(); cpu->setFlag(CPU_FLAG_V, false); return 0; }
 
+template <AddressingMode Mode>
 static uint8_t cpu_CMP(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     uint16_t temp = (uint16_t)cpu->a - value;
     cpu->setFlag(CPU_FLAG_C, cpu->a >= value);
     cpu->setZN((uint8_t)(temp & 0x00FF));
     return 1;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_CPX(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     uint16_t temp = (uint16_t)cpu->x - value;
     cpu->setFlag(CPU_FLAG_C, cpu->x >= value);
     cpu->setZN((uint8_t)(temp & 0x00FF));
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_CPY(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     uint16_t temp = (uint16_t)cpu->y - value;
     cpu->setFlag(CPU_FLAG_C, cpu->y >= value);
     cpu->setZN((uint8_t)(temp & 0x00FF));
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_DEC(CPU *cpu) {
-    uint8_t value = cpu->fetch();
-    if (cpu->instructions[cpu->opcode].mode != ADDR_IMP) {
+    uint8_t value = cpu_fetch<Mode>(cpu);
+    if constexpr (Mode != ADDR_IMP) {
         cpu->write(cpu->addrAbs, value);
     }
     uint8_t result = (uint8_t)(value - 1);
@@ -346,14 +369,18 @@ static uint8_t cpu_DEC(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_DEX(CPU *cpu) { cpu->impliedDummyRead(); cpu->x -= 1; cpu->setZN(cpu->x); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_DEY(CPU *cpu) { cpu->impliedDummyRead(); cpu->y -= 1; cpu->setZN(cpu->y); return 0; }
 
-static uint8_t cpu_EOR(CPU *cpu) { cpu->a ^= cpu->fetch(); cpu->setZN(cpu->a); return 1; }
+template <AddressingMode Mode>
+static uint8_t cpu_EOR(CPU *cpu) { cpu->a ^= cpu_fetch<Mode>(cpu); cpu->setZN(cpu->a); return 1; }
 
+template <AddressingMode Mode>
 static uint8_t cpu_INC(CPU *cpu) {
-    uint8_t value = cpu->fetch();
-    if (cpu->instructions[cpu->opcode].mode != ADDR_IMP) {
+    uint8_t value = cpu_fetch<Mode>(cpu);
+    if constexpr (Mode != ADDR_IMP) {
         cpu->write(cpu->addrAbs, value);
     }
     uint8_t result = (uint8_t)(value + 1);
@@ -362,11 +389,15 @@ static uint8_t cpu_INC(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_INX(CPU *cpu) { cpu->impliedDummyRead(); cpu->x += 1; cpu->setZN(cpu->x); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_INY(CPU *cpu) { cpu->impliedDummyRead(); cpu->y += 1; cpu->setZN(cpu->y); return 0; }
 
+template <AddressingMode Mode>
 static uint8_t cpu_JMP(CPU *cpu) { cpu->pc = cpu->addrAbs; return 0; }
 
+template <AddressingMode Mode>
 static uint8_t cpu_JSR(CPU *cpu) {
     cpu->pc -= 1;
     cpu->push((uint8_t)((cpu->pc >> 8) & 0xFF));
@@ -378,22 +409,26 @@ static uint8_t cpu_JSR(CPU *cpu) {
     return 0;
 }
 
-static uint8_t cpu_LDA(CPU *cpu) { cpu->a = cpu->fetch(); cpu->setZN(cpu->a); return 1; }
-static uint8_t cpu_LDX(CPU *cpu) { cpu->x = cpu->fetch(); cpu->setZN(cpu->x); return 1; }
-static uint8_t cpu_LDY(CPU *cpu) { cpu->y = cpu->fetch(); cpu->setZN(cpu->y); return 1; }
+template <AddressingMode Mode>
+static uint8_t cpu_LDA(CPU *cpu) { cpu->a = cpu_fetch<Mode>(cpu); cpu->setZN(cpu->a); return 1; }
+template <AddressingMode Mode>
+static uint8_t cpu_LDX(CPU *cpu) { cpu->x = cpu_fetch<Mode>(cpu); cpu->setZN(cpu->x); return 1; }
+template <AddressingMode Mode>
+static uint8_t cpu_LDY(CPU *cpu) { cpu->y = cpu_fetch<Mode>(cpu); cpu->setZN(cpu->y); return 1; }
 
+template <AddressingMode Mode>
 static uint8_t cpu_LSR(CPU *cpu) {
-    if (cpu->instructions[cpu->opcode].mode == ADDR_IMP) {
+    if constexpr (Mode == ADDR_IMP) {
         cpu->impliedDummyRead();
     }
-    uint8_t value = cpu->fetch();
-    if (cpu->instructions[cpu->opcode].mode != ADDR_IMP) {
+    uint8_t value = cpu_fetch<Mode>(cpu);
+    if constexpr (Mode != ADDR_IMP) {
         cpu->write(cpu->addrAbs, value);
     }
     cpu->setFlag(CPU_FLAG_C, (value & 0x01) != 0);
     uint8_t result = (uint8_t)(value >> 1);
     cpu->setZN(result);
-    if (cpu->instructions[cpu->opcode].mode == ADDR_IMP) {
+    if constexpr (Mode == ADDR_IMP) {
         cpu->a = result;
     } else {
         cpu->write(cpu->addrAbs, result);
@@ -401,24 +436,27 @@ static uint8_t cpu_LSR(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_NOP(CPU *cpu) {
     cpu->impliedDummyRead();
-    if (cpu->instructions[cpu->opcode].mode != ADDR_IMP) {
-        (void)cpu->fetch();
+    if constexpr (Mode != ADDR_IMP) {
+        (void)cpu_fetch<Mode>(cpu);
     }
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_NOPR(CPU *cpu) {
     cpu->impliedDummyRead();
-    if (cpu->instructions[cpu->opcode].mode != ADDR_IMP) {
-        (void)cpu->fetch();
+    if constexpr (Mode != ADDR_IMP) {
+        (void)cpu_fetch<Mode>(cpu);
     }
     return 1;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_SLO(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     cpu->write(cpu->addrAbs, value);
     uint8_t result = (uint8_t)(((uint16_t)value << 1) & 0x00FF);
     cpu->setFlag(CPU_FLAG_C, (value & 0x80) != 0);
@@ -428,8 +466,9 @@ static uint8_t cpu_SLO(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_RLA(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     cpu->write(cpu->addrAbs, value);
     uint8_t carryIn = cpu->getFlag(CPU_FLAG_C);
     cpu->setFlag(CPU_FLAG_C, (value & 0x80) != 0);
@@ -440,8 +479,9 @@ static uint8_t cpu_RLA(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_SRE(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     cpu->write(cpu->addrAbs, value);
     cpu->setFlag(CPU_FLAG_C, (value & 0x01) != 0);
     uint8_t result = (uint8_t)(value >> 1);
@@ -451,8 +491,9 @@ static uint8_t cpu_SRE(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_RRA(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     cpu->write(cpu->addrAbs, value);
     uint8_t carryIn = cpu->getFlag(CPU_FLAG_C);
     cpu->setFlag(CPU_FLAG_C, (value & 0x01) != 0);
@@ -462,18 +503,21 @@ static uint8_t cpu_RRA(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_SAX(CPU *cpu) { cpu->write(cpu->addrAbs, (uint8_t)(cpu->a & cpu->x)); return 0; }
 
+template <AddressingMode Mode>
 static uint8_t cpu_LAX(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     cpu->a = value;
     cpu->x = value;
     cpu->setZN(value);
     return 1;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_DCP(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     cpu->write(cpu->addrAbs, value);
     uint8_t result = (uint8_t)(value - 1);
     cpu->write(cpu->addrAbs, result);
@@ -483,8 +527,9 @@ static uint8_t cpu_DCP(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_ISC(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     cpu->write(cpu->addrAbs, value);
     uint8_t result = (uint8_t)(value + 1);
     cpu->write(cpu->addrAbs, result);
@@ -492,23 +537,26 @@ static uint8_t cpu_ISC(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_ANC(CPU *cpu) {
-    cpu->a &= cpu->fetch();
+    cpu->a &= cpu_fetch<Mode>(cpu);
     cpu->setZN(cpu->a);
     cpu->setFlag(CPU_FLAG_C, (cpu->a & 0x80) != 0);
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_ASR(CPU *cpu) {
-    cpu->a &= cpu->fetch();
+    cpu->a &= cpu_fetch<Mode>(cpu);
     cpu->setFlag(CPU_FLAG_C, (cpu->a & 0x01) != 0);
     cpu->a >>= 1;
     cpu->setZN(cpu->a);
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_ARR(CPU *cpu) {
-    cpu->a &= cpu->fetch();
+    cpu->a &= cpu_fetch<Mode>(cpu);
     uint8_t carryIn = cpu->getFlag(CPU_FLAG_C);
     uint8_t result = (uint8_t)(((uint16_t)carryIn << 7) | (cpu->a >> 1));
     cpu->a = result;
@@ -518,23 +566,26 @@ static uint8_t cpu_ARR(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_ANE(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     cpu->a = (uint8_t)((cpu->a | 0xEE) & cpu->x & value);
     cpu->setZN(cpu->a);
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_LXA(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     cpu->a = (uint8_t)((cpu->a | 0xEE) & value);
     cpu->x = cpu->a;
     cpu->setZN(cpu->a);
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_AXS(CPU *cpu) {
-    uint8_t value = cpu->fetch();
+    uint8_t value = cpu_fetch<Mode>(cpu);
     uint8_t temp = (uint8_t)((cpu->a & cpu->x) - value);
     cpu->setFlag(CPU_FLAG_C, (cpu->a & cpu->x) >= value);
     cpu->x = temp;
@@ -542,6 +593,7 @@ static uint8_t cpu_AXS(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_SHA(CPU *cpu) {
     uint8_t high = (uint8_t)((cpu->addrAbs >> 8) & 0xFF);
     uint8_t value = (uint8_t)(cpu->a & cpu->x & (uint8_t)(high + 1));
@@ -549,6 +601,7 @@ static uint8_t cpu_SHA(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_SHX(CPU *cpu) {
     uint8_t high = (uint8_t)((cpu->addrAbs >> 8) & 0xFF);
     uint8_t value = (uint8_t)(cpu->x & (uint8_t)(high + 1));
@@ -556,6 +609,7 @@ static uint8_t cpu_SHX(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_SHY(CPU *cpu) {
     uint8_t high = (uint8_t)((cpu->addrAbs >> 8) & 0xFF);
     uint8_t value = (uint8_t)(cpu->y & (uint8_t)(high + 1));
@@ -563,6 +617,7 @@ static uint8_t cpu_SHY(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_SHS(CPU *cpu) {
     cpu->sp = (uint8_t)(cpu->a & cpu->x);
     uint8_t high = (uint8_t)((cpu->addrAbs >> 8) & 0xFF);
@@ -571,8 +626,9 @@ static uint8_t cpu_SHS(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_LAE(CPU *cpu) {
-    uint8_t value = (uint8_t)(cpu->fetch() & cpu->sp);
+    uint8_t value = (uint8_t)(cpu_fetch<Mode>(cpu) & cpu->sp);
     cpu->a = value;
     cpu->x = value;
     cpu->sp = value;
@@ -580,26 +636,32 @@ static uint8_t cpu_LAE(CPU *cpu) {
     return 1;
 }
 
-static uint8_t cpu_ORA(CPU *cpu) { cpu->a |= cpu->fetch(); cpu->setZN(cpu->a); return 1; }
+template <AddressingMode Mode>
+static uint8_t cpu_ORA(CPU *cpu) { cpu->a |= cpu_fetch<Mode>(cpu); cpu->setZN(cpu->a); return 1; }
 
+template <AddressingMode Mode>
 static uint8_t cpu_PHA(CPU *cpu) { cpu->impliedDummyRead(); cpu->push(cpu->a); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_PHP(CPU *cpu) { cpu->impliedDummyRead(); cpu_push_status(cpu, true); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_PLA(CPU *cpu) { cpu->impliedDummyRead(); cpu->a = cpu->pop(); cpu->setZN(cpu->a); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_PLP(CPU *cpu) { cpu->impliedDummyRead(); cpu->status = cpu->pop(); cpu->setFlag(CPU_FLAG_U, true); return 0; }
 
+template <AddressingMode Mode>
 static uint8_t cpu_ROL(CPU *cpu) {
-    if (cpu->instructions[cpu->opcode].mode == ADDR_IMP) {
+    if constexpr (Mode == ADDR_IMP) {
         cpu->impliedDummyRead();
     }
-    uint8_t value = cpu->fetch();
-    if (cpu->instructions[cpu->opcode].mode != ADDR_IMP) {
+    uint8_t value = cpu_fetch<Mode>(cpu);
+    if constexpr (Mode != ADDR_IMP) {
         cpu->write(cpu->addrAbs, value);
     }
     uint16_t result = (uint16_t)value << 1 | cpu->getFlag(CPU_FLAG_C);
     cpu->setFlag(CPU_FLAG_C, (result & 0xFF00) != 0);
     uint8_t output = (uint8_t)(result & 0x00FF);
     cpu->setZN(output);
-    if (cpu->instructions[cpu->opcode].mode == ADDR_IMP) {
+    if constexpr (Mode == ADDR_IMP) {
         cpu->a = output;
     } else {
         cpu->write(cpu->addrAbs, output);
@@ -607,19 +669,20 @@ static uint8_t cpu_ROL(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_ROR(CPU *cpu) {
-    if (cpu->instructions[cpu->opcode].mode == ADDR_IMP) {
+    if constexpr (Mode == ADDR_IMP) {
         cpu->impliedDummyRead();
     }
-    uint8_t value = cpu->fetch();
-    if (cpu->instructions[cpu->opcode].mode != ADDR_IMP) {
+    uint8_t value = cpu_fetch<Mode>(cpu);
+    if constexpr (Mode != ADDR_IMP) {
         cpu->write(cpu->addrAbs, value);
     }
     uint16_t result = (uint16_t)cpu->getFlag(CPU_FLAG_C) << 7 | (uint16_t)(value >> 1);
     cpu->setFlag(CPU_FLAG_C, (value & 0x01) != 0);
     uint8_t output = (uint8_t)(result & 0x00FF);
     cpu->setZN(output);
-    if (cpu->instructions[cpu->opcode].mode == ADDR_IMP) {
+    if constexpr (Mode == ADDR_IMP) {
         cpu->a = output;
     } else {
         cpu->write(cpu->addrAbs, output);
@@ -627,6 +690,7 @@ static uint8_t cpu_ROR(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_RTI(CPU *cpu) {
     cpu->impliedDummyRead();
     cpu->status = cpu->pop();
@@ -637,6 +701,7 @@ static uint8_t cpu_RTI(CPU *cpu) {
     return 0;
 }
 
+template <AddressingMode Mode>
 static uint8_t cpu_RTS(CPU *cpu) {
     cpu->impliedDummyRead();
     uint8_t lo = cpu->pop();
@@ -645,315 +710,562 @@ static uint8_t cpu_RTS(CPU *cpu) {
     return 0;
 }
 
-static uint8_t cpu_SBC(CPU *cpu) { cpu_sbc_with(cpu, cpu->fetch()); return 1; }
+template <AddressingMode Mode>
+static uint8_t cpu_SBC(CPU *cpu) { cpu_sbc_with(cpu, cpu_fetch<Mode>(cpu)); return 1; }
 
+template <AddressingMode Mode>
 static uint8_t cpu_SEC(CPU *cpu) { cpu->impliedDummyRead(); cpu->setFlag(CPU_FLAG_C, true); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_SED(CPU *cpu) { cpu->impliedDummyRead(); cpu->setFlag(CPU_FLAG_D, true); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_SEI(CPU *cpu) { cpu->impliedDummyRead(); cpu->setFlag(CPU_FLAG_I, true); return 0; }
 
+template <AddressingMode Mode>
 static uint8_t cpu_STA(CPU *cpu) { cpu->write(cpu->addrAbs, cpu->a); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_STX(CPU *cpu) { cpu->write(cpu->addrAbs, cpu->x); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_STY(CPU *cpu) { cpu->write(cpu->addrAbs, cpu->y); return 0; }
 
+template <AddressingMode Mode>
 static uint8_t cpu_TAX(CPU *cpu) { cpu->impliedDummyRead(); cpu->x = cpu->a; cpu->setZN(cpu->x); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_TAY(CPU *cpu) { cpu->impliedDummyRead(); cpu->y = cpu->a; cpu->setZN(cpu->y); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_TSX(CPU *cpu) { cpu->impliedDummyRead(); cpu->x = cpu->sp; cpu->setZN(cpu->x); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_TXA(CPU *cpu) { cpu->impliedDummyRead(); cpu->a = cpu->x; cpu->setZN(cpu->a); return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_TXS(CPU *cpu) { cpu->impliedDummyRead(); cpu->sp = cpu->x; return 0; }
+template <AddressingMode Mode>
 static uint8_t cpu_TYA(CPU *cpu) { cpu->impliedDummyRead(); cpu->a = cpu->y; cpu->setZN(cpu->a); return 0; }
 
-static AccessKind cpu_access_for(const char *name) {
-    if (!strcmp(name, "STA") || !strcmp(name, "STX") || !strcmp(name, "STY") || !strcmp(name, "SAX") ||
-        !strcmp(name, "SHA") || !strcmp(name, "SHX") || !strcmp(name, "SHY") || !strcmp(name, "SHS")) {
-        return ACCESS_WRITE;
-    }
-    if (!strcmp(name, "ASL") || !strcmp(name, "LSR") || !strcmp(name, "ROL") || !strcmp(name, "ROR") ||
-        !strcmp(name, "INC") || !strcmp(name, "DEC") || !strcmp(name, "SLO") || !strcmp(name, "RLA") ||
-        !strcmp(name, "SRE") || !strcmp(name, "RRA") || !strcmp(name, "DCP") || !strcmp(name, "ISC")) {
-        return ACCESS_READ_MODIFY_WRITE;
-    }
-    return ACCESS_READ;
-}
+typedef enum {
+    OP_ADC,
+    OP_ANC,
+    OP_AND,
+    OP_ANE,
+    OP_ARR,
+    OP_ASL,
+    OP_ASR,
+    OP_AXS,
+    OP_BCC,
+    OP_BCS,
+    OP_BEQ,
+    OP_BIT,
+    OP_BMI,
+    OP_BNE,
+    OP_BPL,
+    OP_BRK,
+    OP_BVC,
+    OP_BVS,
+    OP_CLC,
+    OP_CLD,
+    OP_CLI,
+    OP_CLV,
+    OP_CMP,
+    OP_CPX,
+    OP_CPY,
+    OP_DCP,
+    OP_DEC,
+    OP_DEX,
+    OP_DEY,
+    OP_EOR,
+    OP_INC,
+    OP_INX,
+    OP_INY,
+    OP_ISC,
+    OP_JMP,
+    OP_JSR,
+    OP_LAE,
+    OP_LAX,
+    OP_LDA,
+    OP_LDX,
+    OP_LDY,
+    OP_LSR,
+    OP_LXA,
+    OP_NOP,
+    OP_NOPR,
+    OP_ORA,
+    OP_PHA,
+    OP_PHP,
+    OP_PLA,
+    OP_PLP,
+    OP_RLA,
+    OP_ROL,
+    OP_ROR,
+    OP_RRA,
+    OP_RTI,
+    OP_RTS,
+    OP_SAX,
+    OP_SBC,
+    OP_SEC,
+    OP_SED,
+    OP_SEI,
+    OP_SHA,
+    OP_SHS,
+    OP_SHX,
+    OP_SHY,
+    OP_SLO,
+    OP_SRE,
+    OP_STA,
+    OP_STX,
+    OP_STY,
+    OP_TAX,
+    OP_TAY,
+    OP_TSX,
+    OP_TXA,
+    OP_TXS,
+    OP_TYA,
+} CpuOperation;
 
-static void cpu_set_instruction(CPU *cpu, uint8_t opcode, const char *name, cpu_op op, cpu_op mode, AddressingMode kind, uint8_t cycles) {
-    cpu->instructions[opcode].name = name;
-    cpu->instructions[opcode].operate = op;
-    cpu->instructions[opcode].addrMode = mode;
-    cpu->instructions[opcode].mode = kind;
-    cpu->instructions[opcode].access = cpu_access_for(name);
-    cpu->instructions[opcode].cycles = cycles;
-}
+typedef struct {
+    const char *name;
+    CpuOperation operation;
+    AddressingMode mode;
+    AccessKind access;
+    uint8_t cycles;
+} OpcodeInfo;
 
 typedef struct {
     uint8_t opcode;
     const char *name;
-    cpu_op operate;
-    cpu_op addrMode;
+    CpuOperation operation;
     AddressingMode mode;
     uint8_t cycles;
-} InstructionDef;
+} OpcodeDef;
+
+static const OpcodeDef cpu_opcode_defs[] = {
+    {0x00, "BRK", OP_BRK, ADDR_IMM, 7},
+    {0x01, "ORA", OP_ORA, ADDR_IZX, 6},
+    {0x05, "ORA", OP_ORA, ADDR_ZP0, 3},
+    {0x06, "ASL", OP_ASL, ADDR_ZP0, 5},
+    {0x08, "PHP", OP_PHP, ADDR_IMP, 3},
+    {0x09, "ORA", OP_ORA, ADDR_IMM, 2},
+    {0x0A, "ASL", OP_ASL, ADDR_IMP, 2},
+    {0x0D, "ORA", OP_ORA, ADDR_ABS, 4},
+    {0x0E, "ASL", OP_ASL, ADDR_ABS, 6},
+    {0x10, "BPL", OP_BPL, ADDR_REL, 2},
+    {0x11, "ORA", OP_ORA, ADDR_IZY, 5},
+    {0x15, "ORA", OP_ORA, ADDR_ZPX, 4},
+    {0x16, "ASL", OP_ASL, ADDR_ZPX, 6},
+    {0x18, "CLC", OP_CLC, ADDR_IMP, 2},
+    {0x19, "ORA", OP_ORA, ADDR_ABY, 4},
+    {0x1D, "ORA", OP_ORA, ADDR_ABX, 4},
+    {0x1E, "ASL", OP_ASL, ADDR_ABX, 7},
+    {0x20, "JSR", OP_JSR, ADDR_ABS, 6},
+    {0x21, "AND", OP_AND, ADDR_IZX, 6},
+    {0x24, "BIT", OP_BIT, ADDR_ZP0, 3},
+    {0x25, "AND", OP_AND, ADDR_ZP0, 3},
+    {0x26, "ROL", OP_ROL, ADDR_ZP0, 5},
+    {0x28, "PLP", OP_PLP, ADDR_IMP, 4},
+    {0x29, "AND", OP_AND, ADDR_IMM, 2},
+    {0x2A, "ROL", OP_ROL, ADDR_IMP, 2},
+    {0x2C, "BIT", OP_BIT, ADDR_ABS, 4},
+    {0x2D, "AND", OP_AND, ADDR_ABS, 4},
+    {0x2E, "ROL", OP_ROL, ADDR_ABS, 6},
+    {0x30, "BMI", OP_BMI, ADDR_REL, 2},
+    {0x31, "AND", OP_AND, ADDR_IZY, 5},
+    {0x35, "AND", OP_AND, ADDR_ZPX, 4},
+    {0x36, "ROL", OP_ROL, ADDR_ZPX, 6},
+    {0x38, "SEC", OP_SEC, ADDR_IMP, 2},
+    {0x39, "AND", OP_AND, ADDR_ABY, 4},
+    {0x3D, "AND", OP_AND, ADDR_ABX, 4},
+    {0x3E, "ROL", OP_ROL, ADDR_ABX, 7},
+    {0x40, "RTI", OP_RTI, ADDR_IMP, 6},
+    {0x41, "EOR", OP_EOR, ADDR_IZX, 6},
+    {0x45, "EOR", OP_EOR, ADDR_ZP0, 3},
+    {0x46, "LSR", OP_LSR, ADDR_ZP0, 5},
+    {0x48, "PHA", OP_PHA, ADDR_IMP, 3},
+    {0x49, "EOR", OP_EOR, ADDR_IMM, 2},
+    {0x4A, "LSR", OP_LSR, ADDR_IMP, 2},
+    {0x4C, "JMP", OP_JMP, ADDR_ABS, 3},
+    {0x4D, "EOR", OP_EOR, ADDR_ABS, 4},
+    {0x4E, "LSR", OP_LSR, ADDR_ABS, 6},
+    {0x50, "BVC", OP_BVC, ADDR_REL, 2},
+    {0x51, "EOR", OP_EOR, ADDR_IZY, 5},
+    {0x55, "EOR", OP_EOR, ADDR_ZPX, 4},
+    {0x56, "LSR", OP_LSR, ADDR_ZPX, 6},
+    {0x58, "CLI", OP_CLI, ADDR_IMP, 2},
+    {0x59, "EOR", OP_EOR, ADDR_ABY, 4},
+    {0x5D, "EOR", OP_EOR, ADDR_ABX, 4},
+    {0x5E, "LSR", OP_LSR, ADDR_ABX, 7},
+    {0x60, "RTS", OP_RTS, ADDR_IMP, 6},
+    {0x61, "ADC", OP_ADC, ADDR_IZX, 6},
+    {0x65, "ADC", OP_ADC, ADDR_ZP0, 3},
+    {0x66, "ROR", OP_ROR, ADDR_ZP0, 5},
+    {0x68, "PLA", OP_PLA, ADDR_IMP, 4},
+    {0x69, "ADC", OP_ADC, ADDR_IMM, 2},
+    {0x6A, "ROR", OP_ROR, ADDR_IMP, 2},
+    {0x6C, "JMP", OP_JMP, ADDR_IND, 5},
+    {0x6D, "ADC", OP_ADC, ADDR_ABS, 4},
+    {0x6E, "ROR", OP_ROR, ADDR_ABS, 6},
+    {0x70, "BVS", OP_BVS, ADDR_REL, 2},
+    {0x71, "ADC", OP_ADC, ADDR_IZY, 5},
+    {0x75, "ADC", OP_ADC, ADDR_ZPX, 4},
+    {0x76, "ROR", OP_ROR, ADDR_ZPX, 6},
+    {0x78, "SEI", OP_SEI, ADDR_IMP, 2},
+    {0x79, "ADC", OP_ADC, ADDR_ABY, 4},
+    {0x7D, "ADC", OP_ADC, ADDR_ABX, 4},
+    {0x7E, "ROR", OP_ROR, ADDR_ABX, 7},
+    {0x81, "STA", OP_STA, ADDR_IZX, 6},
+    {0x84, "STY", OP_STY, ADDR_ZP0, 3},
+    {0x85, "STA", OP_STA, ADDR_ZP0, 3},
+    {0x86, "STX", OP_STX, ADDR_ZP0, 3},
+    {0x88, "DEY", OP_DEY, ADDR_IMP, 2},
+    {0x8A, "TXA", OP_TXA, ADDR_IMP, 2},
+    {0x8C, "STY", OP_STY, ADDR_ABS, 4},
+    {0x8D, "STA", OP_STA, ADDR_ABS, 4},
+    {0x8E, "STX", OP_STX, ADDR_ABS, 4},
+    {0x90, "BCC", OP_BCC, ADDR_REL, 2},
+    {0x91, "STA", OP_STA, ADDR_IZY, 6},
+    {0x94, "STY", OP_STY, ADDR_ZPX, 4},
+    {0x95, "STA", OP_STA, ADDR_ZPX, 4},
+    {0x96, "STX", OP_STX, ADDR_ZPY, 4},
+    {0x98, "TYA", OP_TYA, ADDR_IMP, 2},
+    {0x99, "STA", OP_STA, ADDR_ABY, 5},
+    {0x9A, "TXS", OP_TXS, ADDR_IMP, 2},
+    {0x9D, "STA", OP_STA, ADDR_ABX, 5},
+    {0xA0, "LDY", OP_LDY, ADDR_IMM, 2},
+    {0xA1, "LDA", OP_LDA, ADDR_IZX, 6},
+    {0xA2, "LDX", OP_LDX, ADDR_IMM, 2},
+    {0xA4, "LDY", OP_LDY, ADDR_ZP0, 3},
+    {0xA5, "LDA", OP_LDA, ADDR_ZP0, 3},
+    {0xA6, "LDX", OP_LDX, ADDR_ZP0, 3},
+    {0xA8, "TAY", OP_TAY, ADDR_IMP, 2},
+    {0xA9, "LDA", OP_LDA, ADDR_IMM, 2},
+    {0xAA, "TAX", OP_TAX, ADDR_IMP, 2},
+    {0xAC, "LDY", OP_LDY, ADDR_ABS, 4},
+    {0xAD, "LDA", OP_LDA, ADDR_ABS, 4},
+    {0xAE, "LDX", OP_LDX, ADDR_ABS, 4},
+    {0xB0, "BCS", OP_BCS, ADDR_REL, 2},
+    {0xB1, "LDA", OP_LDA, ADDR_IZY, 5},
+    {0xB4, "LDY", OP_LDY, ADDR_ZPX, 4},
+    {0xB5, "LDA", OP_LDA, ADDR_ZPX, 4},
+    {0xB6, "LDX", OP_LDX, ADDR_ZPY, 4},
+    {0xB8, "CLV", OP_CLV, ADDR_IMP, 2},
+    {0xB9, "LDA", OP_LDA, ADDR_ABY, 4},
+    {0xBA, "TSX", OP_TSX, ADDR_IMP, 2},
+    {0xBC, "LDY", OP_LDY, ADDR_ABX, 4},
+    {0xBD, "LDA", OP_LDA, ADDR_ABX, 4},
+    {0xBE, "LDX", OP_LDX, ADDR_ABY, 4},
+    {0xC0, "CPY", OP_CPY, ADDR_IMM, 2},
+    {0xC1, "CMP", OP_CMP, ADDR_IZX, 6},
+    {0xC4, "CPY", OP_CPY, ADDR_ZP0, 3},
+    {0xC5, "CMP", OP_CMP, ADDR_ZP0, 3},
+    {0xC6, "DEC", OP_DEC, ADDR_ZP0, 5},
+    {0xC8, "INY", OP_INY, ADDR_IMP, 2},
+    {0xC9, "CMP", OP_CMP, ADDR_IMM, 2},
+    {0xCA, "DEX", OP_DEX, ADDR_IMP, 2},
+    {0xCC, "CPY", OP_CPY, ADDR_ABS, 4},
+    {0xCD, "CMP", OP_CMP, ADDR_ABS, 4},
+    {0xCE, "DEC", OP_DEC, ADDR_ABS, 6},
+    {0xD0, "BNE", OP_BNE, ADDR_REL, 2},
+    {0xD1, "CMP", OP_CMP, ADDR_IZY, 5},
+    {0xD5, "CMP", OP_CMP, ADDR_ZPX, 4},
+    {0xD6, "DEC", OP_DEC, ADDR_ZPX, 6},
+    {0xD8, "CLD", OP_CLD, ADDR_IMP, 2},
+    {0xD9, "CMP", OP_CMP, ADDR_ABY, 4},
+    {0xDD, "CMP", OP_CMP, ADDR_ABX, 4},
+    {0xDE, "DEC", OP_DEC, ADDR_ABX, 7},
+    {0xE0, "CPX", OP_CPX, ADDR_IMM, 2},
+    {0xE1, "SBC", OP_SBC, ADDR_IZX, 6},
+    {0xE4, "CPX", OP_CPX, ADDR_ZP0, 3},
+    {0xE5, "SBC", OP_SBC, ADDR_ZP0, 3},
+    {0xE6, "INC", OP_INC, ADDR_ZP0, 5},
+    {0xE8, "INX", OP_INX, ADDR_IMP, 2},
+    {0xE9, "SBC", OP_SBC, ADDR_IMM, 2},
+    {0xEA, "NOP", OP_NOP, ADDR_IMP, 2},
+    {0xEC, "CPX", OP_CPX, ADDR_ABS, 4},
+    {0xED, "SBC", OP_SBC, ADDR_ABS, 4},
+    {0xEE, "INC", OP_INC, ADDR_ABS, 6},
+    {0xF0, "BEQ", OP_BEQ, ADDR_REL, 2},
+    {0xF1, "SBC", OP_SBC, ADDR_IZY, 5},
+    {0xF5, "SBC", OP_SBC, ADDR_ZPX, 4},
+    {0xF6, "INC", OP_INC, ADDR_ZPX, 6},
+    {0xF8, "SED", OP_SED, ADDR_IMP, 2},
+    {0xF9, "SBC", OP_SBC, ADDR_ABY, 4},
+    {0xFD, "SBC", OP_SBC, ADDR_ABX, 4},
+    {0xFE, "INC", OP_INC, ADDR_ABX, 7},
+    {0x03, "SLO", OP_SLO, ADDR_IZX, 8},
+    {0x07, "SLO", OP_SLO, ADDR_ZP0, 5},
+    {0x0F, "SLO", OP_SLO, ADDR_ABS, 6},
+    {0x13, "SLO", OP_SLO, ADDR_IZY, 8},
+    {0x17, "SLO", OP_SLO, ADDR_ZPX, 6},
+    {0x1B, "SLO", OP_SLO, ADDR_ABY, 7},
+    {0x1F, "SLO", OP_SLO, ADDR_ABX, 7},
+    {0x23, "RLA", OP_RLA, ADDR_IZX, 8},
+    {0x27, "RLA", OP_RLA, ADDR_ZP0, 5},
+    {0x2F, "RLA", OP_RLA, ADDR_ABS, 6},
+    {0x33, "RLA", OP_RLA, ADDR_IZY, 8},
+    {0x37, "RLA", OP_RLA, ADDR_ZPX, 6},
+    {0x3B, "RLA", OP_RLA, ADDR_ABY, 7},
+    {0x3F, "RLA", OP_RLA, ADDR_ABX, 7},
+    {0x43, "SRE", OP_SRE, ADDR_IZX, 8},
+    {0x47, "SRE", OP_SRE, ADDR_ZP0, 5},
+    {0x4F, "SRE", OP_SRE, ADDR_ABS, 6},
+    {0x53, "SRE", OP_SRE, ADDR_IZY, 8},
+    {0x57, "SRE", OP_SRE, ADDR_ZPX, 6},
+    {0x5B, "SRE", OP_SRE, ADDR_ABY, 7},
+    {0x5F, "SRE", OP_SRE, ADDR_ABX, 7},
+    {0x63, "RRA", OP_RRA, ADDR_IZX, 8},
+    {0x67, "RRA", OP_RRA, ADDR_ZP0, 5},
+    {0x6F, "RRA", OP_RRA, ADDR_ABS, 6},
+    {0x73, "RRA", OP_RRA, ADDR_IZY, 8},
+    {0x77, "RRA", OP_RRA, ADDR_ZPX, 6},
+    {0x7B, "RRA", OP_RRA, ADDR_ABY, 7},
+    {0x7F, "RRA", OP_RRA, ADDR_ABX, 7},
+    {0x83, "SAX", OP_SAX, ADDR_IZX, 6},
+    {0x87, "SAX", OP_SAX, ADDR_ZP0, 3},
+    {0x8F, "SAX", OP_SAX, ADDR_ABS, 4},
+    {0x97, "SAX", OP_SAX, ADDR_ZPY, 4},
+    {0xA3, "LAX", OP_LAX, ADDR_IZX, 6},
+    {0xA7, "LAX", OP_LAX, ADDR_ZP0, 3},
+    {0xAF, "LAX", OP_LAX, ADDR_ABS, 4},
+    {0xB3, "LAX", OP_LAX, ADDR_IZY, 5},
+    {0xB7, "LAX", OP_LAX, ADDR_ZPY, 4},
+    {0xBF, "LAX", OP_LAX, ADDR_ABY, 4},
+    {0xC3, "DCP", OP_DCP, ADDR_IZX, 8},
+    {0xC7, "DCP", OP_DCP, ADDR_ZP0, 5},
+    {0xCF, "DCP", OP_DCP, ADDR_ABS, 6},
+    {0xD3, "DCP", OP_DCP, ADDR_IZY, 8},
+    {0xD7, "DCP", OP_DCP, ADDR_ZPX, 6},
+    {0xDB, "DCP", OP_DCP, ADDR_ABY, 7},
+    {0xDF, "DCP", OP_DCP, ADDR_ABX, 7},
+    {0xE3, "ISC", OP_ISC, ADDR_IZX, 8},
+    {0xE7, "ISC", OP_ISC, ADDR_ZP0, 5},
+    {0xEF, "ISC", OP_ISC, ADDR_ABS, 6},
+    {0xF3, "ISC", OP_ISC, ADDR_IZY, 8},
+    {0xF7, "ISC", OP_ISC, ADDR_ZPX, 6},
+    {0xFB, "ISC", OP_ISC, ADDR_ABY, 7},
+    {0xFF, "ISC", OP_ISC, ADDR_ABX, 7},
+    {0x0B, "ANC", OP_ANC, ADDR_IMM, 2},
+    {0x2B, "ANC", OP_ANC, ADDR_IMM, 2},
+    {0x4B, "ASR", OP_ASR, ADDR_IMM, 2},
+    {0x6B, "ARR", OP_ARR, ADDR_IMM, 2},
+    {0x8B, "ANE", OP_ANE, ADDR_IMM, 2},
+    {0xAB, "LXA", OP_LXA, ADDR_IMM, 2},
+    {0xCB, "AXS", OP_AXS, ADDR_IMM, 2},
+    {0x9F, "SHA", OP_SHA, ADDR_ABY, 5},
+    {0x93, "SHA", OP_SHA, ADDR_IZY, 6},
+    {0x9E, "SHX", OP_SHX, ADDR_ABY, 5},
+    {0x9C, "SHY", OP_SHY, ADDR_ABX, 5},
+    {0x9B, "SHS", OP_SHS, ADDR_ABY, 5},
+    {0xBB, "LAE", OP_LAE, ADDR_ABY, 4},
+    {0x1A, "NOP", OP_NOP, ADDR_IMP, 2},
+    {0x3A, "NOP", OP_NOP, ADDR_IMP, 2},
+    {0x5A, "NOP", OP_NOP, ADDR_IMP, 2},
+    {0x7A, "NOP", OP_NOP, ADDR_IMP, 2},
+    {0xDA, "NOP", OP_NOP, ADDR_IMP, 2},
+    {0xFA, "NOP", OP_NOP, ADDR_IMP, 2},
+    {0x80, "NOP", OP_NOPR, ADDR_IMM, 2},
+    {0x82, "NOP", OP_NOPR, ADDR_IMM, 2},
+    {0x89, "NOP", OP_NOPR, ADDR_IMM, 2},
+    {0xC2, "NOP", OP_NOPR, ADDR_IMM, 2},
+    {0xE2, "NOP", OP_NOPR, ADDR_IMM, 2},
+    {0x04, "NOP", OP_NOPR, ADDR_ZP0, 3},
+    {0x44, "NOP", OP_NOPR, ADDR_ZP0, 3},
+    {0x64, "NOP", OP_NOPR, ADDR_ZP0, 3},
+    {0x14, "NOP", OP_NOPR, ADDR_ZPX, 4},
+    {0x34, "NOP", OP_NOPR, ADDR_ZPX, 4},
+    {0x54, "NOP", OP_NOPR, ADDR_ZPX, 4},
+    {0x74, "NOP", OP_NOPR, ADDR_ZPX, 4},
+    {0xD4, "NOP", OP_NOPR, ADDR_ZPX, 4},
+    {0xF4, "NOP", OP_NOPR, ADDR_ZPX, 4},
+    {0x0C, "NOP", OP_NOPR, ADDR_ABS, 4},
+    {0x1C, "NOP", OP_NOPR, ADDR_ABX, 4},
+    {0x3C, "NOP", OP_NOPR, ADDR_ABX, 4},
+    {0x5C, "NOP", OP_NOPR, ADDR_ABX, 4},
+    {0x7C, "NOP", OP_NOPR, ADDR_ABX, 4},
+    {0xDC, "NOP", OP_NOPR, ADDR_ABX, 4},
+    {0xFC, "NOP", OP_NOPR, ADDR_ABX, 4},
+};
+
+static constexpr AccessKind cpu_access_for(CpuOperation operation) {
+    switch (operation) {
+        case OP_STA: case OP_STX: case OP_STY: case OP_SAX:
+        case OP_SHA: case OP_SHX: case OP_SHY: case OP_SHS:
+            return ACCESS_WRITE;
+        case OP_ASL: case OP_LSR: case OP_ROL: case OP_ROR:
+        case OP_INC: case OP_DEC: case OP_SLO: case OP_RLA:
+        case OP_SRE: case OP_RRA: case OP_DCP: case OP_ISC:
+            return ACCESS_READ_MODIFY_WRITE;
+        default:
+            return ACCESS_READ;
+    }
+}
+
+struct OpcodeTable {
+    OpcodeInfo entries[256];
+};
 
-static void cpu_build_table(CPU *cpu) {
+static constexpr OpcodeTable cpu_build_opcode_table() {
+    OpcodeTable table = {};
     for (int i = 0; i < 256; i++) {
-        cpu->instructions[i].name = "NOP";
-        cpu->instructions[i].operate = cpu_NOP;
-        cpu->instructions[i].addrMode = cpu_IMP;
-        cpu->instructions[i].mode = ADDR_IMP;
-        cpu->instructions[i].access = ACCESS_IMPLIED;
-        cpu->instructions[i].cycles = 2;
-    }
-
-    cpu_set_instruction(cpu, 0x00, "BRK", cpu_BRK, cpu_IMM, ADDR_IMM, 7);
-    cpu_set_instruction(cpu, 0x01, "ORA", cpu_ORA, cpu_IZX, ADDR_IZX, 6);
-    cpu_set_instruction(cpu, 0x05, "ORA", cpu_ORA, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0x06, "ASL", cpu_ASL, cpu_ZP0, ADDR_ZP0, 5);
-    cpu_set_instruction(cpu, 0x08, "PHP", cpu_PHP, cpu_IMP, ADDR_IMP, 3);
-    cpu_set_instruction(cpu, 0x09, "ORA", cpu_ORA, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0x0A, "ASL", cpu_ASL, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x0D, "ORA", cpu_ORA, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0x0E, "ASL", cpu_ASL, cpu_ABS, ADDR_ABS, 6);
-    cpu_set_instruction(cpu, 0x10, "BPL", cpu_BPL, cpu_REL, ADDR_REL, 2);
-    cpu_set_instruction(cpu, 0x11, "ORA", cpu_ORA, cpu_IZY, ADDR_IZY, 5);
-    cpu_set_instruction(cpu, 0x15, "ORA", cpu_ORA, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0x16, "ASL", cpu_ASL, cpu_ZPX, ADDR_ZPX, 6);
-    cpu_set_instruction(cpu, 0x18, "CLC", cpu_CLC, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x19, "ORA", cpu_ORA, cpu_ABY, ADDR_ABY, 4);
-    cpu_set_instruction(cpu, 0x1D, "ORA", cpu_ORA, cpu_ABX, ADDR_ABX, 4);
-    cpu_set_instruction(cpu, 0x1E, "ASL", cpu_ASL, cpu_ABX, ADDR_ABX, 7);
-    cpu_set_instruction(cpu, 0x20, "JSR", cpu_JSR, cpu_ABS, ADDR_ABS, 6);
-    cpu_set_instruction(cpu, 0x21, "AND", cpu_AND, cpu_IZX, ADDR_IZX, 6);
-    cpu_set_instruction(cpu, 0x24, "BIT", cpu_BIT, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0x25, "AND", cpu_AND, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0x26, "ROL", cpu_ROL, cpu_ZP0, ADDR_ZP0, 5);
-    cpu_set_instruction(cpu, 0x28, "PLP", cpu_PLP, cpu_IMP, ADDR_IMP, 4);
-    cpu_set_instruction(cpu, 0x29, "AND", cpu_AND, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0x2A, "ROL", cpu_ROL, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x2C, "BIT", cpu_BIT, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0x2D, "AND", cpu_AND, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0x2E, "ROL", cpu_ROL, cpu_ABS, ADDR_ABS, 6);
-    cpu_set_instruction(cpu, 0x30, "BMI", cpu_BMI, cpu_REL, ADDR_REL, 2);
-    cpu_set_instruction(cpu, 0x31, "AND", cpu_AND, cpu_IZY, ADDR_IZY, 5);
-    cpu_set_instruction(cpu, 0x35, "AND", cpu_AND, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0x36, "ROL", cpu_ROL, cpu_ZPX, ADDR_ZPX, 6);
-    cpu_set_instruction(cpu, 0x38, "SEC", cpu_SEC, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x39, "AND", cpu_AND, cpu_ABY, ADDR_ABY, 4);
-    cpu_set_instruction(cpu, 0x3D, "AND", cpu_AND, cpu_ABX, ADDR_ABX, 4);
-    cpu_set_instruction(cpu, 0x3E, "ROL", cpu_ROL, cpu_ABX, ADDR_ABX, 7);
-    cpu_set_instruction(cpu, 0x40, "RTI", cpu_RTI, cpu_IMP, ADDR_IMP, 6);
-    cpu_set_instruction(cpu, 0x41, "EOR", cpu_EOR, cpu_IZX, ADDR_IZX, 6);
-    cpu_set_instruction(cpu, 0x45, "EOR", cpu_EOR, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0x46, "LSR", cpu_LSR, cpu_ZP0, ADDR_ZP0, 5);
-    cpu_set_instruction(cpu, 0x48, "PHA", cpu_PHA, cpu_IMP, ADDR_IMP, 3);
-    cpu_set_instruction(cpu, 0x49, "EOR", cpu_EOR, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0x4A, "LSR", cpu_LSR, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x4C, "JMP", cpu_JMP, cpu_ABS, ADDR_ABS, 3);
-    cpu_set_instruction(cpu, 0x4D, "EOR", cpu_EOR, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0x4E, "LSR", cpu_LSR, cpu_ABS, ADDR_ABS, 6);
-    cpu_set_instruction(cpu, 0x50, "BVC", cpu_BVC, cpu_REL, ADDR_REL, 2);
-    cpu_set_instruction(cpu, 0x51, "EOR", cpu_EOR, cpu_IZY, ADDR_IZY, 5);
-    cpu_set_instruction(cpu, 0x55, "EOR", cpu_EOR, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0x56, "LSR", cpu_LSR, cpu_ZPX, ADDR_ZPX, 6);
-    cpu_set_instruction(cpu, 0x58, "CLI", cpu_CLI, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x59, "EOR", cpu_EOR, cpu_ABY, ADDR_ABY, 4);
-    cpu_set_instruction(cpu, 0x5D, "EOR", cpu_EOR, cpu_ABX, ADDR_ABX, 4);
-    cpu_set_instruction(cpu, 0x5E, "LSR", cpu_LSR, cpu_ABX, ADDR_ABX, 7);
-    cpu_set_instruction(cpu, 0x60, "RTS", cpu_RTS, cpu_IMP, ADDR_IMP, 6);
-    cpu_set_instruction(cpu, 0x61, "ADC", cpu_ADC, cpu_IZX, ADDR_IZX, 6);
-    cpu_set_instruction(cpu, 0x65, "ADC", cpu_ADC, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0x66, "ROR", cpu_ROR, cpu_ZP0, ADDR_ZP0, 5);
-    cpu_set_instruction(cpu, 0x68, "PLA", cpu_PLA, cpu_IMP, ADDR_IMP, 4);
-    cpu_set_instruction(cpu, 0x69, "ADC", cpu_ADC, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0x6A, "ROR", cpu_ROR, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x6C, "JMP", cpu_JMP, cpu_IND, ADDR_IND, 5);
-    cpu_set_instruction(cpu, 0x6D, "ADC", cpu_ADC, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0x6E, "ROR", cpu_ROR, cpu_ABS, ADDR_ABS, 6);
-    cpu_set_instruction(cpu, 0x70, "BVS", cpu_BVS, cpu_REL, ADDR_REL, 2);
-    cpu_set_instruction(cpu, 0x71, "ADC", cpu_ADC, cpu_IZY, ADDR_IZY, 5);
-    cpu_set_instruction(cpu, 0x75, "ADC", cpu_ADC, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0x76, "ROR", cpu_ROR, cpu_ZPX, ADDR_ZPX, 6);
-    cpu_set_instruction(cpu, 0x78, "SEI", cpu_SEI, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x79, "ADC", cpu_ADC, cpu_ABY, ADDR_ABY, 4);
-    cpu_set_instruction(cpu, 0x7D, "ADC", cpu_ADC, cpu_ABX, ADDR_ABX, 4);
-    cpu_set_instruction(cpu, 0x7E, "ROR", cpu_ROR, cpu_ABX, ADDR_ABX, 7);
-    cpu_set_instruction(cpu, 0x81, "STA", cpu_STA, cpu_IZX, ADDR_IZX, 6);
-    cpu_set_instruction(cpu, 0x84, "STY", cpu_STY, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0x85, "STA", cpu_STA, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0x86, "STX", cpu_STX, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0x88, "DEY", cpu_DEY, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x8A, "TXA", cpu_TXA, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x8C, "STY", cpu_STY, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0x8D, "STA", cpu_STA, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0x8E, "STX", cpu_STX, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0x90, "BCC", cpu_BCC, cpu_REL, ADDR_REL, 2);
-    cpu_set_instruction(cpu, 0x91, "STA", cpu_STA, cpu_IZY, ADDR_IZY, 6);
-    cpu_set_instruction(cpu, 0x94, "STY", cpu_STY, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0x95, "STA", cpu_STA, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0x96, "STX", cpu_STX, cpu_ZPY, ADDR_ZPY, 4);
-    cpu_set_instruction(cpu, 0x98, "TYA", cpu_TYA, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x99, "STA", cpu_STA, cpu_ABY, ADDR_ABY, 5);
-    cpu_set_instruction(cpu, 0x9A, "TXS", cpu_TXS, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x9D, "STA", cpu_STA, cpu_ABX, ADDR_ABX, 5);
-    cpu_set_instruction(cpu, 0xA0, "LDY", cpu_LDY, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0xA1, "LDA", cpu_LDA, cpu_IZX, ADDR_IZX, 6);
-    cpu_set_instruction(cpu, 0xA2, "LDX", cpu_LDX, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0xA4, "LDY", cpu_LDY, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0xA5, "LDA", cpu_LDA, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0xA6, "LDX", cpu_LDX, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0xA8, "TAY", cpu_TAY, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0xA9, "LDA", cpu_LDA, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0xAA, "TAX", cpu_TAX, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0xAC, "LDY", cpu_LDY, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0xAD, "LDA", cpu_LDA, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0xAE, "LDX", cpu_LDX, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0xB0, "BCS", cpu_BCS, cpu_REL, ADDR_REL, 2);
-    cpu_set_instruction(cpu, 0xB1, "LDA", cpu_LDA, cpu_IZY, ADDR_IZY, 5);
-    cpu_set_instruction(cpu, 0xB4, "LDY", cpu_LDY, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0xB5, "LDA", cpu_LDA, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0xB6, "LDX", cpu_LDX, cpu_ZPY, ADDR_ZPY, 4);
-    cpu_set_instruction(cpu, 0xB8, "CLV", cpu_CLV, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0xB9, "LDA", cpu_LDA, cpu_ABY, ADDR_ABY, 4);
-    cpu_set_instruction(cpu, 0xBA, "TSX", cpu_TSX, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0xBC, "LDY", cpu_LDY, cpu_ABX, ADDR_ABX, 4);
-    cpu_set_instruction(cpu, 0xBD, "LDA", cpu_LDA, cpu_ABX, ADDR_ABX, 4);
-    cpu_set_instruction(cpu, 0xBE, "LDX", cpu_LDX, cpu_ABY, ADDR_ABY, 4);
-    cpu_set_instruction(cpu, 0xC0, "CPY", cpu_CPY, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0xC1, "CMP", cpu_CMP, cpu_IZX, ADDR_IZX, 6);
-    cpu_set_instruction(cpu, 0xC4, "CPY", cpu_CPY, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0xC5, "CMP", cpu_CMP, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0xC6, "DEC", cpu_DEC, cpu_ZP0, ADDR_ZP0, 5);
-    cpu_set_instruction(cpu, 0xC8, "INY", cpu_INY, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0xC9, "CMP", cpu_CMP, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0xCA, "DEX", cpu_DEX, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0xCC, "CPY", cpu_CPY, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0xCD, "CMP", cpu_CMP, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0xCE, "DEC", cpu_DEC, cpu_ABS, ADDR_ABS, 6);
-    cpu_set_instruction(cpu, 0xD0, "BNE", cpu_BNE, cpu_REL, ADDR_REL, 2);
-    cpu_set_instruction(cpu, 0xD1, "CMP", cpu_CMP, cpu_IZY, ADDR_IZY, 5);
-    cpu_set_instruction(cpu, 0xD5, "CMP", cpu_CMP, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0xD6, "DEC", cpu_DEC, cpu_ZPX, ADDR_ZPX, 6);
-    cpu_set_instruction(cpu, 0xD8, "CLD", cpu_CLD, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0xD9, "CMP", cpu_CMP, cpu_ABY, ADDR_ABY, 4);
-    cpu_set_instruction(cpu, 0xDD, "CMP", cpu_CMP, cpu_ABX, ADDR_ABX, 4);
-    cpu_set_instruction(cpu, 0xDE, "DEC", cpu_DEC, cpu_ABX, ADDR_ABX, 7);
-    cpu_set_instruction(cpu, 0xE0, "CPX", cpu_CPX, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0xE1, "SBC", cpu_SBC, cpu_IZX, ADDR_IZX, 6);
-    cpu_set_instruction(cpu, 0xE4, "CPX", cpu_CPX, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0xE5, "SBC", cpu_SBC, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0xE6, "INC", cpu_INC, cpu_ZP0, ADDR_ZP0, 5);
-    cpu_set_instruction(cpu, 0xE8, "INX", cpu_INX, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0xE9, "SBC", cpu_SBC, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0xEA, "NOP", cpu_NOP, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0xEC, "CPX", cpu_CPX, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0xED, "SBC", cpu_SBC, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0xEE, "INC", cpu_INC, cpu_ABS, ADDR_ABS, 6);
-    cpu_set_instruction(cpu, 0xF0, "BEQ", cpu_BEQ, cpu_REL, ADDR_REL, 2);
-    cpu_set_instruction(cpu, 0xF1, "SBC", cpu_SBC, cpu_IZY, ADDR_IZY, 5);
-    cpu_set_instruction(cpu, 0xF5, "SBC", cpu_SBC, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0xF6, "INC", cpu_INC, cpu_ZPX, ADDR_ZPX, 6);
-    cpu_set_instruction(cpu, 0xF8, "SED", cpu_SED, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0xF9, "SBC", cpu_SBC, cpu_ABY, ADDR_ABY, 4);
-    cpu_set_instruction(cpu, 0xFD, "SBC", cpu_SBC, cpu_ABX, ADDR_ABX, 4);
-    cpu_set_instruction(cpu, 0xFE, "INC", cpu_INC, cpu_ABX, ADDR_ABX, 7);
-    cpu_set_instruction(cpu, 0x03, "SLO", cpu_SLO, cpu_IZX, ADDR_IZX, 8);
-    cpu_set_instruction(cpu, 0x07, "SLO", cpu_SLO, cpu_ZP0, ADDR_ZP0, 5);
-    cpu_set_instruction(cpu, 0x0F, "SLO", cpu_SLO, cpu_ABS, ADDR_ABS, 6);
-    cpu_set_instruction(cpu, 0x13, "SLO", cpu_SLO, cpu_IZY, ADDR_IZY, 8);
-    cpu_set_instruction(cpu, 0x17, "SLO", cpu_SLO, cpu_ZPX, ADDR_ZPX, 6);
-    cpu_set_instruction(cpu, 0x1B, "SLO", cpu_SLO, cpu_ABY, ADDR_ABY, 7);
-    cpu_set_instruction(cpu, 0x1F, "SLO", cpu_SLO, cpu_ABX, ADDR_ABX, 7);
-    cpu_set_instruction(cpu, 0x23, "RLA", cpu_RLA, cpu_IZX, ADDR_IZX, 8);
-    cpu_set_instruction(cpu, 0x27, "RLA", cpu_RLA, cpu_ZP0, ADDR_ZP0, 5);
-    cpu_set_instruction(cpu, 0x2F, "RLA", cpu_RLA, cpu_ABS, ADDR_ABS, 6);
-    cpu_set_instruction(cpu, 0x33, "RLA", cpu_RLA, cpu_IZY, ADDR_IZY, 8);
-    cpu_set_instruction(cpu, 0x37, "RLA", cpu_RLA, cpu_ZPX, ADDR_ZPX, 6);
-    cpu_set_instruction(cpu, 0x3B, "RLA", cpu_RLA, cpu_ABY, ADDR_ABY, 7);
-    cpu_set_instruction(cpu, 0x3F, "RLA", cpu_RLA, cpu_ABX, ADDR_ABX, 7);
-    cpu_set_instruction(cpu, 0x43, "SRE", cpu_SRE, cpu_IZX, ADDR_IZX, 8);
-    cpu_set_instruction(cpu, 0x47, "SRE", cpu_SRE, cpu_ZP0, ADDR_ZP0, 5);
-    cpu_set_instruction(cpu, 0x4F, "SRE", cpu_SRE, cpu_ABS, ADDR_ABS, 6);
-    cpu_set_instruction(cpu, 0x53, "SRE", cpu_SRE, cpu_IZY, ADDR_IZY, 8);
-    cpu_set_instruction(cpu, 0x57, "SRE", cpu_SRE, cpu_ZPX, ADDR_ZPX, 6);
-    cpu_set_instruction(cpu, 0x5B, "SRE", cpu_SRE, cpu_ABY, ADDR_ABY, 7);
-    cpu_set_instruction(cpu, 0x5F, "SRE", cpu_SRE, cpu_ABX, ADDR_ABX, 7);
-    cpu_set_instruction(cpu, 0x63, "RRA", cpu_RRA, cpu_IZX, ADDR_IZX, 8);
-    cpu_set_instruction(cpu, 0x67, "RRA", cpu_RRA, cpu_ZP0, ADDR_ZP0, 5);
-    cpu_set_instruction(cpu, 0x6F, "RRA", cpu_RRA, cpu_ABS, ADDR_ABS, 6);
-    cpu_set_instruction(cpu, 0x73, "RRA", cpu_RRA, cpu_IZY, ADDR_IZY, 8);
-    cpu_set_instruction(cpu, 0x77, "RRA", cpu_RRA, cpu_ZPX, ADDR_ZPX, 6);
-    cpu_set_instruction(cpu, 0x7B, "RRA", cpu_RRA, cpu_ABY, ADDR_ABY, 7);
-    cpu_set_instruction(cpu, 0x7F, "RRA", cpu_RRA, cpu_ABX, ADDR_ABX, 7);
-    cpu_set_instruction(cpu, 0x83, "SAX", cpu_SAX, cpu_IZX, ADDR_IZX, 6);
-    cpu_set_instruction(cpu, 0x87, "SAX", cpu_SAX, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0x8F, "SAX", cpu_SAX, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0x97, "SAX", cpu_SAX, cpu_ZPY, ADDR_ZPY, 4);
-    cpu_set_instruction(cpu, 0xA3, "LAX", cpu_LAX, cpu_IZX, ADDR_IZX, 6);
-    cpu_set_instruction(cpu, 0xA7, "LAX", cpu_LAX, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0xAF, "LAX", cpu_LAX, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0xB3, "LAX", cpu_LAX, cpu_IZY, ADDR_IZY, 5);
-    cpu_set_instruction(cpu, 0xB7, "LAX", cpu_LAX, cpu_ZPY, ADDR_ZPY, 4);
-    cpu_set_instruction(cpu, 0xBF, "LAX", cpu_LAX, cpu_ABY, ADDR_ABY, 4);
-    cpu_set_instruction(cpu, 0xC3, "DCP", cpu_DCP, cpu_IZX, ADDR_IZX, 8);
-    cpu_set_instruction(cpu, 0xC7, "DCP", cpu_DCP, cpu_ZP0, ADDR_ZP0, 5);
-    cpu_set_instruction(cpu, 0xCF, "DCP", cpu_DCP, cpu_ABS, ADDR_ABS, 6);
-    cpu_set_instruction(cpu, 0xD3, "DCP", cpu_DCP, cpu_IZY, ADDR_IZY, 8);
-    cpu_set_instruction(cpu, 0xD7, "DCP", cpu_DCP, cpu_ZPX, ADDR_ZPX, 6);
-    cpu_set_instruction(cpu, 0xDB, "DCP", cpu_DCP, cpu_ABY, ADDR_ABY, 7);
-    cpu_set_instruction(cpu, 0xDF, "DCP", cpu_DCP, cpu_ABX, ADDR_ABX, 7);
-    cpu_set_instruction(cpu, 0xE3, "ISC", cpu_ISC, cpu_IZX, ADDR_IZX, 8);
-    cpu_set_instruction(cpu, 0xE7, "ISC", cpu_ISC, cpu_ZP0, ADDR_ZP0, 5);
-    cpu_set_instruction(cpu, 0xEF, "ISC", cpu_ISC, cpu_ABS, ADDR_ABS, 6);
-    cpu_set_instruction(cpu, 0xF3, "ISC", cpu_ISC, cpu_IZY, ADDR_IZY, 8);
-    cpu_set_instruction(cpu, 0xF7, "ISC", cpu_ISC, cpu_ZPX, ADDR_ZPX, 6);
-    cpu_set_instruction(cpu, 0xFB, "ISC", cpu_ISC, cpu_ABY, ADDR_ABY, 7);
-    cpu_set_instruction(cpu, 0xFF, "ISC", cpu_ISC, cpu_ABX, ADDR_ABX, 7);
-    cpu_set_instruction(cpu, 0x0B, "ANC", cpu_ANC, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0x2B, "ANC", cpu_ANC, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0x4B, "ASR", cpu_ASR, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0x6B, "ARR", cpu_ARR, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0x8B, "ANE", cpu_ANE, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0xAB, "LXA", cpu_LXA, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0xCB, "AXS", cpu_AXS, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0x9F, "SHA", cpu_SHA, cpu_ABY, ADDR_ABY, 5);
-    cpu_set_instruction(cpu, 0x93, "SHA", cpu_SHA, cpu_IZY, ADDR_IZY, 6);
-    cpu_set_instruction(cpu, 0x9E, "SHX", cpu_SHX, cpu_ABY, ADDR_ABY, 5);
-    cpu_set_instruction(cpu, 0x9C, "SHY", cpu_SHY, cpu_ABX, ADDR_ABX, 5);
-    cpu_set_instruction(cpu, 0x9B, "SHS", cpu_SHS, cpu_ABY, ADDR_ABY, 5);
-    cpu_set_instruction(cpu, 0xBB, "LAE", cpu_LAE, cpu_ABY, ADDR_ABY, 4);
-    cpu_set_instruction(cpu, 0x1A, "NOP", cpu_NOP, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x3A, "NOP", cpu_NOP, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x5A, "NOP", cpu_NOP, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x7A, "NOP", cpu_NOP, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0xDA, "NOP", cpu_NOP, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0xFA, "NOP", cpu_NOP, cpu_IMP, ADDR_IMP, 2);
-    cpu_set_instruction(cpu, 0x80, "NOP", cpu_NOPR, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0x82, "NOP", cpu_NOPR, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0x89, "NOP", cpu_NOPR, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0xC2, "NOP", cpu_NOPR, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0xE2, "NOP", cpu_NOPR, cpu_IMM, ADDR_IMM, 2);
-    cpu_set_instruction(cpu, 0x04, "NOP", cpu_NOPR, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0x44, "NOP", cpu_NOPR, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0x64, "NOP", cpu_NOPR, cpu_ZP0, ADDR_ZP0, 3);
-    cpu_set_instruction(cpu, 0x14, "NOP", cpu_NOPR, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0x34, "NOP", cpu_NOPR, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0x54, "NOP", cpu_NOPR, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0x74, "NOP", cpu_NOPR, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0xD4, "NOP", cpu_NOPR, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0xF4, "NOP", cpu_NOPR, cpu_ZPX, ADDR_ZPX, 4);
-    cpu_set_instruction(cpu, 0x0C, "NOP", cpu_NOPR, cpu_ABS, ADDR_ABS, 4);
-    cpu_set_instruction(cpu, 0x1C, "NOP", cpu_NOPR, cpu_ABX, ADDR_ABX, 4);
-    cpu_set_instruction(cpu, 0x3C, "NOP", cpu_NOPR, cpu_ABX, ADDR_ABX, 4);
-    cpu_set_instruction(cpu, 0x5C, "NOP", cpu_NOPR, cpu_ABX, ADDR_ABX, 4);
-    cpu_set_instruction(cpu, 0x7C, "NOP", cpu_NOPR, cpu_ABX, ADDR_ABX, 4);
-    cpu_set_instruction(cpu, 0xDC, "NOP", cpu_NOPR, cpu_ABX, ADDR_ABX, 4);
-    cpu_set_instruction(cpu, 0xFC, "NOP", cpu_NOPR, cpu_ABX, ADDR_ABX, 4);
-}
-
-
-
-void CPU::init() {
-    cpu_build_table(this);
+        table.entries[i] = {"NOP", OP_NOP, ADDR_IMP, ACCESS_IMPLIED, 2};
+    }
+    for (const OpcodeDef &def : cpu_opcode_defs) {
+        table.entries[def.opcode] = {def.name, def.operation, def.mode, cpu_access_for(def.operation), def.cycles};
+    }
+    return table;
+}
+
+static constexpr OpcodeTable cpu_opcode_table = cpu_build_opcode_table();
+
+template <uint8_t Opcode>
+static inline uint8_t cpu_address(CPU *cpu) {
+    constexpr OpcodeInfo info = cpu_opcode_table.entries[Opcode];
+    constexpr bool highByteBug = cpu_uses_high_byte_bug_for_store(Opcode);
+    switch (info.mode) {
+        case ADDR_IMP: return cpu_IMP(cpu);
+        case ADDR_IMM: return cpu_IMM(cpu);
+        case ADDR_ZP0: return cpu_ZP0(cpu);
+        case ADDR_ZPX: return cpu_ZPX(cpu);
+        case ADDR_ZPY: return cpu_ZPY(cpu);
+        case ADDR_ABS: return cpu_ABS(cpu);
+        case ADDR_ABX: return cpu_ABX<info.access, highByteBug>(cpu);
+        case ADDR_ABY: return cpu_ABY<info.access, highByteBug>(cpu);
+        case ADDR_IND: return cpu_IND(cpu);
+        case ADDR_IZX: return cpu_IZX(cpu);
+        case ADDR_IZY: return cpu_IZY<info.access, highByteBug>(cpu);
+        case ADDR_REL: return cpu_REL(cpu);
+    }
+    return 0;
+}
+
+template <uint8_t Opcode>
+static inline uint8_t cpu_operate(CPU *cpu) {
+    constexpr OpcodeInfo info = cpu_opcode_table.entries[Opcode];
+    switch (info.operation) {
+        case OP_ADC: return cpu_ADC<info.mode>(cpu);
+        case OP_ANC: return cpu_ANC<info.mode>(cpu);
+        case OP_AND: return cpu_AND<info.mode>(cpu);
+        case OP_ANE: return cpu_ANE<info.mode>(cpu);
+        case OP_ARR: return cpu_ARR<info.mode>(cpu);
+        case OP_ASL: return cpu_ASL<info.mode>(cpu);
+        case OP_ASR: return cpu_ASR<info.mode>(cpu);
+        case OP_AXS: return cpu_AXS<info.mode>(cpu);
+        case OP_BCC: return cpu_BCC<info.mode>(cpu);
+        case OP_BCS: return cpu_BCS<info.mode>(cpu);
+        case OP_BEQ: return cpu_BEQ<info.mode>(cpu);
+        case OP_BIT: return cpu_BIT<info.mode>(cpu);
+        case OP_BMI: return cpu_BMI<info.mode>(cpu);
+        case OP_BNE: return cpu_BNE<info.mode>(cpu);
+        case OP_BPL: return cpu_BPL<info.mode>(cpu);
+        case OP_BRK: return cpu_BRK<info.mode>(cpu);
+        case OP_BVC: return cpu_BVC<info.mode>(cpu);
+        case OP_BVS: return cpu_BVS<info.mode>(cpu);
+        case OP_CLC: return cpu_CLC<info.mode>(cpu);
+        case OP_CLD: return cpu_CLD<info.mode>(cpu);
+        case OP_CLI: return cpu_CLI<info.mode>(cpu);
+        case OP_CLV: return cpu_CLV<info.mode>(cpu);
+        case OP_CMP: return cpu_CMP<info.mode>(cpu);
+        case OP_CPX: return cpu_CPX<info.mode>(cpu);
+        case OP_CPY: return cpu_CPY<info.mode>(cpu);
+        case OP_DCP: return cpu_DCP<info.mode>(cpu);
+        case OP_DEC: return cpu_DEC<info.mode>(cpu);
+        case OP_DEX: return cpu_DEX<info.mode>(cpu);
+        case OP_DEY: return cpu_DEY<info.mode>(cpu);
+        case OP_EOR: return cpu_EOR<info.mode>(cpu);
+        case OP_INC: return cpu_INC<info.mode>(cpu);
+        case OP_INX: return cpu_INX<info.mode>(cpu);
+        case OP_INY: return cpu_INY<info.mode>(cpu);
+        case OP_ISC: return cpu_ISC<info.mode>(cpu);
+        case OP_JMP: return cpu_JMP<info.mode>(cpu);
+        case OP_JSR: return cpu_JSR<info.mode>(cpu);
+        case OP_LAE: return cpu_LAE<info.mode>(cpu);
+        case OP_LAX: return cpu_LAX<info.mode>(cpu);
+        case OP_LDA: return cpu_LDA<info.mode>(cpu);
+        case OP_LDX: return cpu_LDX<info.mode>(cpu);
+        case OP_LDY: return cpu_LDY<info.mode>(cpu);
+        case OP_LSR: return cpu_LSR<info.mode>(cpu);
+        case OP_LXA: return cpu_LXA<info.mode>(cpu);
+        case OP_NOP: return cpu_NOP<info.mode>(cpu);
+        case OP_NOPR: return cpu_NOPR<info.mode>(cpu);
+        case OP_ORA: return cpu_ORA<info.mode>(cpu);
+        case OP_PHA: return cpu_PHA<info.mode>(cpu);
+        case OP_PHP: return cpu_PHP<info.mode>(cpu);
+        case OP_PLA: return cpu_PLA<info.mode>(cpu);
+        case OP_PLP: return cpu_PLP<info.mode>(cpu);
+        case OP_RLA: return cpu_RLA<info.mode>(cpu);
+        case OP_ROL: return cpu_ROL<info.mode>(cpu);
+        case OP_ROR: return cpu_ROR<info.mode>(cpu);
+        case OP_RRA: return cpu_RRA<info.mode>(cpu);
+        case OP_RTI: return cpu_RTI<info.mode>(cpu);
+        case OP_RTS: return cpu_RTS<info.mode>(cpu);
+        case OP_SAX: return cpu_SAX<info.mode>(cpu);
+        case OP_SBC: return cpu_SBC<info.mode>(cpu);
+        case OP_SEC: return cpu_SEC<info.mode>(cpu);
+        case OP_SED: return cpu_SED<info.mode>(cpu);
+        case OP_SEI: return cpu_SEI<info.mode>(cpu);
+        case OP_SHA: return cpu_SHA<info.mode>(cpu);
+        case OP_SHS: return cpu_SHS<info.mode>(cpu);
+        case OP_SHX: return cpu_SHX<info.mode>(cpu);
+        case OP_SHY: return cpu_SHY<info.mode>(cpu);
+        case OP_SLO: return cpu_SLO<info.mode>(cpu);
+        case OP_SRE: return cpu_SRE<info.mode>(cpu);
+        case OP_STA: return cpu_STA<info.mode>(cpu);
+        case OP_STX: return cpu_STX<info.mode>(cpu);
+        case OP_STY: return cpu_STY<info.mode>(cpu);
+        case OP_TAX: return cpu_TAX<info.mode>(cpu);
+        case OP_TAY: return cpu_TAY<info.mode>(cpu);
+        case OP_TSX: return cpu_TSX<info.mode>(cpu);
+        case OP_TXA: return cpu_TXA<info.mode>(cpu);
+        case OP_TXS: return cpu_TXS<info.mode>(cpu);
+        case OP_TYA: return cpu_TYA<info.mode>(cpu);
+    }
+    return 0;
 }
 
+// Operations an idle loop may contain: reads and register-only work.
+// Read-modify-write opcodes qualify only in their accumulator forms.
+static bool cpu_idle_operation(const OpcodeInfo &info) {
+    if (info.access != ACCESS_READ && info.mode != ADDR_IMP) {
+        return false;
+    }
+    switch (info.operation) {
+        case OP_ADC: case OP_AND: case OP_BIT: case OP_CMP: case OP_CPX:
+        case OP_CPY: case OP_EOR: case OP_LDA: case OP_LDX: case OP_LDY:
+        case OP_ORA: case OP_SBC: case OP_NOP: case OP_NOPR:
+        case OP_ASL: case OP_LSR: case OP_ROL: case OP_ROR:
+        case OP_CLC: case OP_CLD: case OP_CLV: case OP_SEC: case OP_SED:
+        case OP_DEX: case OP_DEY: case OP_INX: case OP_INY:
+        case OP_TAX: case OP_TAY: case OP_TSX: case OP_TXA: case OP_TYA:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// PPUSTATUS is the one register an idle loop may poll; its value only
+// changes on PPU events, which the caller has to bound the skip by.
+static bool cpu_idle_operand(const Bus *bus, uint16_t addr, bool *readsStatus) {
+    if (addr >= 0x2000 && addr <= 0x3FFF && (addr & 0x0007) == 0x0002) {
+        *readsStatus = true;
+        return true;
+    }
+    uint8_t value;
+    return bus->peek(addr, &value);
+}
+
+// Each opcode gets its own handler with the addressing mode and operation
+// resolved at compile time. A page-crossing read costs a cycle only for
+// operations that can take it; a taken branch adds its own one or two.
+template <uint8_t Opcode>
+static inline uint8_t cpu_execute(CPU *cpu) {
+    constexpr OpcodeInfo info = cpu_opcode_table.entries[Opcode];
+    uint8_t additional1 = cpu_address<Opcode>(cpu);
+    uint8_t additional2 = cpu_operate<Opcode>(cpu);
+    if constexpr (info.mode == ADDR_REL) {
+        return (uint8_t)(info.cycles + additional2);
+    }
+    return (uint8_t)(info.cycles + (additional1 & additional2));
+}
+
+#define CPU_CASE(op) case op: cycles = cpu_execute<op>(this); break;
+#define CPU_CASE4(op) CPU_CASE(op) CPU_CASE(op + 1) CPU_CASE(op + 2) CPU_CASE(op + 3)
+#define CPU_CASE16(op) CPU_CASE4(op) CPU_CASE4(op + 4) CPU_CASE4(op + 8) CPU_CASE4(op + 12)
+
 void CPU::reset() {
     a = 0;
     x = 0;
@@ -969,8 +1281,8 @@ void CPU::irq() {
     if (getFlag(CPU_FLAG_I) == 0) {
         push((uint8_t)((pc >> 8) & 0xFF));
         push((uint8_t)(pc & 0xFF));
-        setFlag(CPU_FLAG_I, true);
         cpu_push_status(this, false);
+        setFlag(CPU_FLAG_I, true);
         setFlag(CPU_FLAG_B, false);
         setFlag(CPU_FLAG_U, true);
         uint8_t lo = read(0xFFFE);
@@ -982,8 +1294,8 @@ void CPU::irq() {
 void CPU::nmi() {
     push((uint8_t)((pc >> 8) & 0xFF));
     push((uint8_t)(pc & 0xFF));
-    setFlag(CPU_FLAG_I, true);
     cpu_push_status(this, false);
+    setFlag(CPU_FLAG_I, true);
     setFlag(CPU_FLAG_B, false);
     setFlag(CPU_FLAG_U, true);
     uint8_t lo = read(0xFFFA);
@@ -992,20 +1304,25 @@ void CPU::nmi() {
 }
 
 int CPU::step() {
-    if (bus && bus->consumeStall()) {
-        cycleCounter += 1;
-        bus->tick(1);
-        return 1;
+    int stall = bus ? bus->takeStall() : 0;
+    if (stall > 0) {
+        cycleCounter += stall;
+        bus->tick(stall);
+        return stall;
     }
 
     opcode = bus->cpuReadOpcode(pc);
     pc += 1;
 
-    Instruction *inst = &instructions[opcode];
-    uint8_t additional1 = inst->addrMode(this);
-    uint8_t additional2 = inst->operate(this);
-    uint8_t cycles = inst->cycles + (additional1 & additional2);
+    uint8_t cycles = 0;
+    switch (opcode) {
+        CPU_CASE16(0x00) CPU_CASE16(0x10) CPU_CASE16(0x20) CPU_CASE16(0x30)
+        CPU_CASE16(0x40) CPU_CASE16(0x50) CPU_CASE16(0x60) CPU_CASE16(0x70)
+        CPU_CASE16(0x80) CPU_CASE16(0x90) CPU_CASE16(0xA0) CPU_CASE16(0xB0)
+        CPU_CASE16(0xC0) CPU_CASE16(0xD0) CPU_CASE16(0xE0) CPU_CASE16(0xF0)
+    }
     cycleCounter += cycles;
+    NES_PROFILE_ADD(profile, instructions, 1);
     status |= CPU_FLAG_U;
     if (bus && bus->isIrqPending() && getFlag(CPU_FLAG_I) == 0) {
         bus->ackIrq();
@@ -1016,3 +1333,109 @@ int CPU::step() {
     }
     return cycles;
 }
+
+void CPU::saveState(StateWriter &state) const {
+    state.put(a);
+    state.put(x);
+    state.put(y);
+    state.put(sp);
+    state.put(pc);
+    state.put(status);
+    state.put(cycleCounter);
+}
+
+void CPU::loadState(StateReader &state) {
+    state.get(a);
+    state.get(x);
+    state.get(y);
+    state.get(sp);
+    state.get(pc);
+    state.get(status);
+    state.get(cycleCounter);
+}
+
+// Decodes the code between head and branch without executing it. Cycle
+// counts come from the opcode table, as cpu_execute charges them: none of
+// the modes allowed adds a cycle, and the taken branch adds one, or two
+// when it crosses a page.
+bool CPU::findIdleLoop(uint16_t head, uint16_t branch, IdleLoop *loop) const {
+    loop->head = head;
+    loop->branch = branch;
+    loop->cycles = 0;
+    loop->readsStatus = false;
+    if (!bus) {
+        return false;
+    }
+    uint16_t addr = head;
+    int cycles = 0;
+    bool readsStatus = false;
+    uint8_t op;
+    uint8_t lo;
+    uint8_t hi;
+    while (addr != branch) {
+        if (!bus->peek(addr, &op)) {
+            return false;
+        }
+        const OpcodeInfo &info = cpu_opcode_table.entries[op];
+        if (!cpu_idle_operation(info)) {
+            return false;
+        }
+        switch (info.mode) {
+            case ADDR_IMP:
+                addr += 1;
+                break;
+            case ADDR_IMM:
+                if (!bus->peek((uint16_t)(addr + 1), &lo)) {
+                    return false;
+                }
+                addr += 2;
+                break;
+            case ADDR_ZP0:
+                if (!bus->peek((uint16_t)(addr + 1), &lo)) {
+                    return false;
+                }
+                addr += 2;
+                break;
+            case ADDR_ABS:
+                if (!bus->peek((uint16_t)(addr + 1), &lo) || !bus->peek((uint16_t)(addr + 2), &hi) ||
+                    !cpu_idle_operand(bus, (uint16_t)((hi << 8) | lo), &readsStatus)) {
+                    return false;
+                }
+                addr += 3;
+                break;
+            default:
+                return false;
+        }
+        cycles += info.cycles;
+        if ((uint16_t)(branch - addr) > CPU_IDLE_LOOP_BYTES) {
+            return false;
+        }
+    }
+
+    if (!bus->peek(branch, &op) || !bus->peek((uint16_t)(branch + 1), &lo)) {
+        return false;
+    }
+    const OpcodeInfo &info = cpu_opcode_table.entries[op];
+    if (info.mode == ADDR_REL) {
+        uint16_t next = (uint16_t)(branch + 2);
+        uint16_t target = (uint16_t)(next + (int8_t)lo);
+        if (target != head || !bus->peek(next, &hi)) {
+            return false;
+        }
+        bool pageCross = (target & 0xFF00) != (next & 0xFF00);
+        if (pageCross && !bus->peek((uint16_t)((next & 0xFF00) | (target & 0x00FF)), &hi)) {
+            return false;
+        }
+        cycles += info.cycles + (pageCross ? 2 : 1);
+    } else if (info.operation == OP_JMP && info.mode == ADDR_ABS) {
+        if (!bus->peek((uint16_t)(branch + 2), &hi) || (uint16_t)((hi << 8) | lo) != head) {
+            return false;
+        }
+        cycles += info.cycles;
+    } else {
+        return false;
+    }
+    loop->cycles = cycles;
+    loop->readsStatus = readsStatus;
+    return true;
+}
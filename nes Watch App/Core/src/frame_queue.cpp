@@ -0,0 +1,112 @@
+#include "../include/frame_queue.hpp"
+
+#include <stdlib.h>
+
+static FrameBuffer *frame_queue_allocate(size_t bytes) {
+    FrameBuffer *buffer = (FrameBuffer *)calloc(1, sizeof(FrameBuffer) + bytes);
+    if (!buffer) {
+        return nullptr;
+    }
+    buffer->pixels = (uint32_t *)(buffer + 1);
+    buffer->capacity = bytes;
+    buffer->format = FRAME_FORMAT_ARGB;
+    buffer->width = NES_WIDTH;
+    buffer->height = NES_HEIGHT;
+    return buffer;
+}
+
+FrameQueue::FrameQueue() : latestIndex(-1), backIndex(0), dropped(0) {
+    for (int i = 0; i < NES_FRAME_BUFFERS; i++) {
+        buffers[i].store(frame_queue_allocate(frame_bytes(FRAME_FORMAT_ARGB, NES_WIDTH, NES_HEIGHT)));
+        holds[i].store(0);
+    }
+}
+
+FrameQueue::~FrameQueue() {
+    for (int i = 0; i < NES_FRAME_BUFFERS; i++) {
+        free(buffers[i].load());
+    }
+}
+
+// The back buffer is neither the latest frame nor, unless the host holds
+// all three, pinned; an acquire racing on it backs off without touching its
+// storage, so it can be freed here.
+FrameBuffer *FrameQueue::reserve(size_t bytes) {
+    FrameBuffer *back = buffers[backIndex].load();
+    if (back->capacity == bytes || holds[backIndex].load() != 0) {
+        return back;
+    }
+    FrameBuffer *resized = frame_queue_allocate(bytes);
+    if (!resized) {
+        return back;
+    }
+    buffers[backIndex].store(resized);
+    free(back);
+    return resized;
+}
+
+int FrameQueue::freeBuffer(int published) const {
+    for (int i = 0; i < NES_FRAME_BUFFERS; i++) {
+        if (i != published && holds[i].load() == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+FrameBuffer *FrameQueue::publish() {
+    int published = backIndex;
+    int previous = latestIndex.exchange(published);
+    int next = freeBuffer(published);
+    if (next >= 0) {
+        backIndex = next;
+        return buffers[backIndex].load();
+    }
+    // Both other buffers are pinned: keep offering the previous frame and
+    // render over the one just finished. acquire() re-checks latestIndex
+    // after pinning, so a racing pin either backs off or is seen here.
+    latestIndex.store(previous);
+    if (holds[published].load() != 0) {
+        // The host pinned the new frame first. Holding at most two, it has
+        // let go of one of the others, so offer the frame and look again.
+        latestIndex.store(published);
+        next = freeBuffer(published);
+        if (next >= 0) {
+            backIndex = next;
+            return buffers[backIndex].load();
+        }
+        // The host holds all three. Rather than wait on it, the frame it
+        // pinned last is drawn over, and may tear while shown.
+    }
+    dropped += 1;
+    return buffers[backIndex].load();
+}
+
+const FrameBuffer *FrameQueue::latest() const {
+    int index = latestIndex.load();
+    return buffers[index >= 0 ? index : backIndex].load();
+}
+
+const uint32_t *FrameQueue::acquire() {
+    for (;;) {
+        int index = latestIndex.load();
+        if (index < 0) {
+            return nullptr;
+        }
+        holds[index].fetch_add(1);
+        if (latestIndex.load() == index) {
+            return buffers[index].load()->pixels;
+        }
+        holds[index].fetch_sub(1);
+    }
+}
+
+void FrameQueue::release(const uint32_t *pixels) {
+    const FrameBuffer *frame = frame_header(pixels);
+    for (int i = 0; i < NES_FRAME_BUFFERS; i++) {
+        if (buffers[i].load() == frame) {
+            holds[i].fetch_sub(1);
+            return;
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#include "../include/input_queue.hpp"
+
+bool InputQueue::push(uint64_t frame, uint8_t button, bool pressed) {
+    uint32_t write = writeIndex.load(std::memory_order_relaxed);
+    uint32_t readPos = readIndex.load(std::memory_order_acquire);
+    if (write - readPos >= NES_INPUT_QUEUE_CAPACITY) {
+        return false;
+    }
+    ControllerEvent &event = events[write & (NES_INPUT_QUEUE_CAPACITY - 1)];
+    event.frame = frame;
+    event.button = button;
+    event.pressed = pressed;
+    writeIndex.store(write + 1, std::memory_order_release);
+    return true;
+}
+
+void InputQueue::apply(Controller &controller) {
+    uint32_t readPos = readIndex.load(std::memory_order_relaxed);
+    uint32_t write = writeIndex.load(std::memory_order_acquire);
+    while (readPos != write) {
+        const ControllerEvent &event = events[readPos & (NES_INPUT_QUEUE_CAPACITY - 1)];
+        if (event.frame > currentFrame) {
+            break;
+        }
+        controller.setButton(event.button, event.pressed);
+        readPos += 1;
+    }
+    readIndex.store(readPos, std::memory_order_release);
+}
@@ -0,0 +1,31 @@
+#include "../../include/mapper/axrom.hpp"
+
+#include "../../include/cartridge.hpp"
+
+void AxromMapper::updateBanks(Cartridge &cart) {
+    const size_t bankSize = 32 * 1024;
+    int bankCount = (int)(cart.prgSize / bankSize);
+    if (bankCount <= 0) {
+        bankCount = 1;
+    }
+    cart.mapPrg(0x8000, (size_t)((bankSelect & 0x07) % bankCount) * bankSize, bankSize);
+    cart.mapChr(0x0000, 0, 8 * 1024);
+    cart.mirroring = (bankSelect & 0x10) != 0 ? MIRROR_SINGLE_UPPER : MIRROR_SINGLE_LOWER;
+}
+
+bool AxromMapper::cpuWrite(Cartridge &cart, uint16_t addr, uint8_t data) {
+    if (addr < 0x8000) {
+        return false;
+    }
+    bankSelect = data;
+    updateBanks(cart);
+    return true;
+}
+
+void AxromMapper::saveState(StateWriter &state) const {
+    state.put(bankSelect);
+}
+
+void AxromMapper::loadState(StateReader &state) {
+    state.get(bankSelect);
+}
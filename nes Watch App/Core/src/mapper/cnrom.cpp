@@ -2,85 +2,41 @@
 
 #include "../../include/cartridge.hpp"
 
-bool CnromMapper::cpuRead(Cartridge &cart, uint16_t addr, uint8_t *out) {
-    if (addr < 0x8000) {
-        return false;
+static uint8_t cnrom_wrap_bank(const Cartridge &cart, uint8_t bank) {
+    int chrBankCount = (int)(cart.chrSize / (8 * 1024));
+    if (chrBankCount <= 0) {
+        return 0;
+    }
+    if ((chrBankCount & (chrBankCount - 1)) == 0) {
+        return (uint8_t)(bank & (uint8_t)(chrBankCount - 1));
     }
-    uint32_t mapped = 0;
+    return (uint8_t)(bank % chrBankCount);
+}
+
+void CnromMapper::updateBanks(Cartridge &cart) {
     if (cart.prgSize == 16 * 1024) {
-        mapped = (uint32_t)(addr & 0x3FFF);
+        cart.mapPrg(0x8000, 0, 16 * 1024);
+        cart.mapPrg(0xC000, 0, 16 * 1024);
     } else {
-        mapped = (uint32_t)(addr - 0x8000);
-    }
-    if (mapped >= cart.prgSize) {
-        return false;
+        cart.mapPrg(0x8000, 0, 32 * 1024);
     }
-    *out = cart.prgROM[mapped];
-    return true;
+    uint8_t bank = cnrom_wrap_bank(cart, chrBank);
+    cart.mapChr(0x0000, (size_t)bank * 8 * 1024, 8 * 1024);
 }
 
 bool CnromMapper::cpuWrite(Cartridge &cart, uint16_t addr, uint8_t data) {
     if (addr < 0x8000) {
         return false;
     }
-    int chrBankCount = (int)(cart.chrSize / (8 * 1024));
-    uint8_t bank = data;
-    if (chrBankCount > 0) {
-        if ((chrBankCount & (chrBankCount - 1)) == 0) {
-            bank = (uint8_t)(bank & (uint8_t)(chrBankCount - 1));
-        } else {
-            bank = (uint8_t)(bank % chrBankCount);
-        }
-    } else {
-        bank = 0;
-    }
-    chrBank = bank;
+    chrBank = cnrom_wrap_bank(cart, data);
+    updateBanks(cart);
     return true;
 }
 
-bool CnromMapper::ppuRead(Cartridge &cart, uint16_t addr, uint8_t *out) {
-    if (addr >= 0x2000) {
-        return false;
-    }
-    int chrBankCount = (int)(cart.chrSize / (8 * 1024));
-    if (chrBankCount <= 0) {
-        return false;
-    }
-    uint8_t bank = chrBank;
-    if ((chrBankCount & (chrBankCount - 1)) == 0) {
-        bank = (uint8_t)(bank & (uint8_t)(chrBankCount - 1));
-    } else {
-        bank = (uint8_t)(bank % chrBankCount);
-    }
-    uint32_t mapped = (uint32_t)bank * 8 * 1024 + addr;
-    if (mapped >= cart.chrSize) {
-        return false;
-    }
-    *out = cart.chrROM[mapped];
-    return true;
+void CnromMapper::saveState(StateWriter &state) const {
+    state.put(chrBank);
 }
 
-bool CnromMapper::ppuWrite(Cartridge &cart, uint16_t addr, uint8_t data) {
-    if (!cart.hasChrRam) {
-        return false;
-    }
-    if (addr >= 0x2000) {
-        return false;
-    }
-    int chrBankCount = (int)(cart.chrSize / (8 * 1024));
-    if (chrBankCount <= 0) {
-        return false;
-    }
-    uint8_t bank = chrBank;
-    if ((chrBankCount & (chrBankCount - 1)) == 0) {
-        bank = (uint8_t)(bank & (uint8_t)(chrBankCount - 1));
-    } else {
-        bank = (uint8_t)(bank % chrBankCount);
-    }
-    uint32_t mapped = (uint32_t)bank * 8 * 1024 + addr;
-    if (mapped >= cart.chrSize) {
-        return false;
-    }
-    cart.chrROM[mapped] = data;
-    return true;
+void CnromMapper::loadState(StateReader &state) {
+    state.get(chrBank);
 }
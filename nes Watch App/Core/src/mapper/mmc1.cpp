@@ -4,60 +4,48 @@
 
 void Mmc1Mapper::applyControl(Cartridge &cart, uint8_t value) {
     control = value;
-    uint8_t mirror = value & 0x03;
-    if (mirror == 3) {
-        cart.mirroring = MIRROR_HORIZONTAL;
-    } else {
-        cart.mirroring = MIRROR_VERTICAL;
-    }
+    static const Mirroring modes[4] = {
+        MIRROR_SINGLE_LOWER, MIRROR_SINGLE_UPPER, MIRROR_VERTICAL, MIRROR_HORIZONTAL
+    };
+    cart.mirroring = modes[value & 0x03];
 }
 
-bool Mmc1Mapper::cpuRead(Cartridge &cart, uint16_t addr, uint8_t *out) {
-    if (addr < 0x8000) {
-        return false;
-    }
+void Mmc1Mapper::updateBanks(Cartridge &cart) {
+    const size_t prgBankSize = 16 * 1024;
     uint8_t prgMode = (control >> 2) & 0x03;
-    int prgBankCount = (int)(cart.prgSize / (16 * 1024));
+    int prgBankCount = (int)(cart.prgSize / prgBankSize);
+    if (prgBankCount <= 0) {
+        prgBankCount = 1;
+    }
     int bank = prgBank & 0x0F;
-    uint32_t mapped = 0;
 
     switch (prgMode) {
         case 0:
         case 1: {
             int bank32 = (bank & 0x0E);
-            if (addr < 0xC000) {
-                mapped = (uint32_t)bank32 * 16 * 1024 + (addr - 0x8000);
-            } else {
-                mapped = (uint32_t)(bank32 + 1) * 16 * 1024 + (addr - 0xC000);
-            }
+            cart.mapPrg(0x8000, (size_t)bank32 * prgBankSize, prgBankSize);
+            cart.mapPrg(0xC000, (size_t)(bank32 + 1) * prgBankSize, prgBankSize);
             break;
         }
-        case 2: {
-            if (addr < 0xC000) {
-                mapped = (uint32_t)(0 * 16 * 1024 + (addr - 0x8000));
-            } else {
-                int b = bank % prgBankCount;
-                mapped = (uint32_t)b * 16 * 1024 + (addr - 0xC000);
-            }
+        case 2:
+            cart.mapPrg(0x8000, 0, prgBankSize);
+            cart.mapPrg(0xC000, (size_t)(bank % prgBankCount) * prgBankSize, prgBankSize);
             break;
-        }
         case 3:
-        default: {
-            if (addr < 0xC000) {
-                int b = bank % prgBankCount;
-                mapped = (uint32_t)b * 16 * 1024 + (addr - 0x8000);
-            } else {
-                mapped = (uint32_t)(prgBankCount - 1) * 16 * 1024 + (addr - 0xC000);
-            }
+        default:
+            cart.mapPrg(0x8000, (size_t)(bank % prgBankCount) * prgBankSize, prgBankSize);
+            cart.mapPrg(0xC000, (size_t)(prgBankCount - 1) * prgBankSize, prgBankSize);
             break;
-        }
     }
 
-    if (mapped >= cart.prgSize) {
-        return false;
+    const size_t chrBankSize = 4 * 1024;
+    uint8_t chrMode = (control >> 4) & 0x01;
+    if (chrMode == 0) {
+        cart.mapChr(0x0000, (size_t)(chrBank0 & 0x1E) * chrBankSize, 2 * chrBankSize);
+    } else {
+        cart.mapChr(0x0000, (size_t)chrBank0 * chrBankSize, chrBankSize);
+        cart.mapChr(0x1000, (size_t)chrBank1 * chrBankSize, chrBankSize);
     }
-    *out = cart.prgROM[mapped];
-    return true;
 }
 
 bool Mmc1Mapper::cpuWrite(Cartridge &cart, uint16_t addr, uint8_t data) {
@@ -68,6 +56,7 @@ bool Mmc1Mapper::cpuWrite(Cartridge &cart, uint16_t addr, uint8_t data) {
         shiftReg = 0x10;
         shiftCount = 0;
         control |= 0x0C;
+        updateBanks(cart);
         return true;
     }
 
@@ -87,55 +76,25 @@ bool Mmc1Mapper::cpuWrite(Cartridge &cart, uint16_t addr, uint8_t data) {
         }
         shiftReg = 0x10;
         shiftCount = 0;
+        updateBanks(cart);
     }
     return true;
 }
 
-bool Mmc1Mapper::ppuRead(Cartridge &cart, uint16_t addr, uint8_t *out) {
-    if (addr >= 0x2000) {
-        return false;
-    }
-    uint8_t chrMode = (control >> 4) & 0x01;
-    uint32_t mapped = 0;
-    if (chrMode == 0) {
-        uint32_t bank = (uint32_t)(chrBank0 & 0x1E);
-        mapped = bank * 4 * 1024 + addr;
-    } else {
-        if (addr < 0x1000) {
-            mapped = (uint32_t)chrBank0 * 4 * 1024 + addr;
-        } else {
-            mapped = (uint32_t)chrBank1 * 4 * 1024 + (addr - 0x1000);
-        }
-    }
-    if (mapped >= cart.chrSize) {
-        return false;
-    }
-    *out = cart.chrROM[mapped];
-    return true;
+void Mmc1Mapper::saveState(StateWriter &state) const {
+    state.put(shiftReg);
+    state.put(shiftCount);
+    state.put(control);
+    state.put(chrBank0);
+    state.put(chrBank1);
+    state.put(prgBank);
 }
 
-bool Mmc1Mapper::ppuWrite(Cartridge &cart, uint16_t addr, uint8_t data) {
-    if (!cart.hasChrRam) {
-        return false;
-    }
-    if (addr >= 0x2000) {
-        return false;
-    }
-    uint8_t chrMode = (control >> 4) & 0x01;
-    uint32_t mapped = 0;
-    if (chrMode == 0) {
-        uint32_t bank = (uint32_t)(chrBank0 & 0x1E);
-        mapped = bank * 4 * 1024 + addr;
-    } else {
-        if (addr < 0x1000) {
-            mapped = (uint32_t)chrBank0 * 4 * 1024 + addr;
-        } else {
-            mapped = (uint32_t)chrBank1 * 4 * 1024 + (addr - 0x1000);
-        }
-    }
-    if (mapped >= cart.chrSize) {
-        return false;
-    }
-    cart.chrROM[mapped] = data;
-    return true;
+void Mmc1Mapper::loadState(StateReader &state) {
+    state.get(shiftReg);
+    state.get(shiftCount);
+    state.get(control);
+    state.get(chrBank0);
+    state.get(chrBank1);
+    state.get(prgBank);
 }
@@ -0,0 +1,118 @@
+#include "../../include/mapper/mmc3.hpp"
+
+#include "../../include/cartridge.hpp"
+
+void Mmc3Mapper::updateBanks(Cartridge &cart) {
+    const size_t prgBankSize = 8 * 1024;
+    int prgBankCount = (int)(cart.prgSize / prgBankSize);
+    if (prgBankCount <= 0) {
+        prgBankCount = 1;
+    }
+    size_t secondLast = (size_t)((prgBankCount - 2 + prgBankCount) % prgBankCount) * prgBankSize;
+    size_t bank6 = (size_t)(registers[6] % prgBankCount) * prgBankSize;
+    size_t bank7 = (size_t)(registers[7] % prgBankCount) * prgBankSize;
+    bool prgSwapped = (bankSelect & 0x40) != 0;
+    cart.mapPrg(0x8000, prgSwapped ? secondLast : bank6, prgBankSize);
+    cart.mapPrg(0xA000, bank7, prgBankSize);
+    cart.mapPrg(0xC000, prgSwapped ? bank6 : secondLast, prgBankSize);
+    cart.mapPrg(0xE000, (size_t)(prgBankCount - 1) * prgBankSize, prgBankSize);
+
+    // R0/R1 select 2 KB banks and R2-R5 1 KB banks; A12 inversion swaps
+    // which half of pattern space each group covers.
+    const size_t chrBankSize = 1024;
+    int chrBankCount = (int)(cart.chrSize / chrBankSize);
+    if (chrBankCount <= 0) {
+        chrBankCount = 1;
+    }
+    uint16_t twoKbBase = (bankSelect & 0x80) != 0 ? 0x1000 : 0x0000;
+    uint16_t oneKbBase = (uint16_t)(twoKbBase ^ 0x1000);
+    for (int i = 0; i < 2; i++) {
+        size_t bank = (size_t)((registers[i] & 0xFE) % chrBankCount);
+        cart.mapChr((uint16_t)(twoKbBase + i * 0x800), bank * chrBankSize, 2 * chrBankSize);
+    }
+    for (int i = 0; i < 4; i++) {
+        size_t bank = (size_t)(registers[2 + i] % chrBankCount);
+        cart.mapChr((uint16_t)(oneKbBase + i * 0x400), bank * chrBankSize, chrBankSize);
+    }
+}
+
+bool Mmc3Mapper::cpuWrite(Cartridge &cart, uint16_t addr, uint8_t data) {
+    if (addr < 0x8000) {
+        return false;
+    }
+    bool odd = (addr & 0x01) != 0;
+    switch (addr & 0xE000) {
+        case 0x8000:
+            if (odd) {
+                registers[bankSelect & 0x07] = data;
+            } else {
+                bankSelect = data;
+            }
+            updateBanks(cart);
+            break;
+        case 0xA000:
+            // Odd writes are PRG RAM protect, which is not emulated.
+            if (!odd) {
+                cart.mirroring = (data & 0x01) != 0 ? MIRROR_HORIZONTAL : MIRROR_VERTICAL;
+            }
+            break;
+        case 0xC000:
+            if (odd) {
+                irqCounter = 0;
+                irqReload = true;
+            } else {
+                irqLatch = data;
+            }
+            break;
+        case 0xE000:
+        default:
+            irqEnabled = odd;
+            if (!odd) {
+                cart.irqLine = false;
+            }
+            break;
+    }
+    return true;
+}
+
+void Mmc3Mapper::clockScanline(Cartridge &cart) {
+    if (irqCounter == 0 || irqReload) {
+        irqCounter = irqLatch;
+        irqReload = false;
+    } else {
+        irqCounter -= 1;
+    }
+    if (irqCounter == 0 && irqEnabled) {
+        cart.irqLine = true;
+    }
+}
+
+// Clocks needed before clockScanline next raises the IRQ; a reload to a
+// zero latch fires on every clock.
+int Mmc3Mapper::scanlinesUntilIrq() const {
+    if (!irqEnabled) {
+        return -1;
+    }
+    if (irqCounter == 0 || irqReload) {
+        return irqLatch == 0 ? 1 : 1 + irqLatch;
+    }
+    return irqCounter;
+}
+
+void Mmc3Mapper::saveState(StateWriter &state) const {
+    state.put(bankSelect);
+    state.put(registers);
+    state.put(irqLatch);
+    state.put(irqCounter);
+    state.put(irqReload);
+    state.put(irqEnabled);
+}
+
+void Mmc3Mapper::loadState(StateReader &state) {
+    state.get(bankSelect);
+    state.get(registers);
+    state.get(irqLatch);
+    state.get(irqCounter);
+    state.get(irqReload);
+    state.get(irqEnabled);
+}
@@ -0,0 +1,31 @@
+#include "../../include/mapper/uxrom.hpp"
+
+#include "../../include/cartridge.hpp"
+
+void UxromMapper::updateBanks(Cartridge &cart) {
+    const size_t bankSize = 16 * 1024;
+    int bankCount = (int)(cart.prgSize / bankSize);
+    if (bankCount <= 0) {
+        bankCount = 1;
+    }
+    cart.mapPrg(0x8000, (size_t)(prgBank % bankCount) * bankSize, bankSize);
+    cart.mapPrg(0xC000, (size_t)(bankCount - 1) * bankSize, bankSize);
+    cart.mapChr(0x0000, 0, 8 * 1024);
+}
+
+bool UxromMapper::cpuWrite(Cartridge &cart, uint16_t addr, uint8_t data) {
+    if (addr < 0x8000) {
+        return false;
+    }
+    prgBank = data;
+    updateBanks(cart);
+    return true;
+}
+
+void UxromMapper::saveState(StateWriter &state) const {
+    state.put(prgBank);
+}
+
+void UxromMapper::loadState(StateReader &state) {
+    state.get(prgBank);
+}
@@ -1,5 +1,7 @@
 #include "../include/nesc.hpp"
 
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "../include/nes_internal.hpp"
@@ -8,54 +10,536 @@ static uint8_t nes_bus_read(void *context, uint16_t addr) {
     return ((Bus *)context)->cpuRead(addr);
 }
 
-NES::NES() : hasCart(false) {
+// NTSC frame rate: 3 * 1789773 Hz dots over 341 * 262 dots per frame.
+static const double nes_frame_rate = 60.0988;
+
+NES::NES()
+    : frameCount(0),
+      hasCart(false),
+      maxFrameSkip(NES_DEFAULT_FRAME_SKIP),
+      frameDebt(0.0),
+      rewindBudget(0),
+      rewindInterval(0),
+      rewindCountdown(0),
+      runAheadFrames(0),
+      runAheadState(nullptr),
+      runAheadStateSize(0),
+      hiddenFrame(false),
+      idleSkip(true),
+      idleArrival(0) {
+    forgetIdleLoop();
     apu.init();
     bus.cpu = &cpu;
     bus.ppu = &ppu;
     bus.apu = &apu;
-    cpu.init();
+    bus.input = &input;
+#if NESC_PROFILE
+    memset(&counters, 0, sizeof(counters));
+    cpu.profile = &counters;
+    bus.profile = &counters;
+    ppu.profile = &counters;
+    apu.profile = &counters;
+#endif
     cpu.bus = &bus;
     apu.setReadCallback(nes_bus_read, &bus);
+    apu.setOutput(&audioRing);
+    ppu.frameBuffer = frames.backBuffer();
 }
 
 NES::~NES() {
+    free(runAheadState);
+    cart.free();
+}
+
+bool NES::loadRom(const uint8_t *data, size_t size, CartRomStorage storage) {
+    cart.free();
+    hasCart = false;
+    if (!cart.load(data, size, storage)) {
+        cart.free();
+        return false;
+    }
+    attachCartridge();
+    return true;
+}
+
+bool NES::loadRomFile(const char *path) {
     cart.free();
+    hasCart = false;
+    if (!cart.loadFile(path)) {
+        cart.free();
+        return false;
+    }
+    attachCartridge();
+    return true;
 }
 
-bool NES::loadRom(const uint8_t *data, size_t size) {
+bool NES::loadRomImage(CartImage *image) {
     cart.free();
-    if (!cart.load(data, size)) {
+    hasCart = false;
+    if (!cart.loadImage(image)) {
         cart.free();
         return false;
     }
+    attachCartridge();
+    return true;
+}
+
+void NES::attachCartridge() {
+    memset(bus.prgRam, 0, sizeof(bus.prgRam));
+    bus.prgRamDirty = false;
     bus.cartridge = &cart;
     ppu.connectCartridge(&cart);
     hasCart = true;
+    frameCount = 0;
     reset();
-    return true;
+    if (rewindBudget > 0) {
+        configureRewind(rewindBudget, rewindInterval);
+    }
+    if (runAheadFrames > 0) {
+        configureRunAhead(runAheadFrames);
+    }
 }
 
 void NES::reset() {
     apu.reset();
     cpu.reset();
+    frameDebt = 0.0;
+    forgetIdleLoop();
+}
+
+// budget caps the cycles an idle-loop skip may add, for runCycles.
+int NES::stepInstruction(uint32_t budget) {
+    uint16_t from = cpu.pc;
+    bool stalled = bus.stallCycles > 0;
+    int cycles = cpu.step();
+    apu.step(cycles);
+    if (apu.dmcStallCycles > 0) {
+        bus.requestStall(apu.dmcStallCycles);
+        apu.dmcStallCycles = 0;
+    }
+    ppu.addCycles(cycles * 3);
+    if (ppu.eventDue()) {
+        ppu.catchUp();
+        if (ppu.nmiRequested) {
+            ppu.nmiRequested = false;
+            cpu.nmi();
+        }
+        // The event may have changed what a loop reads or raised an IRQ, so
+        // skipping waits for the next pass.
+        NES_PROFILE_ADD(cpu.profile, cpuCycles, cycles);
+        return cycles;
+    }
+    // A jump back of a few bytes is the only way into an idle loop; the test
+    // is all most instructions pay.
+    if (idleSkip && !stalled && (uint16_t)(from - cpu.pc) <= CPU_IDLE_LOOP_BYTES) {
+        uint32_t left = budget > (uint32_t)cycles ? budget - (uint32_t)cycles : 0;
+        cycles += (int)skipIdleLoop(from, left);
+    }
+    NES_PROFILE_ADD(cpu.profile, cpuCycles, cycles);
+    return cycles;
+}
+
+void NES::forgetIdleLoop() {
+    memset(&idleLoop, 0, sizeof(idleLoop));
+    idleLoop.cycles = -1;
+    memset(idleRegisters, 0, sizeof(idleRegisters));
+}
+
+// Called as the CPU lands on a loop head. The first arrival only decodes the
+// loop and notes the registers. If the next arrival comes exactly one pass
+// later with the same registers, that pass ran alone (an interrupt or DMA
+// would have added cycles) and changed nothing, so every pass until the
+// next event that could change what the loop reads is the same: those are
+// charged at once. The events are the PPU's scheduled ones (vblank, NMI,
+// mapper IRQ, frame end), $2002 flags rising for loops that poll it, and
+// DMC fetches, which would stall the CPU partway.
+uint32_t NES::skipIdleLoop(uint16_t branch, uint32_t budget) {
+    uint16_t head = cpu.pc;
+    uint32_t now = (uint32_t)cpu.cycleCounter;
+    uint8_t registers[5] = {cpu.a, cpu.x, cpu.y, cpu.sp, cpu.status};
+    bool known = idleLoop.cycles >= 0 && idleLoop.head == head && idleLoop.branch == branch;
+    bool repeated = known && idleLoop.cycles > 0 && now - idleArrival == (uint32_t)idleLoop.cycles &&
+                    memcmp(registers, idleRegisters, sizeof(registers)) == 0;
+    memcpy(idleRegisters, registers, sizeof(registers));
+    idleArrival = now;
+    if (!repeated) {
+        // Code that failed once is not decoded again until another loop
+        // comes along.
+        if (!known || idleLoop.cycles > 0) {
+            cpu.findIdleLoop(head, branch, &idleLoop);
+        }
+        return 0;
+    }
+    if (ppu.frameComplete || ppu.eventDue()) {
+        return 0;
+    }
+
+    // Reading $2002 clears its flags, so any still raised came up after the
+    // pass read them and the next pass would see them. Catching up can also
+    // clock a mapper IRQ.
+    if (idleLoop.readsStatus) {
+        ppu.catchUp();
+        if ((ppu.status & 0xE0) != 0 || (bus.isIrqPending() && cpu.getFlag(CPU_FLAG_I) == 0)) {
+            return 0;
+        }
+    }
+    uint64_t limit = ppu.eventClock;
+    if (idleLoop.readsStatus) {
+        uint64_t status = ppu.nextStatusClock();
+        limit = status < limit ? status : limit;
+    }
+    if (limit <= ppu.targetClock) {
+        return 0;
+    }
+    uint64_t quiet = (limit - ppu.targetClock - 1) / 3;
+    uint32_t dmc = apu.quietCycles();
+    quiet = dmc < quiet ? dmc : quiet;
+    quiet = budget < quiet ? budget : quiet;
+    uint32_t passes = (uint32_t)(quiet / (uint64_t)idleLoop.cycles);
+    if (passes == 0) {
+        return 0;
+    }
+
+    uint32_t skipped = passes * (uint32_t)idleLoop.cycles;
+    apu.step((int)skipped);
+    ppu.addCycles((int)(skipped * 3));
+    cpu.cycleCounter += (int)skipped;
+    bus.tick((int)skipped);
+    idleArrival = now + skipped;
+    NES_PROFILE_ADD(cpu.profile, idleCycles, skipped);
+    return skipped;
+}
+
+// Frames run ahead hold the buttons of the real frame, so queued input waits
+// for the real timeline.
+void NES::beginFrame() {
+    ppu.frameBuffer = frames.reserve(ppu.nextFrameBytes());
+    ppu.resetFrame();
+    if (hiddenFrame) {
+        return;
+    }
+    input.setFrame(frameCount);
+    input.apply(bus.controller);
+}
+
+void NES::finishFrame() {
+    frameCount += 1;
+    NES_PROFILE_ADD(cpu.profile, frames, 1);
+    apu.endFrame();
+    if (!ppu.skipRender && ppu.frameFits) {
+        ppu.frameBuffer = frames.publish();
+    }
+    if (!hiddenFrame && rewind.enabled() && --rewindCountdown <= 0) {
+        rewindCountdown = rewindInterval;
+        saveState(rewind.stage(), rewind.stateSize());
+        rewind.commit();
+    }
 }
 
 void NES::stepFrame() {
     if (!hasCart) {
         return;
     }
-    ppu.resetFrame();
+    if (runAheadFrames > 0 && runAheadState && !ppu.skipRender) {
+        runAhead();
+        return;
+    }
+    emulateFrame();
+}
+
+void NES::emulateFrame() {
+    NES_PROFILE_SCOPE(cpu.profile, frameNanos);
+    beginFrame();
     while (!ppu.frameComplete) {
-        int cycles = cpu.step();
-        if (cycles > 0) {
-            for (int i = 0; i < cycles * 3; i++) {
-                ppu.tick();
-                if (ppu.nmiRequested) {
-                    cpu.nmi();
-                }
-            }
+        stepInstruction(UINT32_MAX);
+    }
+    finishFrame();
+}
+
+// The real frame is not drawn; the last hidden one is, and is published as
+// usual before the real state comes back. Muted frames leave the blip
+// buffer's clock and level alone, so the restored APU carries on from the
+// real frame's audio without a step.
+void NES::runAhead() {
+    ppu.skipRender = true;
+    emulateFrame();
+    StateWriter saved(runAheadState, runAheadStateSize);
+    writeState(saved);
+
+    uint64_t realFrameCount = frameCount;
+    bool prgRamDirty = bus.prgRamDirty;
+    InputQueue *queue = bus.input;
+    bool muted = apu.muted;
+    hiddenFrame = true;
+    bus.input = nullptr;
+    apu.muted = true;
+    for (int i = 0; i < runAheadFrames; i++) {
+        ppu.skipRender = i + 1 < runAheadFrames;
+        emulateFrame();
+    }
+    ppu.skipRender = false;
+    apu.muted = muted;
+    bus.input = queue;
+    hiddenFrame = false;
+
+    StateReader restored(runAheadState, runAheadStateSize);
+    readState(restored);
+    frameCount = realFrameCount;
+    bus.prgRamDirty = prgRamDirty;
+}
+
+void NES::runFrames(int count, uint32_t flags) {
+    if (!hasCart) {
+        return;
+    }
+    apu.muted = (flags & NES_RUN_SKIP_AUDIO) != 0;
+    for (int i = 0; i < count; i++) {
+        ppu.skipRender = (flags & NES_RUN_SKIP_RENDER) != 0 && i + 1 < count;
+        stepFrame();
+    }
+    ppu.skipRender = false;
+    apu.muted = false;
+}
+
+// Runs whole instructions until at least `cycles` CPU cycles have elapsed,
+// finishing and starting frames as the PPU crosses them.
+uint32_t NES::runCycles(uint32_t cycles) {
+    if (!hasCart) {
+        return 0;
+    }
+    NES_PROFILE_SCOPE(cpu.profile, frameNanos);
+    if (ppu.frameComplete) {
+        beginFrame();
+    }
+    uint32_t elapsed = 0;
+    while (elapsed < cycles) {
+        elapsed += (uint32_t)stepInstruction(cycles - elapsed);
+        if (ppu.frameComplete) {
+            finishFrame();
+            beginFrame();
         }
     }
+    return elapsed;
+}
+
+// Adds the host's elapsed time to the frames owed and runs them, drawing only
+// the last. Debt is rounded, so timer jitter either side of a frame still runs
+// exactly one; anything beyond maxFrameSkip + 1 frames is dropped rather than
+// letting a slow host fall further behind.
+int NES::runElapsed(double seconds) {
+    if (!hasCart || seconds <= 0.0) {
+        return 0;
+    }
+    frameDebt += seconds * nes_frame_rate;
+    int count = (int)(frameDebt + 0.5);
+    if (count <= 0) {
+        return 0;
+    }
+    frameDebt -= count;
+    if (count > maxFrameSkip + 1) {
+        count = maxFrameSkip + 1;
+        frameDebt = 0.0;
+    }
+    runFrames(count, NES_RUN_SKIP_RENDER);
+    return count;
+}
+
+void NES::writeState(StateWriter &state) {
+    StateHeader header = {};
+    header.magic = NES_STATE_MAGIC;
+    header.version = NES_STATE_VERSION;
+    header.mapperID = cart.mapperID;
+    header.romHash = cart.identity();
+    state.put(header);
+    cpu.saveState(state);
+    bus.saveState(state);
+    ppu.saveState(state);
+    apu.saveState(state);
+    cart.saveState(state);
+}
+
+// The layout only depends on the cartridge, so the size is fixed per game.
+size_t NES::stateSize() {
+    if (!hasCart) {
+        return 0;
+    }
+    StateWriter counter(NULL, 0);
+    writeState(counter);
+    return counter.size();
+}
+
+size_t NES::saveState(uint8_t *out, size_t capacity) {
+    size_t size = stateSize();
+    if (size == 0 || !out || capacity < size) {
+        return 0;
+    }
+    StateWriter state(out, capacity);
+    writeState(state);
+    uint32_t total = (uint32_t)size;
+    memcpy(out + offsetof(StateHeader, size), &total, sizeof(total));
+    return size;
+}
+
+// Rejects states from another game, core version or layout before touching
+// anything, so a failed load leaves the running game as it was.
+bool NES::loadState(const uint8_t *data, size_t size) {
+    if (!hasCart || !data || size < sizeof(StateHeader)) {
+        return false;
+    }
+    StateHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != NES_STATE_MAGIC || header.version != NES_STATE_VERSION ||
+        header.mapperID != cart.mapperID || header.romHash != cart.identity() ||
+        header.size != size || size != stateSize()) {
+        return false;
+    }
+    StateReader state(data, size);
+    readState(state);
+    frameDebt = 0.0;
+    return !state.exhausted();
+}
+
+void NES::readState(StateReader &state) {
+    StateHeader header;
+    state.get(header);
+    cpu.loadState(state);
+    bus.loadState(state);
+    ppu.loadState(state);
+    apu.loadState(state);
+    cart.loadState(state);
+    forgetIdleLoop();
+    // The next event can include a mapper IRQ, so it waits for the mapper.
+    ppu.scheduleNextEvent();
+}
+
+// A zero budget turns rewind off. The history is sized for the loaded game
+// and rebuilt, empty, whenever another ROM is loaded.
+bool NES::configureRewind(size_t budget, int interval) {
+    rewindBudget = budget;
+    rewindInterval = interval > 0 ? interval : 1;
+    rewindCountdown = rewindInterval;
+    if (budget == 0) {
+        rewind.release();
+        return true;
+    }
+    if (!hasCart) {
+        rewind.release();
+        return false;
+    }
+    return rewind.configure(budget, stateSize());
+}
+
+bool NES::configureRunAhead(int frames) {
+    if (frames < 0 || frames > NES_MAX_RUN_AHEAD) {
+        return false;
+    }
+    runAheadFrames = frames;
+    size_t size = frames > 0 ? stateSize() : 0;
+    if (size != runAheadStateSize) {
+        free(runAheadState);
+        runAheadState = size > 0 ? (uint8_t *)malloc(size) : nullptr;
+        runAheadStateSize = runAheadState ? size : 0;
+    }
+    return frames == 0 || !hasCart || runAheadState;
+}
+
+void NES::setIdleSkip(bool enabled) {
+    idleSkip = enabled;
+    forgetIdleLoop();
+}
+
+bool NES::rewindStep() {
+    const uint8_t *state = rewind.pop();
+    if (!state || !loadState(state, rewind.stateSize())) {
+        return false;
+    }
+    rewindCountdown = rewindInterval;
+    return true;
+}
+
+size_t NES::batteryRamSize() const {
+    return hasCart && cart.hasBattery ? sizeof(bus.prgRam) : 0;
+}
+
+bool NES::loadBatteryRam(const uint8_t *data, size_t size) {
+    size_t expected = batteryRamSize();
+    if (expected == 0 || !data || size != expected) {
+        return false;
+    }
+    memcpy(bus.prgRam, data, size);
+    bus.prgRamDirty = false;
+    return true;
+}
+
+// Copies PRG RAM out only if it changed since the last take, so a host can
+// poll this every frame and reach flash only when the game actually saved.
+size_t NES::takeBatteryRam(uint8_t *out, size_t capacity) {
+    size_t size = batteryRamSize();
+    if (size == 0 || !bus.prgRamDirty || !out || capacity < size) {
+        return 0;
+    }
+    memcpy(out, bus.prgRam, size);
+    bus.prgRamDirty = false;
+    return size;
+}
+
+bool nes_get_stats(NESRef nes, NesStats *stats) {
+    if (!stats) {
+        return false;
+    }
+    memset(stats, 0, sizeof(*stats));
+#if NESC_PROFILE
+    if (!nes) {
+        return false;
+    }
+    const ProfileCounters &counters = nes->counters;
+    stats->frames = counters.frames;
+    stats->instructions = counters.instructions;
+    stats->stall_cycles = counters.stallCycles;
+    stats->dma_cycles = counters.dmaCycles;
+    stats->scanlines_rendered = counters.scanlinesRendered;
+    stats->prg_reads = counters.prgReads;
+    stats->mapper_writes = counters.mapperWrites;
+    stats->samples_dropped = counters.samplesDropped;
+    stats->samples_starved = nes->audioRing.starvedSamples();
+    stats->frames_dropped = nes->frames.droppedFrames();
+    stats->frame_ns = counters.frameNanos;
+    stats->ppu_ns = counters.ppuNanos;
+    stats->apu_ns = counters.apuNanos;
+    stats->cpu_cycles = counters.cpuCycles;
+    stats->idle_cycles = counters.idleCycles;
+    uint64_t others = counters.ppuNanos + counters.apuNanos;
+    stats->cpu_ns = counters.frameNanos > others ? counters.frameNanos - others : 0;
+    return true;
+#else
+    (void)nes;
+    return false;
+#endif
+}
+
+bool nes_rom_info(const uint8_t *header, size_t size, NesRomInfo *info) {
+    CartHeader parsed;
+    if (!info || !cart_parse_header(header, size, &parsed)) {
+        return false;
+    }
+    info->mapper = parsed.mapperID;
+    info->prg_size = (uint32_t)parsed.prgSize;
+    info->chr_size = (uint32_t)parsed.chrSize;
+    info->mirroring = (uint32_t)parsed.mirroring;
+    info->flags = (parsed.hasBattery ? NES_ROM_BATTERY : 0) | (parsed.hasTrainer ? NES_ROM_TRAINER : 0) |
+                  (parsed.fourScreen ? NES_ROM_FOUR_SCREEN : 0);
+    info->supported = cart_mapper_supported(parsed.mapperID) ? 1 : 0;
+    return true;
+}
+
+uint64_t nes_rom_hash(const uint8_t *data, size_t size) {
+    CartHeader parsed;
+    if (!cart_parse_header(data, size, &parsed) ||
+        size < parsed.prgOffset + parsed.prgSize + parsed.chrSize) {
+        return 0;
+    }
+    const uint8_t *prg = data + parsed.prgOffset;
+    return cart_rom_hash(prg, parsed.prgSize, prg + parsed.prgSize, parsed.chrSize);
 }
 
 NESRef nes_create(void) {
@@ -70,7 +554,42 @@ bool nes_load_rom(NESRef nes, const uint8_t *data, size_t size) {
     if (!nes) {
         return false;
     }
-    return nes->loadRom(data, size);
+    return nes->loadRom(data, size, CART_ROM_COPY);
+}
+
+bool nes_load_rom_borrowed(NESRef nes, const uint8_t *data, size_t size) {
+    if (!nes) {
+        return false;
+    }
+    return nes->loadRom(data, size, CART_ROM_BORROW);
+}
+
+bool nes_load_rom_file(NESRef nes, const char *path) {
+    if (!nes || !path) {
+        return false;
+    }
+    return nes->loadRomFile(path);
+}
+
+NesRomImage *nes_rom_image_create(const uint8_t *data, size_t size) {
+    return CartImage::copy(data, size);
+}
+
+NesRomImage *nes_rom_image_open(const char *path) {
+    return path ? CartImage::map(path) : NULL;
+}
+
+void nes_rom_image_release(NesRomImage *image) {
+    if (image) {
+        image->release();
+    }
+}
+
+bool nes_load_rom_image(NESRef nes, NesRomImage *image) {
+    if (!nes || !image) {
+        return false;
+    }
+    return nes->loadRomImage(image);
 }
 
 void nes_reset(NESRef nes) {
@@ -80,6 +599,110 @@ void nes_reset(NESRef nes) {
     nes->reset();
 }
 
+void nes_run_frames(NESRef nes, int count, uint32_t flags) {
+    if (!nes || count <= 0) {
+        return;
+    }
+    nes->runFrames(count, flags);
+}
+
+uint32_t nes_run_cycles(NESRef nes, uint32_t cycles) {
+    if (!nes) {
+        return 0;
+    }
+    return nes->runCycles(cycles);
+}
+
+int nes_run_elapsed(NESRef nes, double seconds) {
+    if (!nes) {
+        return 0;
+    }
+    return nes->runElapsed(seconds);
+}
+
+void nes_set_max_frame_skip(NESRef nes, int frames) {
+    if (!nes) {
+        return;
+    }
+    nes->maxFrameSkip = frames > 0 ? frames : 0;
+}
+
+size_t nes_save_state_size(NESRef nes) {
+    if (!nes) {
+        return 0;
+    }
+    return nes->stateSize();
+}
+
+size_t nes_save_state(NESRef nes, uint8_t *out, size_t capacity) {
+    if (!nes) {
+        return 0;
+    }
+    return nes->saveState(out, capacity);
+}
+
+bool nes_load_state(NESRef nes, const uint8_t *data, size_t size) {
+    if (!nes) {
+        return false;
+    }
+    return nes->loadState(data, size);
+}
+
+bool nes_rewind_configure(NESRef nes, size_t budget_bytes, int interval_frames) {
+    if (!nes) {
+        return false;
+    }
+    return nes->configureRewind(budget_bytes, interval_frames);
+}
+
+bool nes_rewind_step(NESRef nes) {
+    if (!nes) {
+        return false;
+    }
+    return nes->rewindStep();
+}
+
+int nes_rewind_depth(NESRef nes) {
+    if (!nes) {
+        return 0;
+    }
+    return nes->rewind.depth();
+}
+
+void nes_set_idle_skip(NESRef nes, bool enabled) {
+    if (nes) {
+        nes->setIdleSkip(enabled);
+    }
+}
+
+bool nes_set_run_ahead(NESRef nes, int frames) {
+    if (!nes) {
+        return false;
+    }
+    return nes->configureRunAhead(frames);
+}
+
+size_t nes_battery_ram_size(NESRef nes) {
+    if (!nes) {
+        return 0;
+    }
+    return nes->batteryRamSize();
+}
+
+bool nes_load_battery_ram(NESRef nes, const uint8_t *data, size_t size) {
+    if (!nes) {
+        return false;
+    }
+    return nes->loadBatteryRam(data, size);
+}
+
+size_t nes_take_battery_ram(NESRef nes, uint8_t *out, size_t capacity) {
+    if (!nes) {
+        return 0;
+    }
+    return nes->takeBatteryRam(out, capacity);
+}
+
 void nes_step_frame(NESRef nes) {
     if (!nes) {
         return;
@@ -91,29 +714,124 @@ const uint32_t *nes_framebuffer(NESRef nes) {
     if (!nes) {
         return NULL;
     }
-    return nes->ppu.frameBuffer.pixels;
+    return nes->frames.latest()->pixels;
+}
+
+const uint32_t *nes_acquire_frame(NESRef nes) {
+    if (!nes) {
+        return NULL;
+    }
+    return nes->frames.acquire();
+}
+
+void nes_release_frame(NESRef nes, const uint32_t *pixels) {
+    if (!nes || !pixels) {
+        return;
+    }
+    nes->frames.release(pixels);
+}
+
+void nes_set_indexed_output(NESRef nes, bool enabled) {
+    if (!nes) {
+        return;
+    }
+    nes->ppu.outputFormat = enabled ? FRAME_FORMAT_INDEXED : FRAME_FORMAT_ARGB;
+}
+
+void nes_expand_frame(const uint32_t *frame, uint32_t *out, const uint32_t *palette, int palette_entries) {
+    if (!frame || !out) {
+        return;
+    }
+    ppu_expand_frame(frame_header(frame), out, palette, palette_entries);
 }
 
 int nes_framebuffer_width(void) { return NES_WIDTH; }
 int nes_framebuffer_height(void) { return NES_HEIGHT; }
 
+bool nes_set_scaled_output(NESRef nes, int width, int height, NesPixelFormat format, bool crop_overscan) {
+    if (!nes) {
+        return false;
+    }
+    if (width == 0) {
+        nes->ppu.outputFormat = FRAME_FORMAT_ARGB;
+        return true;
+    }
+    if (format != NES_PIXEL_ARGB8888 && format != NES_PIXEL_RGB565) {
+        return false;
+    }
+    if (!nes->ppu.configureScale(width, height, crop_overscan)) {
+        return false;
+    }
+    nes->ppu.outputFormat = format == NES_PIXEL_RGB565 ? FRAME_FORMAT_SCALED_RGB565 : FRAME_FORMAT_SCALED_ARGB;
+    return true;
+}
+
+void nes_frame_size(const uint32_t *frame, int *width, int *height) {
+    const FrameBuffer *buffer = frame ? frame_header(frame) : nullptr;
+    if (width) {
+        *width = buffer ? buffer->width : 0;
+    }
+    if (height) {
+        *height = buffer ? buffer->height : 0;
+    }
+}
+
 void nes_set_button(NESRef nes, uint8_t button, bool pressed) {
     if (!nes) {
         return;
     }
-    nes->bus.controller.setButton(button, pressed);
+    nes->input.push(0, button, pressed);
+}
+
+bool nes_queue_button(NESRef nes, uint8_t button, bool pressed, uint64_t frame) {
+    if (!nes) {
+        return false;
+    }
+    return nes->input.push(frame, button, pressed);
+}
+
+uint64_t nes_frame_count(NESRef nes) {
+    if (!nes) {
+        return 0;
+    }
+    return nes->frameCount;
+}
+
+void nes_apu_set_sample_rate(NESRef nes, double sample_rate) {
+    if (!nes) {
+        return;
+    }
+    nes->audioRing.setSampleRate(sample_rate > 0.0 ? (uint32_t)(sample_rate + 0.5) : 0);
 }
 
-float nes_apu_next_sample(NESRef nes, double sample_rate) {
+void nes_apu_set_target_latency(NESRef nes, double seconds) {
     if (!nes) {
-        return 0.0f;
+        return;
     }
-    return nes->apu.nextSample(sample_rate);
+    nes->audioRing.setTargetLatency(seconds > 0.0 ? (uint32_t)(seconds * 1000000.0 + 0.5) : 0);
 }
 
-void nes_apu_fill_buffer(NESRef nes, double sample_rate, float *out, int count) {
+void nes_apu_set_band_limited(NESRef nes, bool enabled) {
     if (!nes) {
         return;
     }
-    nes->apu.fillBuffer(sample_rate, out, count);
+    nes->apu.setSynthesis(enabled ? APU_SYNTH_BAND_LIMITED : APU_SYNTH_POINT_SAMPLED);
+}
+
+int nes_apu_read_samples(NESRef nes, float *out, int count) {
+    if (!out || count <= 0) {
+        return 0;
+    }
+    int read = nes ? nes->audioRing.read(out, count) : 0;
+    if (read < count) {
+        memset(out + read, 0, (size_t)(count - read) * sizeof(float));
+    }
+    return read;
+}
+
+int nes_apu_available_samples(NESRef nes) {
+    if (!nes) {
+        return 0;
+    }
+    return nes->audioRing.available();
 }
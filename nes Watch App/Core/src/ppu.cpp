@@ -1,5 +1,7 @@
 #include "../include/ppu.hpp"
 
+#include <string.h>
+
 static const uint32_t nes_palette[64] = {
     0xFF7C7C7C, 0xFF0000FC, 0xFF0000BC, 0xFF4428BC, 0xFF940084, 0xFFA80020, 0xFFA81000, 0xFF881400,
     0xFF503000, 0xFF007800, 0xFF006800, 0xFF005800, 0xFF004058, 0xFF000000, 0xFF000000, 0xFF000000,
@@ -11,18 +13,85 @@ static const uint32_t nes_palette[64] = {
     0xFFF8D878, 0xFFD8F878, 0xFFB8F8B8, 0xFFB8F8D8, 0xFF00FCFC, 0xFFF8D8F8, 0xFF000000, 0xFF000000
 };
 
+// Spreads the 8 bits of a pattern plane into one byte per pixel, leftmost
+// pixel in the lowest byte, so both planes of a tile row decode with two
+// lookups and a shift.
+struct PlaneSpreadTable {
+    uint64_t entries[256];
+};
+
+static constexpr PlaneSpreadTable ppu_build_plane_spread() {
+    PlaneSpreadTable table = {};
+    for (int value = 0; value < 256; value++) {
+        uint64_t spread = 0;
+        for (int px = 0; px < 8; px++) {
+            if (value & (0x80 >> px)) {
+                spread |= (uint64_t)1 << (px * 8);
+            }
+        }
+        table.entries[value] = spread;
+    }
+    return table;
+}
+
+static constexpr PlaneSpreadTable ppu_plane_spread = ppu_build_plane_spread();
+
+static inline uint64_t ppu_decode_tile_row(uint8_t plane0, uint8_t plane1) {
+    return ppu_plane_spread.entries[plane0] | (ppu_plane_spread.entries[plane1] << 1);
+}
+
+// With one pixel per byte, a horizontal flip is a byte swap.
+static inline uint64_t ppu_flip_row(uint64_t colors) {
+    return __builtin_bswap64(colors);
+}
+
+// Bits of v copied from t at dot 257 (coarse X, nametable X) and during
+// dots 280-304 of the pre-render line (fine Y, nametable Y, coarse Y).
+#define PPU_V_HORIZONTAL 0x041F
+#define PPU_V_VERTICAL 0x7BE0
+
+// Moves v down one pixel row, wrapping from row 29 into the next nametable;
+// rows 30 and 31 (the attribute table) wrap without switching.
+static uint16_t ppu_increment_y(uint16_t v) {
+    if ((v & 0x7000) != 0x7000) {
+        return (uint16_t)(v + 0x1000);
+    }
+    v &= (uint16_t)~0x7000;
+    int coarseY = (v >> 5) & 0x1F;
+    if (coarseY == 29) {
+        coarseY = 0;
+        v ^= 0x0800;
+    } else if (coarseY == 31) {
+        coarseY = 0;
+    } else {
+        coarseY += 1;
+    }
+    return (uint16_t)((v & ~0x03E0) | (coarseY << 5));
+}
+
+static uint16_t ppu_increment_x(uint16_t v) {
+    if ((v & 0x001F) == 0x001F) {
+        return (uint16_t)((v & ~0x001F) ^ 0x0400);
+    }
+    return (uint16_t)(v + 1);
+}
+
 int PPU::mirrorNametable(uint16_t addr) {
     int offset = (int)(addr & 0x0FFF);
     Mirroring activeMirroring = cartridge ? cartridge->mirroring : mirroring;
-    if (activeMirroring == MIRROR_VERTICAL) {
-        return offset & 0x07FF;
-    }
     int table = (offset / 0x400) & 0x03;
     int index = offset & 0x03FF;
-    if (table == 0 || table == 1) {
-        return index;
+    switch (activeMirroring) {
+        case MIRROR_VERTICAL:
+            return offset & 0x07FF;
+        case MIRROR_SINGLE_LOWER:
+            return index;
+        case MIRROR_SINGLE_UPPER:
+            return 0x400 + index;
+        case MIRROR_HORIZONTAL:
+        default:
+            return (table & 0x02) != 0 ? 0x400 + index : index;
     }
-    return 0x400 + index;
 }
 
 int PPU::mirrorPalette(uint16_t addr) {
@@ -34,160 +103,430 @@ int PPU::mirrorPalette(uint16_t addr) {
     return index;
 }
 
-uint32_t PPU::paletteColor(int palette, int color) {
+uint8_t PPU::paletteIndex(int palette, int color) {
     uint16_t indexAddr = (color == 0) ? 0x3F00 : (uint16_t)(0x3F00 + palette * 4 + color);
-    uint8_t paletteIndex = (uint8_t)(readMemory(indexAddr) & 0x3F);
-    return nes_palette[paletteIndex % 64];
+    return (uint8_t)(readMemory(indexAddr) & 0x3F);
 }
 
-uint32_t PPU::spritePaletteColor(int palette, int color) {
+uint8_t PPU::spritePaletteIndex(int palette, int color) {
     uint16_t indexAddr = (uint16_t)(0x3F10 + palette * 4 + color);
-    uint8_t paletteIndex = (uint8_t)(readMemory(indexAddr) & 0x3F);
-    return nes_palette[paletteIndex % 64];
+    return (uint8_t)(readMemory(indexAddr) & 0x3F);
+}
+
+static inline bool ppu_scaled_format(FrameFormat format) {
+    return format == FRAME_FORMAT_SCALED_ARGB || format == FRAME_FORMAT_SCALED_RGB565;
+}
+
+// Background entries resolve through 0-15 and sprite entries through 16-31,
+// matching palette RAM with the background colour at every 0 mod 4.
+void PPU::resolvePalette() {
+    paletteIndices[0] = paletteIndex(0, 0);
+    for (int i = 1; i < 32; i++) {
+        if ((i & 0x03) == 0) {
+            paletteIndices[i] = paletteIndices[0];
+        } else if (i < 16) {
+            paletteIndices[i] = paletteIndex(i >> 2, i & 0x03);
+        } else {
+            paletteIndices[i] = spritePaletteIndex((i >> 2) & 0x03, i & 0x03);
+        }
+    }
+    for (int i = 0; i < 32; i++) {
+        uint32_t color = nes_palette[paletteIndices[i]];
+        paletteColors[i] = color;
+        paletteRgb565[i] = (uint16_t)(((color >> 8) & 0xF800) | ((color >> 5) & 0x07E0) | ((color >> 3) & 0x001F));
+    }
+    paletteValid = true;
+}
+
+// Drops the cached tiles of every CHR slot the cartridge has changed since
+// the last line.
+void PPU::syncTileCache() {
+    uint8_t changed = cartridge ? cartridge->chrPagesChanged : 0;
+    if (changed == 0) {
+        return;
+    }
+    const int bytesPerPage = PPU_PATTERN_TILES / 8 / CART_CHR_PAGE_COUNT;
+    for (int page = 0; page < CART_CHR_PAGE_COUNT; page++) {
+        if (changed & (1 << page)) {
+            memset(&tileValid[page * bytesPerPage], 0, (size_t)bytesPerPage);
+        }
+    }
+    cartridge->chrPagesChanged = 0;
+}
+
+void PPU::decodeTile(int tile) {
+    uint16_t addr = (uint16_t)(tile * 16);
+    const uint8_t *page = cartridge ? cartridge->chrPage(addr) : nullptr;
+    uint64_t *rows = &tileRows[tile * 8];
+    if (!page) {
+        memset(rows, 0, 8 * sizeof(uint64_t));
+    } else {
+        const uint8_t *planes = page + (addr & (CART_CHR_PAGE_SIZE - 1));
+        for (int row = 0; row < 8; row++) {
+            rows[row] = ppu_decode_tile_row(planes[row], planes[row + 8]);
+        }
+    }
+    tileValid[tile >> 3] |= (uint8_t)(1 << (tile & 0x07));
+}
+
+// Row `row` of the tile whose pattern starts at tileAddr.
+inline uint64_t PPU::tileRow(uint16_t tileAddr, int row) {
+    int tile = (tileAddr >> 4) & (PPU_PATTERN_TILES - 1);
+    if ((tileValid[tile >> 3] & (1 << (tile & 0x07))) == 0) {
+        decodeTile(tile);
+    }
+    return tileRows[tile * 8 + row];
 }
 
-void PPU::renderBackgroundScanline(int y) {
+void ppu_expand_frame(const FrameBuffer *frame, uint32_t *out, const uint32_t *palette, int paletteEntries) {
+    if (frame->format != FRAME_FORMAT_INDEXED) {
+        memcpy(out, frame->pixels, frame_bytes(frame->format, frame->width, frame->height));
+        return;
+    }
+    if (!palette) {
+        palette = nes_palette;
+        paletteEntries = 64;
+    }
+    for (int y = 0; y < NES_HEIGHT; y++) {
+        const uint32_t *colors = palette;
+        if (paletteEntries >= 512) {
+            colors = &palette[(frame->emphasis[y] & 0x07) << 6];
+        }
+        const uint8_t *row = &frame->indices[y * NES_WIDTH];
+        uint32_t *dst = &out[y * NES_WIDTH];
+        for (int x = 0; x < NES_WIDTH; x++) {
+            dst[x] = colors[row[x] & 0x3F];
+        }
+    }
+}
+
+// Fills line with palette << 2 | color per pixel; 0 marks a transparent pixel.
+void PPU::renderBackgroundLine(int y, uint8_t *line) {
     int width = NES_WIDTH;
     bool showBackground = (mask & 0x08) != 0;
     bool showLeftBackground = (mask & 0x02) != 0;
+    if (!showBackground) {
+        memset(line, 0, (size_t)width);
+        return;
+    }
+
     uint16_t patternBase = (ctrl & 0x10) != 0 ? 0x1000 : 0x0000;
-    int baseNTX = (ctrl & 0x01) != 0 ? 1 : 0;
-    int baseNTY = (ctrl & 0x02) != 0 ? 1 : 0;
+    const ScrollSnapshot *scroll = &lineScroll[y];
+    int fineY = (scroll->v >> 12) & 0x07;
+
+    // One fetch per tile: 33 tiles cover the 256 visible pixels plus the
+    // partial tile exposed by fine X scroll.
+    uint8_t tiles[NES_WIDTH + 8];
+    uint16_t address = scroll->v;
+    for (int tile = 0; tile < 33; tile++, address = ppu_increment_x(address)) {
+        uint8_t tileId = readMemory((uint16_t)(0x2000 | (address & 0x0FFF)));
+        uint8_t attr = readMemory((uint16_t)(0x23C0 | (address & 0x0C00) | ((address >> 4) & 0x38) | ((address >> 2) & 0x07)));
+        int shift = ((address >> 4) & 0x04) | (address & 0x02);
+        uint8_t paletteBits = (uint8_t)(((attr >> shift) & 0x03) << 2);
+
+        uint64_t colors = tileRow((uint16_t)(patternBase + (uint16_t)tileId * 16), fineY);
+        uint8_t *out = &tiles[tile * 8];
+        for (int px = 0; px < 8; px++) {
+            uint8_t color = (uint8_t)((colors >> (px * 8)) & 0x03);
+            out[px] = color != 0 ? (uint8_t)(paletteBits | color) : 0;
+        }
+    }
 
-    int scrolledY = (y + (int)scrollY) & 0x1FF;
-    int tileY = (scrolledY / 8) % 30;
-    int fineY = scrolledY % 8;
-    int ntY = ((scrolledY / 240) + baseNTY) & 0x01;
+    memcpy(line, &tiles[scroll->fineX], (size_t)width);
+    if (!showLeftBackground) {
+        memset(line, 0, 8);
+    }
+}
 
-    for (int x = 0; x < width; x++) {
-        if (!showBackground || (x < 8 && !showLeftBackground)) {
-            uint32_t pixelColor = paletteColor(0, 0);
-            frameBuffer.pixels[y * width + x] = pixelColor;
-            bgColorIndex[y * width + x] = 0;
+// Copies the first eight OAM entries that cover line y into secondary OAM,
+// in OAM order, and sets the overflow flag if a ninth is found. The
+// hardware's diagonal overflow scan is not reproduced.
+void PPU::evaluateSprites(int y) {
+    int spriteHeight = (ctrl & 0x20) != 0 ? 16 : 8;
+    spriteCount = 0;
+    spriteZeroOnLine = false;
+    for (int i = 0; i < 64; i++) {
+        const uint8_t *entry = &oam[i * 4];
+        int row = y - ((int)entry[0] + 1);
+        if (row < 0 || row >= spriteHeight) {
             continue;
         }
+        if (spriteCount == PPU_SPRITES_PER_LINE) {
+            status |= 0x20;
+            break;
+        }
+        if (i == 0) {
+            spriteZeroOnLine = true;
+        }
+        memcpy(&secondaryOam[spriteCount * 4], entry, 4);
+        spriteCount += 1;
+    }
+}
 
-        int scrolledX = (x + (int)scrollX) & 0x1FF;
-        int tileX = (scrolledX / 8) % 32;
-        int fineX = scrolledX % 8;
-        int ntX = ((scrolledX / 256) + baseNTX) & 0x01;
-        uint16_t baseNameTable = (uint16_t)(0x2000 + ((ntY << 1) | ntX) * 0x400);
-        uint16_t nameAddr = (uint16_t)(baseNameTable + tileY * 32 + tileX);
-        uint8_t tileId = readMemory(nameAddr);
-        uint16_t patternAddr = (uint16_t)(patternBase + (uint16_t)tileId * 16 + (uint16_t)fineY);
-        uint8_t plane0 = readMemory(patternAddr);
-        uint8_t plane1 = readMemory(patternAddr + 8);
-        int bit = 7 - fineX;
-        int color = ((plane1 >> bit) & 0x01) << 1 | ((plane0 >> bit) & 0x01);
+// Fetches the row of a sprite that falls on line y, already flipped, as
+// eight 2-bit colours in the layout of ppu_decode_tile_row.
+uint64_t PPU::spriteRowColors(int y, const uint8_t *entry) {
+    int spriteHeight = (ctrl & 0x20) != 0 ? 16 : 8;
+    uint8_t tileId = entry[1];
+    uint8_t attr = entry[2];
+    int row = y - ((int)entry[0] + 1);
+    int spriteRow = (attr & 0x80) != 0 ? (spriteHeight - 1 - row) : row;
+    uint16_t patternBase = (ctrl & 0x08) != 0 ? 0x1000 : 0x0000;
+    uint16_t tileIndex = tileId;
+    if (spriteHeight == 16) {
+        patternBase = (tileId & 0x01) != 0 ? 0x1000 : 0x0000;
+        tileIndex = (uint16_t)((tileId & 0xFE) + (spriteRow / 8));
+        spriteRow %= 8;
+    }
 
-        uint16_t attrAddr = (uint16_t)(baseNameTable + 0x03C0 + (tileY / 4) * 8 + (tileX / 4));
-        uint8_t attr = readMemory(attrAddr);
-        int quadrantX = (tileX % 4) / 2;
-        int quadrantY = (tileY % 4) / 2;
-        int shift = (quadrantY * 2 + quadrantX) * 2;
-        int palette = (attr >> shift) & 0x03;
+    uint64_t colors = tileRow((uint16_t)(patternBase + tileIndex * 16), spriteRow);
+    return (attr & 0x40) != 0 ? ppu_flip_row(colors) : colors;
+}
 
-        uint32_t pixelColor = paletteColor(palette, color);
-        frameBuffer.pixels[y * width + x] = pixelColor;
-        bgColorIndex[y * width + x] = (uint8_t)color;
-    }
+// Returns the 2-bit background colour at pixel x of line y, ignoring the
+// left-column mask.
+uint8_t PPU::backgroundColor(int y, int x) {
+    uint16_t patternBase = (ctrl & 0x10) != 0 ? 0x1000 : 0x0000;
+    const ScrollSnapshot *scroll = &lineScroll[y];
+    int scrolledX = (int)((scroll->v & 0x1F) << 3) + scroll->fineX + x;
+    int tileX = (scrolledX >> 3) & 0x1F;
+    uint16_t address = (uint16_t)((scroll->v & ~0x001F) ^ ((scrolledX & 0x100) << 2));
+    uint8_t tileId = readMemory((uint16_t)(0x2000 | (address & 0x0FE0) | tileX));
+    uint64_t colors = tileRow((uint16_t)(patternBase + (uint16_t)tileId * 16), (scroll->v >> 12) & 0x07);
+    return (uint8_t)((colors >> ((scrolledX & 0x07) * 8)) & 0x03);
 }
 
-void PPU::renderSpritesScanline(int y) {
-    bool showSprites = (mask & 0x10) != 0;
-    bool showLeftSprites = (mask & 0x04) != 0;
-    if (!showSprites) {
+// Sets the sprite-0 hit flag if an opaque pixel of sprite 0 overlaps an
+// opaque background pixel on line y. Only the pixels under sprite 0 are
+// fetched, so the flag does not depend on the line being drawn.
+void PPU::testSpriteZeroHit(int y) {
+    if (!spriteZeroOnLine || (mask & 0x18) != 0x18 || (status & 0x40) != 0) {
         return;
     }
+    uint64_t colors = spriteRowColors(y, secondaryOam);
+    int spriteX = (int)secondaryOam[3];
+    int firstX = (mask & 0x06) == 0x06 ? 0 : 8;
+    for (int px = 0; px < 8 && colors != 0; px++, colors >>= 8) {
+        int x = spriteX + px;
+        if (x >= 255) {
+            break;
+        }
+        if (x < firstX || (colors & 0x03) == 0) {
+            continue;
+        }
+        if (backgroundColor(y, x) != 0) {
+            status |= 0x40;
+            return;
+        }
+    }
+}
 
+// Decodes each sprite in secondary OAM once and composites them into line.
+// Lower OAM indices win, regardless of background priority; each opaque
+// pixel is 0x10 | palette << 2 | color, plus SPRITE_PIXEL_BEHIND.
+void PPU::renderSpriteLine(int y, uint8_t *line) {
     int width = NES_WIDTH;
-    int spriteHeight = (ctrl & 0x20) != 0 ? 16 : 8;
-    uint16_t spriteTable = (ctrl & 0x08) != 0 ? 0x1000 : 0x0000;
+    bool showLeftSprites = (mask & 0x04) != 0;
+    memset(line, 0, (size_t)width);
 
-    for (int i = 63; i >= 0; i--) {
-        int base = i * 4;
-        int spriteY = (int)oam[base] + 1;
-        uint8_t tileId = oam[base + 1];
-        uint8_t attr = oam[base + 2];
-        int spriteX = (int)oam[base + 3];
+    for (int slot = 0; slot < spriteCount; slot++) {
+        const uint8_t *entry = &secondaryOam[slot * 4];
+        uint8_t attr = entry[2];
+        int spriteX = (int)entry[3];
 
-        if (y < spriteY || y >= spriteY + spriteHeight) {
+        uint64_t colors = spriteRowColors(y, entry);
+        if (colors == 0) {
             continue;
         }
 
-        int palette = attr & 0x03;
-        bool priorityBehind = (attr & 0x20) != 0;
-        bool flipH = (attr & 0x40) != 0;
-        bool flipV = (attr & 0x80) != 0;
+        uint8_t flags = (uint8_t)(0x10 | ((attr & 0x03) << 2));
+        if ((attr & 0x20) != 0) {
+            flags |= SPRITE_PIXEL_BEHIND;
+        }
+        for (int px = 0; px < 8; px++) {
+            int x = spriteX + px;
+            uint8_t color = (uint8_t)((colors >> (px * 8)) & 0x03);
+            if (x >= width || color == 0 || line[x] != 0) {
+                continue;
+            }
+            line[x] = (uint8_t)(flags | color);
+        }
+    }
 
-        int row = y - spriteY;
-        int spriteRow = flipV ? (spriteHeight - 1 - row) : row;
-        uint16_t tileIndex;
-        uint16_t patternBase;
-        int fineY;
+    if (!showLeftSprites) {
+        memset(line, 0, 8);
+    }
+}
 
-        if (spriteHeight == 16) {
-            uint16_t table = (tileId & 0x01) != 0 ? 0x1000 : 0x0000;
-            patternBase = table;
-            uint16_t baseTile = (uint16_t)(tileId & 0xFE);
-            tileIndex = (uint16_t)(baseTile + (spriteRow / 8));
-            fineY = spriteRow % 8;
-        } else {
-            patternBase = spriteTable;
-            tileIndex = tileId;
-            fineY = spriteRow;
-        }
+// Records the scroll line y is drawn with; incrementing the previous line's
+// snapshot is what rendering alone would have done to v.
+void PPU::captureScroll(int y) {
+    ScrollSnapshot *scroll = &lineScroll[y];
+    scroll->v = v;
+    scroll->fineX = fineX;
+    scroll->split = true;
+    if (y > 0) {
+        const ScrollSnapshot *above = &lineScroll[y - 1];
+        scroll->split = above->fineX != fineX || ppu_increment_y(above->v) != v;
+    }
+}
 
-        uint16_t patternAddr = (uint16_t)(patternBase + tileIndex * 16 + fineY);
-        uint8_t plane0 = readMemory(patternAddr);
-        uint8_t plane1 = readMemory(patternAddr + 8);
+void PPU::renderScanline(int y) {
+    int width = NES_WIDTH;
+    bool renderingEnabled = (mask & 0x18) != 0;
+    bool showSprites = (mask & 0x10) != 0;
+    bool hasSprites = false;
+    captureScroll(y);
+    syncTileCache();
+    if (renderingEnabled) {
+        evaluateSprites(y);
+        testSpriteZeroHit(y);
+        hasSprites = showSprites && spriteCount > 0;
+    }
+    if (skipRender || !frameFits) {
+        return;
+    }
+    FrameFormat format = frameBuffer->format;
+    bool scaled = ppu_scaled_format(format);
+    if (scaled && outputScale.rowCount[y] == 0) {
+        return;
+    }
+    NES_PROFILE_ADD(profile, scanlinesRendered, 1);
 
-        for (int col = 0; col < 8; col++) {
-            int x = spriteX + col;
-            if (x < 0 || x >= width) {
-                continue;
-            }
-            if (x < 8 && !showLeftSprites) {
-                continue;
-            }
+    uint8_t background[NES_WIDTH];
+    renderBackgroundLine(y, background);
+    uint8_t sprites[NES_WIDTH];
+    if (hasSprites) {
+        renderSpriteLine(y, sprites);
+    }
 
-            int fineX = flipH ? col : (7 - col);
-            int bit = fineX;
-            int color = ((plane1 >> bit) & 0x01) << 1 | ((plane0 >> bit) & 0x01);
-            if (color == 0) {
-                continue;
+    uint8_t merged[NES_WIDTH];
+    const uint8_t *entries = background;
+    if (hasSprites) {
+        for (int x = 0; x < width; x++) {
+            uint8_t bg = background[x];
+            uint8_t sprite = sprites[x];
+            merged[x] = bg;
+            if (sprite != 0 && ((sprite & SPRITE_PIXEL_BEHIND) == 0 || bg == 0)) {
+                merged[x] = (uint8_t)(sprite & 0x1F);
             }
+        }
+        entries = merged;
+    }
 
-            uint8_t bgIndex = bgColorIndex[y * width + x];
-            if (priorityBehind && bgIndex != 0) {
-                continue;
-            }
+    if (!paletteValid) {
+        resolvePalette();
+    }
+    frameBuffer->emphasis[y] = (uint8_t)(mask >> 5);
+    if (scaled) {
+        emitScaledLine(y, entries);
+    } else if (format == FRAME_FORMAT_INDEXED) {
+        const uint8_t *indices = paletteIndices;
+        uint8_t *row = &frameBuffer->indices[y * width];
+        for (int x = 0; x < width; x++) {
+            row[x] = indices[entries[x]];
+        }
+    } else {
+        const uint32_t *palette = paletteColors;
+        uint32_t *row = &frameBuffer->pixels[y * width];
+        for (int x = 0; x < width; x++) {
+            row[x] = palette[entries[x]];
+        }
+    }
+}
 
-            if (i == 0 && (mask & 0x08) != 0) {
-                status |= 0x40;
-            }
+// Writes the output rows source line y fills: one row sampled through the
+// column table, copied to any further rows the line covers.
+void PPU::emitScaledLine(int y, const uint8_t *entries) {
+    int width = outputScale.width;
+    int rows = outputScale.rowCount[y];
+    const uint8_t *column = outputScale.column;
+    if (frameBuffer->format == FRAME_FORMAT_SCALED_RGB565) {
+        const uint16_t *palette = paletteRgb565;
+        uint16_t *row = &frameBuffer->rgb565[outputScale.firstRow[y] * width];
+        for (int x = 0; x < width; x++) {
+            row[x] = palette[entries[column[x]]];
+        }
+        for (int i = 1; i < rows; i++) {
+            memcpy(row + i * width, row, (size_t)width * sizeof(uint16_t));
+        }
+    } else {
+        const uint32_t *palette = paletteColors;
+        uint32_t *row = &frameBuffer->pixels[outputScale.firstRow[y] * width];
+        for (int x = 0; x < width; x++) {
+            row[x] = palette[entries[column[x]]];
+        }
+        for (int i = 1; i < rows; i++) {
+            memcpy(row + i * width, row, (size_t)width * sizeof(uint32_t));
+        }
+    }
+}
 
-            uint32_t pixelColor = spritePaletteColor(palette, color);
-            frameBuffer.pixels[y * width + x] = pixelColor;
+// Each output pixel takes the source column or line under its centre,
+// (2i + 1) * source / (2 * output) in exact integer steps.
+bool PPU::configureScale(int width, int height, bool cropOverscan) {
+    if (width < 1 || width > NES_WIDTH || height < 1 || height > NES_HEIGHT) {
+        return false;
+    }
+    int top = cropOverscan ? PPU_OVERSCAN_LINES : 0;
+    int lines = NES_HEIGHT - 2 * top;
+    requestedScale.width = (uint16_t)width;
+    requestedScale.height = (uint16_t)height;
+    for (int x = 0; x < width; x++) {
+        requestedScale.column[x] = (uint8_t)((2 * x + 1) * NES_WIDTH / (2 * width));
+    }
+    memset(requestedScale.rowCount, 0, sizeof(requestedScale.rowCount));
+    for (int row = 0; row < height; row++) {
+        int y = top + (2 * row + 1) * lines / (2 * height);
+        if (requestedScale.rowCount[y] == 0) {
+            requestedScale.firstRow[y] = (uint8_t)row;
         }
+        requestedScale.rowCount[y] += 1;
     }
+    scaleChanged = true;
+    return true;
 }
 
 void PPU::connectCartridge(Cartridge *cart) {
     cartridge = cart;
+    scanlineCounter = cart->mapper && cart->mapper->hasScanlineCounter();
     mirroring = cart->mirroring;
+    memset(tileValid, 0, sizeof(tileValid));
+}
+
+size_t PPU::nextFrameBytes() const {
+    const OutputScale &scale = scaleChanged ? requestedScale : outputScale;
+    if (ppu_scaled_format(outputFormat)) {
+        return frame_bytes(outputFormat, scale.width, scale.height);
+    }
+    return frame_bytes(outputFormat, NES_WIDTH, NES_HEIGHT);
 }
 
 void PPU::resetFrame() {
     frameComplete = false;
+    bool scaled = ppu_scaled_format(outputFormat);
+    if (scaled && scaleChanged) {
+        outputScale = requestedScale;
+        scaleChanged = false;
+    }
+    uint16_t width = scaled ? outputScale.width : (uint16_t)NES_WIDTH;
+    uint16_t height = scaled ? outputScale.height : (uint16_t)NES_HEIGHT;
+    frameFits = frameBuffer->capacity >= frame_bytes(outputFormat, width, height);
+    if (!frameFits) {
+        return;
+    }
+    frameBuffer->format = outputFormat;
+    frameBuffer->width = width;
+    frameBuffer->height = height;
 }
 
 uint8_t PPU::cpuRead(uint16_t addr) {
+    catchUp();
     switch (addr) {
         case 0x2002: {
             uint8_t value = (uint8_t)((status & 0xE0) | (dataBus & 0x1F));
             status &= 0x1F;
-            addressLatch = false;
+            w = false;
             dataBus = value;
             return value;
         }
@@ -198,14 +537,15 @@ uint8_t PPU::cpuRead(uint16_t addr) {
         }
         case 0x2007: {
             uint8_t value;
-            if (vramAddr >= 0x3F00) {
-                value = readMemory(vramAddr);
-                readBuffer = readMemory((uint16_t)(vramAddr - 0x1000));
+            uint16_t address = v & 0x3FFF;
+            if (address >= 0x3F00) {
+                value = readMemory(address);
+                readBuffer = readMemory((uint16_t)(address - 0x1000));
             } else {
                 value = readBuffer;
-                readBuffer = readMemory(vramAddr);
+                readBuffer = readMemory(address);
             }
-            vramAddr += (ctrl & 0x04) != 0 ? 32 : 1;
+            incrementAddress();
             dataBus = value;
             return value;
         }
@@ -215,10 +555,12 @@ uint8_t PPU::cpuRead(uint16_t addr) {
 }
 
 void PPU::cpuWrite(uint16_t addr, uint8_t data) {
+    catchUp();
     dataBus = data;
     switch (addr) {
         case 0x2000:
             ctrl = data;
+            t = (uint16_t)((t & ~0x0C00) | ((data & 0x03) << 10));
             break;
         case 0x2001:
             mask = data;
@@ -231,34 +573,47 @@ void PPU::cpuWrite(uint16_t addr, uint8_t data) {
             oamAddr += 1;
             break;
         case 0x2005:
-            if (!addressLatch) {
-                scrollX = data;
-                addressLatch = true;
+            if (!w) {
+                t = (uint16_t)((t & ~0x001F) | (data >> 3));
+                fineX = data & 0x07;
             } else {
-                scrollY = data;
-                addressLatch = false;
+                t = (uint16_t)((t & ~0x73E0) | ((data & 0x07) << 12) | ((data & 0xF8) << 2));
             }
+            w = !w;
             break;
         case 0x2006:
-            if (!addressLatch) {
-                vramAddr = (uint16_t)(data << 8);
-                addressLatch = true;
+            if (!w) {
+                t = (uint16_t)((t & 0x00FF) | ((data & 0x3F) << 8));
             } else {
-                vramAddr = (uint16_t)((vramAddr & 0xFF00) | data);
-                addressLatch = false;
+                t = (uint16_t)((t & 0xFF00) | data);
+                v = t;
             }
+            w = !w;
             break;
         case 0x2007:
-            writeMemory(vramAddr, data);
-            vramAddr += (ctrl & 0x04) != 0 ? 32 : 1;
+            writeMemory(v, data);
+            incrementAddress();
             break;
         default:
             break;
     }
 }
 
+bool PPU::renderingLine() const {
+    return (mask & 0x18) != 0 && (scanline < 240 || scanline == 261);
+}
+
+// $2007 steps v by 1 or 32, except while rendering, when the access lands on
+// the fetch logic and bumps coarse X and fine Y together.
+void PPU::incrementAddress() {
+    if (renderingLine()) {
+        v = ppu_increment_y(ppu_increment_x(v));
+        return;
+    }
+    v = (uint16_t)((v + ((ctrl & 0x04) != 0 ? 32 : 1)) & 0x7FFF);
+}
+
 void PPU::tick() {
-    nmiRequested = false;
     if (scanline == 241 && cycle == 1) {
         status |= 0x80;
         if ((ctrl & 0x80) != 0) {
@@ -271,8 +626,23 @@ void PPU::tick() {
     }
 
     if (cycle == 0 && scanline >= 0 && scanline < 240) {
-        renderBackgroundScanline(scanline);
-        renderSpritesScanline(scanline);
+        renderScanline(scanline);
+    }
+
+    // The fine-Y increment at dot 256 and the horizontal reload at 257 are
+    // applied together; the pre-render line reloads the vertical bits once.
+    if (cycle == 257 && renderingLine()) {
+        v = (uint16_t)((ppu_increment_y(v) & ~PPU_V_HORIZONTAL) | (t & PPU_V_HORIZONTAL));
+    }
+    if (cycle == 280 && scanline == 261 && (mask & 0x18) != 0) {
+        v = (uint16_t)((v & ~PPU_V_VERTICAL) | (t & PPU_V_VERTICAL));
+    }
+
+    // A12 rises once per line at dot 260, when sprite fetches start, as long
+    // as background and sprites do not both fetch from $0000.
+    if (scanlineCounter && cycle == 260 && (scanline < 240 || scanline == 261) &&
+        (mask & 0x18) != 0 && (ctrl & 0x38) != 0) {
+        cartridge->mapper->clockScanline(*cartridge);
     }
 
     cycle += 1;
@@ -286,14 +656,111 @@ void PPU::tick() {
     }
 }
 
+// First dot at or after cycle on which tick does more than advance the
+// counters, past the dot-0 render and dot-1 flag updates.
+static int ppu_next_event_dot(int scanline, int cycle, bool scanlineCounter) {
+    bool fetchLine = scanline < 240 || scanline == 261;
+    if (fetchLine && cycle <= 257) {
+        return 257;
+    }
+    if (scanlineCounter && cycle <= 260) {
+        return 260;
+    }
+    if (scanline == 261 && cycle <= 280) {
+        return 280;
+    }
+    return 341;
+}
+
+void PPU::catchUp() {
+    NES_PROFILE_SCOPE(profile, ppuNanos);
+    // Dots past the end of a frame wait for resetFrame, so the next frame's
+    // first line is never drawn into the buffer that is about to be published.
+    while (clock < targetClock && !frameComplete) {
+        // Every per-line event happens on dot 0 or 1 or one of the few dots
+        // ppu_next_event_dot names; the dots between only advance the
+        // counters, so they are skipped in one step.
+        int eventDot = ppu_next_event_dot(scanline, cycle, scanlineCounter);
+        if (cycle <= 1 || cycle == eventDot) {
+            tick();
+            clock += 1;
+            continue;
+        }
+        uint64_t remaining = targetClock - clock;
+        int step = eventDot - cycle;
+        if (remaining < (uint64_t)step) {
+            step = (int)remaining;
+        }
+        cycle += step;
+        clock += (uint64_t)step;
+        if (cycle >= 341) {
+            cycle = 0;
+            scanline += 1;
+            if (scanline >= 262) {
+                scanline = 0;
+                frameComplete = true;
+            }
+        }
+    }
+    scheduleNextEvent();
+}
+
+static uint64_t ppu_dots_until(int scanline, int cycle, int eventLine, int eventCycle) {
+    const int frameDots = 262 * 341;
+    int position = scanline * 341 + cycle;
+    int event = eventLine * 341 + eventCycle;
+    int distance = (event - position + frameDots) % frameDots;
+    return (uint64_t)distance + 1;
+}
+
+// Dots until the dot-260 counter clock that is `clocks` clocks ahead. Lines
+// 0-239 and the pre-render line clock, which is 241 clocks per frame.
+static uint64_t ppu_dots_until_clock(int scanline, int cycle, int clocks) {
+    const int frameDots = 262 * 341;
+    int next;
+    if (scanline < 240) {
+        next = scanline + (cycle > 260 ? 1 : 0);
+    } else if (scanline < 261) {
+        next = 240;
+    } else {
+        next = cycle > 260 ? 241 : 240;
+    }
+    int target = next + clocks - 1;
+    int ordinal = target % 241;
+    int eventLine = ordinal < 240 ? ordinal : 261;
+    int64_t distance = (int64_t)(target / 241) * frameDots + eventLine * 341 + 260 - (scanline * 341 + cycle);
+    return (uint64_t)distance + 1;
+}
+
+void PPU::scheduleNextEvent() {
+    uint64_t vblank = ppu_dots_until(scanline, cycle, 241, 1);
+    uint64_t frameEnd = ppu_dots_until(scanline, cycle, 261, 340);
+    uint64_t next = vblank < frameEnd ? vblank : frameEnd;
+    if (scanlineCounter && (mask & 0x18) != 0) {
+        int clocks = cartridge->mapper->scanlinesUntilIrq();
+        if (clocks > 0) {
+            uint64_t irq = ppu_dots_until_clock(scanline, cycle, clocks);
+            next = irq < next ? irq : next;
+        }
+    }
+    eventClock = clock + next;
+}
+
+uint64_t PPU::nextStatusClock() const {
+    uint64_t next = ppu_dots_until(scanline, cycle, 241, 1);
+    int line = scanline >= 240 ? 0 : scanline + (cycle > 0 ? 1 : 0);
+    if (line < 240) {
+        uint64_t render = ppu_dots_until(scanline, cycle, line, 0);
+        next = render < next ? render : next;
+    }
+    return clock + next;
+}
+
 uint8_t PPU::readMemory(uint16_t addr) {
     uint16_t address = addr & 0x3FFF;
     if (address < 0x2000) {
-        uint8_t value = 0;
-        if (cartridge && cartridge->ppuRead(address, &value)) {
-            return value;
-        }
-        return 0;
+        const uint8_t *page = cartridge ? cartridge->chrPage(address) : nullptr;
+        return page ? page[address & (CART_CHR_PAGE_SIZE - 1)] : 0;
     }
     if (address < 0x3F00) {
         int index = mirrorNametable(address);
@@ -306,8 +773,18 @@ uint8_t PPU::readMemory(uint16_t addr) {
 void PPU::writeMemory(uint16_t addr, uint8_t data) {
     uint16_t address = addr & 0x3FFF;
     if (address < 0x2000) {
-        if (cartridge) {
-            (void)cartridge->ppuWrite(address, data);
+        if (cartridge && cartridge->ppuWrite(address, data)) {
+            // Drop the tile from every slot mapping the written page, since
+            // banks may repeat a CHR RAM page across slots.
+            const uint8_t *page = cartridge->chrPage(address);
+            const int tilesPerPage = PPU_PATTERN_TILES / CART_CHR_PAGE_COUNT;
+            int tileInPage = (address & (CART_CHR_PAGE_SIZE - 1)) >> 4;
+            for (int slot = 0; slot < CART_CHR_PAGE_COUNT; slot++) {
+                if (cartridge->chrPages[slot] == page) {
+                    int tile = slot * tilesPerPage + tileInPage;
+                    tileValid[tile >> 3] &= (uint8_t)~(1 << (tile & 0x07));
+                }
+            }
         }
         return;
     }
@@ -318,9 +795,57 @@ void PPU::writeMemory(uint16_t addr, uint8_t data) {
     }
     int paletteIndex = mirrorPalette(address);
     paletteRam[paletteIndex] = data;
+    paletteValid = false;
+}
+
+void PPU::dmaWriteOam(const uint8_t *block) {
+    catchUp();
+    int first = 256 - oamAddr;
+    memcpy(&oam[oamAddr], block, (size_t)first);
+    memcpy(oam, block + first, (size_t)(256 - first));
+}
+
+void PPU::saveState(StateWriter &state) const {
+    state.put(dataBus);
+    state.put(ctrl);
+    state.put(mask);
+    state.put(status);
+    state.put(oamAddr);
+    state.put(oam);
+    state.put(v);
+    state.put(t);
+    state.put(fineX);
+    state.put(w);
+    state.put(readBuffer);
+    state.put(cycle);
+    state.put(scanline);
+    state.put(frameComplete);
+    state.put(nmiRequested);
+    state.put(clock);
+    state.put(targetClock);
+    state.put(nametableRam);
+    state.put(paletteRam);
 }
 
-void PPU::dmaWriteOam(uint8_t data) {
-    oam[oamAddr] = data;
-    oamAddr += 1;
+void PPU::loadState(StateReader &state) {
+    state.get(dataBus);
+    state.get(ctrl);
+    state.get(mask);
+    state.get(status);
+    state.get(oamAddr);
+    state.get(oam);
+    state.get(v);
+    state.get(t);
+    state.get(fineX);
+    state.get(w);
+    state.get(readBuffer);
+    state.get(cycle);
+    state.get(scanline);
+    state.get(frameComplete);
+    state.get(nmiRequested);
+    state.get(clock);
+    state.get(targetClock);
+    state.get(nametableRam);
+    state.get(paletteRam);
+    paletteValid = false;
 }
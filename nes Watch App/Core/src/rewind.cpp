@@ -0,0 +1,207 @@
+#include "../include/rewind.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Delta tokens: 0x00-0x7F is a literal run of token + 1 bytes that follow;
+// 0x80-0xFF starts a zero run whose 15-bit length continues in the next
+// byte. Zero runs shorter than three bytes stay inside literals, so a delta
+// never grows past one tag byte per 128 input bytes.
+#define REWIND_LITERAL_MAX 128
+#define REWIND_ZERO_RUN_MAX 0x7FFF
+#define REWIND_ZERO_RUN_MIN 3
+
+// Bytes of arena per index slot; the index caps how many snapshots of
+// near-identical frames a large budget can hold.
+#define REWIND_BYTES_PER_RECORD 64
+
+static size_t rewind_zero_run(const uint8_t *a, const uint8_t *b, size_t at, size_t size) {
+    size_t end = at;
+    size_t limit = at + REWIND_ZERO_RUN_MAX < size ? at + REWIND_ZERO_RUN_MAX : size;
+    while (end < limit && a[end] == b[end]) {
+        end++;
+    }
+    return end - at;
+}
+
+// Codes current ^ previous into out and returns the encoded length.
+static size_t rewind_encode(const uint8_t *current, const uint8_t *previous, size_t size, uint8_t *out) {
+    size_t written = 0;
+    size_t at = 0;
+    while (at < size) {
+        size_t zeros = rewind_zero_run(current, previous, at, size);
+        if (zeros >= REWIND_ZERO_RUN_MIN || at + zeros == size) {
+            out[written++] = (uint8_t)(0x80 | (zeros >> 8));
+            out[written++] = (uint8_t)(zeros & 0xFF);
+            at += zeros;
+            continue;
+        }
+        size_t start = at;
+        size_t end = at;
+        while (end < size && end - start < REWIND_LITERAL_MAX) {
+            if (end + REWIND_ZERO_RUN_MIN <= size && current[end] == previous[end] &&
+                current[end + 1] == previous[end + 1] && current[end + 2] == previous[end + 2]) {
+                break;
+            }
+            end++;
+        }
+        out[written++] = (uint8_t)(end - start - 1);
+        for (size_t i = start; i < end; i++) {
+            out[written++] = (uint8_t)(current[i] ^ previous[i]);
+        }
+        at = end;
+    }
+    return written;
+}
+
+static void rewind_apply(uint8_t *state, const uint8_t *delta, size_t length) {
+    size_t at = 0;
+    size_t read = 0;
+    while (read < length) {
+        uint8_t token = delta[read++];
+        if ((token & 0x80) != 0) {
+            at += ((size_t)(token & 0x7F) << 8) | delta[read++];
+            continue;
+        }
+        for (int i = 0; i <= token; i++) {
+            state[at++] ^= delta[read++];
+        }
+    }
+}
+
+RewindBuffer::RewindBuffer() : memory(nullptr), stateBytes(0) {
+    release();
+}
+
+RewindBuffer::~RewindBuffer() {
+    release();
+}
+
+bool RewindBuffer::configure(size_t budget, size_t stateSize) {
+    release();
+    if (stateSize == 0) {
+        return false;
+    }
+    size_t encodedBound = stateSize + stateSize / REWIND_LITERAL_MAX + 4;
+    size_t fixed = 2 * stateSize;
+    if (budget < fixed + 2 * encodedBound + sizeof(RewindRecord)) {
+        return false;
+    }
+    size_t remaining = budget - fixed;
+    int capacity = (int)(remaining / (REWIND_BYTES_PER_RECORD + sizeof(RewindRecord)));
+    if (capacity < 2) {
+        capacity = 2;
+    }
+    size_t indexBytes = (size_t)capacity * sizeof(RewindRecord);
+    size_t arenaSize = remaining - indexBytes;
+    if (arenaSize > 0xFFFFFFFFu) {
+        arenaSize = 0xFFFFFFFFu;
+    }
+
+    memory = (uint8_t *)malloc(fixed + indexBytes + arenaSize);
+    if (!memory) {
+        return false;
+    }
+    records = (RewindRecord *)memory;
+    latest = memory + indexBytes;
+    staged = latest + stateSize;
+    arena = staged + stateSize;
+    stateBytes = stateSize;
+    arenaBytes = arenaSize;
+    maxEncoded = encodedBound;
+    recordCapacity = capacity;
+    clear();
+    return true;
+}
+
+void RewindBuffer::release() {
+    ::free(memory);
+    memory = nullptr;
+    latest = nullptr;
+    staged = nullptr;
+    arena = nullptr;
+    records = nullptr;
+    stateBytes = 0;
+    arenaBytes = 0;
+    maxEncoded = 0;
+    recordCapacity = 0;
+    clear();
+}
+
+void RewindBuffer::clear() {
+    oldestRecord = 0;
+    recordCount = 0;
+    head = 0;
+    snapshots = 0;
+}
+
+void RewindBuffer::dropOldest() {
+    oldestRecord = (oldestRecord + 1) % recordCapacity;
+    recordCount -= 1;
+    snapshots -= 1;
+    if (recordCount == 0) {
+        head = 0;
+    }
+}
+
+// Frees `bytes` of contiguous arena at head, wrapping to the start when the
+// end is too short and dropping the oldest deltas until it fits.
+void RewindBuffer::makeRoom(size_t bytes) {
+    if (recordCount == recordCapacity) {
+        dropOldest();
+    }
+    while (recordCount > 0) {
+        size_t tail = records[oldestRecord].offset;
+        if (head > tail) {
+            if (arenaBytes - head >= bytes) {
+                return;
+            }
+            if (tail >= bytes) {
+                head = 0;
+                return;
+            }
+        } else if (tail - head >= bytes) {
+            return;
+        }
+        dropOldest();
+    }
+    head = 0;
+}
+
+void RewindBuffer::commit() {
+    if (!memory) {
+        return;
+    }
+    if (snapshots > 0) {
+        makeRoom(maxEncoded);
+        // The delta turns this state back into the one it replaces.
+        size_t length = rewind_encode(staged, latest, stateBytes, arena + head);
+        int slot = (oldestRecord + recordCount) % recordCapacity;
+        records[slot].offset = (uint32_t)head;
+        records[slot].length = (uint32_t)length;
+        recordCount += 1;
+        head += length;
+    }
+    uint8_t *previous = latest;
+    latest = staged;
+    staged = previous;
+    snapshots += 1;
+}
+
+const uint8_t *RewindBuffer::pop() {
+    if (snapshots == 0) {
+        return nullptr;
+    }
+    memcpy(staged, latest, stateBytes);
+    if (recordCount > 0) {
+        int slot = (oldestRecord + recordCount - 1) % recordCapacity;
+        rewind_apply(latest, arena + records[slot].offset, records[slot].length);
+        head = records[slot].offset;
+        recordCount -= 1;
+        snapshots -= 1;
+        if (recordCount == 0) {
+            head = 0;
+        }
+    }
+    return staged;
+}
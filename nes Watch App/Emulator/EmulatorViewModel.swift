@@ -6,14 +6,37 @@ final class EmulatorViewModel: ObservableObject {
     @Published var frameImage: CGImage?
     @Published var status: String = "Idle"
     @Published private(set) var romNames: [String] = []
+    @Published private(set) var thumbnails: [String: CGImage] = [:]
 
     private let core = EmulatorCore()
+    private let catalog = RomCatalog()
     private var timer: DispatchSourceTimer?
     private let emuQueue = DispatchQueue(label: "nes.emulator.queue", qos: .userInitiated)
+    private let saveQueue = DispatchQueue(label: "nes.battery.queue", qos: .utility)
     private var audioEngine: CAudioEngine?
+    private var lastTick: DispatchTime?
+    private var romName: String?
+    private var suspended = false
+    // Owned by emuQueue.
+    private var batteryURL: URL?
+    private var lastBatteryFlush = DispatchTime.now()
+    /// NTSC frame period. Ticks only pace the work: the core runs the frames
+    /// each tick's measured elapsed time is worth, so timer drift never
+    /// changes game speed, and audio rate control absorbs the remainder.
+    private static let frameInterval = 1.0 / 60.0988
+    private static let batteryFlushInterval: UInt64 = 5_000_000_000
+    /// One frame of run-ahead offsets the lag touch input and the display
+    /// pipeline add, for about twice the CPU time per drawn frame.
+    private static let runAheadFrames = 1
 
     init() {
-        romNames = Self.discoverRoms()
+        let playable = catalog.entries.filter { $0.supported }
+        romNames = playable.map { $0.name }
+        for entry in playable {
+            if let image = catalog.thumbnail(for: entry) {
+                thumbnails[entry.name] = image
+            }
+        }
     }
 
     func loadDefaultRom() {
@@ -28,9 +51,9 @@ final class EmulatorViewModel: ObservableObject {
         stop()
         audioEngine?.shutdown()
         audioEngine = nil
+        let entry = catalog.entry(named: name)
+        let url = entry.flatMap { catalog.url(for: $0) }
         DispatchQueue.global(qos: .userInitiated).async {
-            let url = Bundle.main.url(forResource: name, withExtension: "nes", subdirectory: "Roms")
-                ?? Bundle.main.url(forResource: name, withExtension: "nes")
             guard let url else {
                 DispatchQueue.main.async {
                     self.status = "Missing .nes file in app bundle."
@@ -38,33 +61,38 @@ final class EmulatorViewModel: ObservableObject {
                 }
                 return
             }
-            do {
-                let data = try Data(contentsOf: url)
-                guard self.core.loadRom(data) else {
-                    DispatchQueue.main.async {
-                        self.status = "Unsupported ROM format or mapper."
-                        completion?(false)
-                    }
-                    return
-                }
+            guard self.core.loadRom(at: url) else {
                 DispatchQueue.main.async {
-                    self.status = "ROM loaded"
-                    completion?(true)
-                    if autoStart {
-                        self.start()
-                    }
+                    self.status = "Unsupported ROM format or mapper."
+                    completion?(false)
+                }
+                return
+            }
+            let batteryURL = entry?.hasBattery == true ? Self.batteryURL(for: name) : nil
+            self.emuQueue.async {
+                self.core.setRunAhead(frames: Self.runAheadFrames)
+                self.batteryURL = batteryURL
+                self.lastBatteryFlush = DispatchTime.now()
+                if let batteryURL, let ram = try? Data(contentsOf: batteryURL) {
+                    _ = self.core.loadBatteryRam(ram)
                 }
-                self.emuQueue.async {
-                    self.core.stepFrame()
-                    let image = self.core.currentFrameImage()
-                    DispatchQueue.main.async {
-                        self.frameImage = image
-                    }
+                if let state = try? Data(contentsOf: Self.suspendStateURL(for: name)) {
+                    _ = self.core.loadState(state)
                 }
-            } catch {
+            }
+            DispatchQueue.main.async {
+                self.romName = name
+                self.status = "ROM loaded"
+                completion?(true)
+                if autoStart {
+                    self.start()
+                }
+            }
+            self.emuQueue.async {
+                self.core.stepFrame()
+                let image = self.core.currentFrameImage()
                 DispatchQueue.main.async {
-                    self.status = "Failed to load ROM: \(error.localizedDescription)"
-                    completion?(false)
+                    self.frameImage = image
                 }
             }
         }
@@ -73,10 +101,13 @@ final class EmulatorViewModel: ObservableObject {
     func start() {
         timer?.cancel()
         let timer = DispatchSource.makeTimerSource(queue: emuQueue)
-        timer.schedule(deadline: .now(), repeating: 1.0 / 60.0)
+        timer.schedule(deadline: .now(), repeating: Self.frameInterval, leeway: .milliseconds(1))
+        lastTick = nil
         timer.setEventHandler { [weak self] in
             guard let self else { return }
-            self.core.stepFrame()
+            let frames = self.core.run(elapsed: self.elapsedSinceLastTick())
+            self.flushBatteryRam(force: false)
+            guard frames > 0 else { return }
             let image = self.core.currentFrameImage()
             Task { @MainActor in
                 self.frameImage = image
@@ -90,34 +121,105 @@ final class EmulatorViewModel: ObservableObject {
         timer.resume()
     }
 
+    /// Wall time since the previous tick; the core turns it into frames and
+    /// skips drawing the ones a throttled tick arrived too late for.
+    private func elapsedSinceLastTick() -> Double {
+        let now = DispatchTime.now()
+        defer { lastTick = now }
+        guard let lastTick else { return Self.frameInterval }
+        return Double(now.uptimeNanoseconds - lastTick.uptimeNanoseconds) / 1_000_000_000
+    }
+
     func stop() {
+        let wasRunning = timer != nil
         timer?.cancel()
         timer = nil
         audioEngine?.stop()
+        if wasRunning {
+            emuQueue.sync {
+                flushBatteryRam(force: true)
+            }
+            saveThumbnail()
+        }
     }
 
-    func setButton(_ button: Controller.Button, pressed: Bool) {
-        core.setButton(button, pressed: pressed)
+    /// Writes battery RAM after the game changed it, at most once per
+    /// batteryFlushInterval unless forced. Only the 8 KB copy happens on the
+    /// emulation queue; the file write runs on saveQueue. Call on emuQueue.
+    private func flushBatteryRam(force: Bool) {
+        guard let url = batteryURL else { return }
+        let now = DispatchTime.now()
+        if !force && now.uptimeNanoseconds - lastBatteryFlush.uptimeNanoseconds < Self.batteryFlushInterval {
+            return
+        }
+        lastBatteryFlush = now
+        guard let ram = core.takeBatteryRam() else { return }
+        saveQueue.async {
+            try? FileManager.default.createDirectory(at: url.deletingLastPathComponent(), withIntermediateDirectories: true)
+            try? ram.write(to: url, options: .atomic)
+        }
     }
 
-    private static func discoverRoms() -> [String] {
-        var urls: [URL] = []
-        if let roms = Bundle.main.urls(forResourcesWithExtension: "nes", subdirectory: "Roms") {
-            urls.append(contentsOf: roms)
+    /// Keeps the last frame shown as the game's thumbnail in the menu. The
+    /// frame is redrawn at quarter size so the pinned core frame is not held.
+    private func saveThumbnail() {
+        guard let name = romName, let entry = catalog.entry(named: name), let frame = frameImage,
+              let image = RomCatalog.makeThumbnail(from: frame) else { return }
+        thumbnails[name] = image
+        let catalog = self.catalog
+        DispatchQueue.global(qos: .utility).async {
+            catalog.saveThumbnail(image, for: entry)
         }
-        if let root = Bundle.main.urls(forResourcesWithExtension: "nes", subdirectory: nil) {
-            urls.append(contentsOf: root)
+    }
+
+    /// Stops emulation and snapshots it so a relaunch resumes the game instead
+    /// of cold-booting the ROM.
+    func suspend() {
+        guard timer != nil else { return }
+        stop()
+        suspended = true
+        emuQueue.sync {
+            guard let romName, let state = core.saveState() else { return }
+            try? state.write(to: Self.suspendStateURL(for: romName), options: .atomic)
         }
-        if urls.isEmpty, let resourceURL = Bundle.main.resourceURL {
-            if let enumerator = FileManager.default.enumerator(at: resourceURL, includingPropertiesForKeys: nil) {
-                for case let fileURL as URL in enumerator {
-                    if fileURL.pathExtension.lowercased() == "nes" {
-                        urls.append(fileURL)
-                    }
-                }
-            }
+        // The app may be frozen right after this returns; let the battery
+        // save stop() queued reach disk first.
+        saveQueue.sync {}
+    }
+
+    func resume() {
+        guard suspended else { return }
+        suspended = false
+        start()
+    }
+
+    private static func suspendStateURL(for romName: String) -> URL {
+        let caches = FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask)[0]
+        return caches.appendingPathComponent(romName).appendingPathExtension("state")
+    }
+
+    /// Battery saves live in Application Support, which, unlike Caches, the
+    /// system never purges.
+    private static func batteryURL(for romName: String) -> URL {
+        let support = FileManager.default.urls(for: .applicationSupportDirectory, in: .userDomainMask)[0]
+        return support.appendingPathComponent("Saves", isDirectory: true)
+            .appendingPathComponent(romName).appendingPathExtension("sav")
+    }
+
+    /// Has the core draw at the pixel size the picture fills in a view of
+    /// `size` points, keeping the shape of the overscan-cropped 256x224
+    /// picture. Displays wider than that get it at full size to upscale.
+    func setDisplaySize(_ size: CGSize, scale: CGFloat) {
+        let fit = min(size.width * scale / 256, size.height * scale / 224, 1)
+        let width = Int(256 * fit)
+        let height = Int(224 * fit)
+        guard width > 0, height > 0 else { return }
+        emuQueue.async {
+            self.core.setOutputSize(width: width, height: height)
         }
-        let names = urls.map { $0.deletingPathExtension().lastPathComponent }
-        return Array(Set(names)).sorted()
+    }
+
+    func setButton(_ button: Controller.Button, pressed: Bool) {
+        core.setButton(button, pressed: pressed)
     }
 }
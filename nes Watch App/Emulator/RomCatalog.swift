@@ -0,0 +1,145 @@
+import CoreGraphics
+import Foundation
+import ImageIO
+import UniformTypeIdentifiers
+
+struct RomEntry: Codable {
+    let name: String
+    /// Path relative to the bundle's resource directory.
+    let path: String
+    let mapper: UInt32
+    let prgSize: UInt32
+    let chrSize: UInt32
+    let mirroring: UInt32
+    let flags: UInt32
+    let supported: Bool
+    let hash: UInt64
+
+    var hasBattery: Bool { flags & 0x01 != 0 }
+}
+
+/// Index of the bundled ROMs, persisted in Caches and rebuilt only when the
+/// app version changes, since the bundle cannot change otherwise. Building
+/// it reads each iNES header and hashes the mapped file; launching with a
+/// current index touches no ROM at all.
+final class RomCatalog {
+    private struct Index: Codable {
+        let bundleVersion: String
+        let entries: [RomEntry]
+    }
+
+    private(set) var entries: [RomEntry] = []
+
+    private static let cachesURL = FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask)[0]
+    private static let indexURL = cachesURL.appendingPathComponent("rom-index.json")
+    private static let thumbnailsURL = cachesURL.appendingPathComponent("Thumbnails", isDirectory: true)
+
+    init() {
+        let version = Self.bundleVersion()
+        if let data = try? Data(contentsOf: Self.indexURL),
+           let index = try? JSONDecoder().decode(Index.self, from: data),
+           index.bundleVersion == version {
+            entries = index.entries
+            return
+        }
+        entries = Self.scanBundle()
+        if let data = try? JSONEncoder().encode(Index(bundleVersion: version, entries: entries)) {
+            try? data.write(to: Self.indexURL, options: .atomic)
+        }
+    }
+
+    func entry(named name: String) -> RomEntry? {
+        return entries.first { $0.name == name }
+    }
+
+    func url(for entry: RomEntry) -> URL? {
+        return Bundle.main.resourceURL?.appendingPathComponent(entry.path)
+    }
+
+    func thumbnail(for entry: RomEntry) -> CGImage? {
+        let url = Self.thumbnailURL(for: entry)
+        guard let source = CGImageSourceCreateWithURL(url as CFURL, nil) else { return nil }
+        return CGImageSourceCreateImageAtIndex(source, 0, nil)
+    }
+
+    func saveThumbnail(_ image: CGImage, for entry: RomEntry) {
+        try? FileManager.default.createDirectory(at: Self.thumbnailsURL, withIntermediateDirectories: true)
+        let url = Self.thumbnailURL(for: entry)
+        guard let destination = CGImageDestinationCreateWithURL(url as CFURL, UTType.png.identifier as CFString, 1, nil) else {
+            return
+        }
+        CGImageDestinationAddImage(destination, image, nil)
+        CGImageDestinationFinalize(destination)
+    }
+
+    static func makeThumbnail(from frame: CGImage) -> CGImage? {
+        let width = frame.width / 4
+        let height = frame.height / 4
+        guard let context = CGContext(
+            data: nil,
+            width: width,
+            height: height,
+            bitsPerComponent: 8,
+            bytesPerRow: 0,
+            space: CGColorSpaceCreateDeviceRGB(),
+            bitmapInfo: CGImageAlphaInfo.noneSkipFirst.rawValue
+        ) else {
+            return nil
+        }
+        context.interpolationQuality = .medium
+        context.draw(frame, in: CGRect(x: 0, y: 0, width: width, height: height))
+        return context.makeImage()
+    }
+
+    private static func thumbnailURL(for entry: RomEntry) -> URL {
+        return thumbnailsURL.appendingPathComponent(String(entry.hash, radix: 16)).appendingPathExtension("png")
+    }
+
+    private static func bundleVersion() -> String {
+        let info = Bundle.main.infoDictionary
+        let short = info?["CFBundleShortVersionString"] as? String ?? ""
+        let build = info?["CFBundleVersion"] as? String ?? ""
+        return "\(short)-\(build)"
+    }
+
+    private static func scanBundle() -> [RomEntry] {
+        guard let resourceURL = Bundle.main.resourceURL else { return [] }
+        var urls: [URL] = []
+        if let roms = Bundle.main.urls(forResourcesWithExtension: "nes", subdirectory: "Roms") {
+            urls.append(contentsOf: roms)
+        }
+        if let root = Bundle.main.urls(forResourcesWithExtension: "nes", subdirectory: nil) {
+            urls.append(contentsOf: root)
+        }
+        if urls.isEmpty, let enumerator = FileManager.default.enumerator(at: resourceURL, includingPropertiesForKeys: nil) {
+            for case let fileURL as URL in enumerator where fileURL.pathExtension.lowercased() == "nes" {
+                urls.append(fileURL)
+            }
+        }
+
+        let base = resourceURL.standardizedFileURL.path
+        var seen = Set<String>()
+        var entries: [RomEntry] = []
+        for url in urls {
+            let name = url.deletingPathExtension().lastPathComponent
+            guard !seen.contains(name), let info = EmulatorCore.romInfo(at: url) else { continue }
+            seen.insert(name)
+            var path = url.standardizedFileURL.path
+            if path.hasPrefix(base) {
+                path = String(path.dropFirst(base.count)).trimmingCharacters(in: CharacterSet(charactersIn: "/"))
+            }
+            entries.append(RomEntry(
+                name: name,
+                path: path,
+                mapper: info.mapper,
+                prgSize: info.prgSize,
+                chrSize: info.chrSize,
+                mirroring: info.mirroring,
+                flags: info.flags,
+                supported: info.supported,
+                hash: info.hash
+            ))
+        }
+        return entries.sorted { $0.name < $1.name }
+    }
+}